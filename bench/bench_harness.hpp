@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Kokkos_Core.hpp>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <nlohmann/json.hpp>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace nlcglib {
+namespace bench {
+
+/**
+ * Minimal benchmark runner.
+ *
+ * Each case is repeated until both `min_iterations` and `min_time` are
+ * reached (at most `max_iterations`), timings are collected per repetition.
+ */
+class runner
+{
+public:
+  double min_time{0.2};
+  int min_iterations{3};
+  int max_iterations{1000};
+  /// only run cases whose name contains filter
+  std::string filter;
+
+  template <class F>
+  void run(const std::string& name, const std::map<std::string, int>& params, F&& f)
+  {
+    if (!filter.empty() && name.find(filter) == std::string::npos) return;
+
+    using clock = std::chrono::steady_clock;
+    // warm-up
+    f();
+    Kokkos::fence();
+
+    std::vector<double> times;
+    double total{0};
+    while ((static_cast<int>(times.size()) < min_iterations || total < min_time) &&
+           static_cast<int>(times.size()) < max_iterations) {
+      auto t0 = clock::now();
+      f();
+      Kokkos::fence();
+      double dt = std::chrono::duration<double>(clock::now() - t0).count();
+      times.push_back(dt);
+      total += dt;
+    }
+    std::sort(times.begin(), times.end());
+
+    nlohmann::json entry;
+    entry["name"] = name;
+    entry["params"] = params;
+    entry["iterations"] = times.size();
+    entry["min"] = times.front();
+    entry["median"] = times[times.size() / 2];
+    entry["mean"] = total / times.size();
+    entry["max"] = times.back();
+    results_.push_back(entry);
+
+    std::printf("%-28s", name.c_str());
+    for (auto& p : params) std::printf(" %s=%-6d", p.first.c_str(), p.second);
+    std::printf(" median %.4e s (%zu it)\n", times[times.size() / 2], times.size());
+  }
+
+  nlohmann::json results() const
+  {
+    nlohmann::json out;
+    out["unit"] = "s";
+    out["benchmarks"] = results_;
+    return out;
+  }
+
+private:
+  std::vector<nlohmann::json> results_;
+};
+
+}  // namespace bench
+}  // namespace nlcglib
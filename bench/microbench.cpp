@@ -0,0 +1,239 @@
+#include <Kokkos_Core.hpp>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_harness.hpp"
+#include "la/dvector.hpp"
+#include "la/lapack.hpp"
+#include "la/mvector.hpp"
+#include "mpi/communicator.hpp"
+#include "pseudo_hamiltonian/grad_eta.hpp"
+#include "smearing.hpp"
+
+/**
+ * Microbenchmarks for the linear-algebra wrappers and the smearing layer.
+ *
+ * usage: nlcglib_microbench [--out results.json] [--shapes 2000x50,8000x200]
+ *                           [--min-time 0.2] [--filter name]
+ */
+
+using namespace nlcglib;
+
+using complex_t = Kokkos::complex<double>;
+using matrix_t = KokkosDVector<complex_t**, SlabLayoutV, Kokkos::LayoutLeft, Kokkos::HostSpace>;
+using vec_t = Kokkos::View<double*, Kokkos::HostSpace>;
+
+namespace {
+
+matrix_t
+random_matrix(int m, int n, std::mt19937& gen)
+{
+  matrix_t X(Map<>(Communicator(), SlabLayoutV({{0, 0, m, n}})));
+  std::uniform_real_distribution<double> unif(-1, 1);
+  for (int j = 0; j < n; ++j)
+    for (int i = 0; i < m; ++i) X.array()(i, j) = complex_t(unif(gen), unif(gen));
+  return X;
+}
+
+/// Hermitian positive definite: A^H A + n * I
+matrix_t
+random_hpd(int n, std::mt19937& gen)
+{
+  auto A = random_matrix(n, n, gen);
+  auto S = inner_()(A, A);
+  for (int i = 0; i < n; ++i) S.array()(i, i) += complex_t(n, 0);
+  return S;
+}
+
+/// band energies (in Ha) spread around zero
+vec_t
+band_energies(int nbands)
+{
+  vec_t ek("ek", nbands);
+  for (int i = 0; i < nbands; ++i) ek(i) = -0.5 + 1.0 * i / nbands;
+  return ek;
+}
+
+const char*
+smearing_name(smearing_type t)
+{
+  switch (t) {
+    case smearing_type::FERMI_DIRAC:
+      return "fermi_dirac";
+    case smearing_type::GAUSSIAN_SPLINE:
+      return "gaussian_spline";
+    case smearing_type::GAUSS:
+      return "gauss";
+    case smearing_type::METHFESSEL_PAXTON:
+      return "methfessel_paxton";
+    case smearing_type::COLD:
+      return "cold";
+    default:
+      return "unknown";
+  }
+}
+
+void
+bench_la(bench::runner& runner, int ngk, int nbands)
+{
+  std::mt19937 gen(42);
+  std::map<std::string, int> params{{"ngk", ngk}, {"nbands", nbands}};
+  std::map<std::string, int> params_n{{"n", nbands}};
+
+  auto X = random_matrix(ngk, nbands, gen);
+  auto Y = random_matrix(ngk, nbands, gen);
+  auto Z = random_matrix(ngk, nbands, gen);
+  auto B = random_matrix(nbands, nbands, gen);
+  auto C = inner_()(X, Y);
+  vec_t x("x", nbands);
+  for (int i = 0; i < nbands; ++i) x(i) = 1.0 + 1.0 * i / nbands;
+
+  runner.run("inner", params, [&]() { inner(C, X, Y, complex_t{1.0}, complex_t{0.0}); });
+  runner.run("transform", params, [&]() { transform(Z, complex_t{0.0}, complex_t{1.0}, X, B); });
+  runner.run("add", params, [&]() { add(Z, X, complex_t{1.0}, complex_t{0.5}); });
+  runner.run("scale_vector", params, [&]() { scale(Z, X, x, 1.0, 0.0); });
+  runner.run("scale", params, [&]() { scale(Z, X, 2.0, 0.5); });
+  runner.run("innerh_tr", params, [&]() {
+    volatile double r = Kokkos::real(innerh_tr()(X, Y));
+    (void)r;
+  });
+  runner.run("loewdin", params, [&]() { auto L = loewdin(X); });
+
+  auto S = random_hpd(nbands, gen);
+  auto U = empty_like()(S);
+  vec_t w("w", nbands);
+  Communicator self;
+  runner.run("eigh", params_n, [&]() { eigh(U, w, S, self); });
+
+  auto A = empty_like()(S);
+  auto RHS = empty_like()(B);
+  runner.run("solve_sym", params_n, [&]() {
+    // solve_sym overwrites its arguments
+    Kokkos::deep_copy(A.array(), S.array());
+    Kokkos::deep_copy(RHS.array(), B.array());
+    solve_sym(A, RHS, self);
+  });
+}
+
+template <smearing_type smearing_t>
+void
+bench_smearing(bench::runner& runner, int nbands)
+{
+  const std::string prefix = smearing_name(smearing_t);
+  std::map<std::string, int> params{{"nbands", nbands}};
+  const double T = 3000;
+  const double mo = 2;
+  const int Ne = nbands;  // half filling
+  const double kT = physical_constants::kb * T;
+
+  Communicator self;
+  mvector<double> wk(self);
+  wk[std::make_pair(0, 0)] = 1.0;
+
+  auto ek = band_energies(nbands);
+  mvector<vec_t> en;
+  en[std::make_pair(0, 0)] = ek;
+
+  double mu{0};
+  runner.run(prefix + "/find_chemical_potential", params, [&]() {
+    mu = find_chemical_potential(
+        [&](double mu) { return Ne - smearing<smearing_t>::sum_fn(ek, mu, T, mo); }, 0, 1e-11);
+  });
+
+  Smearing smear(T, Ne, mo, wk, smearing_t);
+  auto mu_fn = smear.fn(en);
+  auto& fn = std::get<1>(mu_fn);
+  double mu_ref = std::get<0>(mu_fn);
+  runner.run(prefix + "/entropy", params, [&]() {
+    volatile double S = smear.entropy(fn, en, mu_ref);
+    (void)S;
+  });
+
+  std::mt19937 gen(7);
+  auto Hij = random_hpd(nbands, gen);
+  auto fk = fn[std::make_pair(0, 0)];
+  double dmu_deta = smearing<smearing_t>::sum_delta(ek, mu, T, mo) / kT;
+  GradEta<smearing_t> grad_eta(T, 1.0);
+  runner.run(prefix + "/g_eta", params, [&]() {
+    auto g = grad_eta.g_eta(Hij, mu, 1.0, ek, fk, dmu_deta, 0.1, mo);
+  });
+}
+
+std::vector<std::pair<int, int>>
+parse_shapes(const std::string& s)
+{
+  std::vector<std::pair<int, int>> shapes;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    auto pos = item.find('x');
+    if (pos == std::string::npos) throw std::runtime_error("invalid shape: " + item);
+    shapes.emplace_back(std::stoi(item.substr(0, pos)), std::stoi(item.substr(pos + 1)));
+  }
+  return shapes;
+}
+
+}  // namespace
+
+void
+run(int argc, char* argv[])
+{
+  bench::runner runner;
+  std::string fname = "nlcglib_microbench.json";
+  std::vector<std::pair<int, int>> shapes{{2000, 50}, {8000, 200}, {20000, 500}};
+
+  // arguments left by Kokkos::initialize (--kokkos-*) or the MPI launcher are skipped
+  bool master = Communicator(MPI_COMM_WORLD).rank() == 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) throw std::runtime_error("missing value for " + arg);
+      return argv[++i];
+    };
+    if (arg == "--out")
+      fname = value();
+    else if (arg == "--shapes")
+      shapes = parse_shapes(value());
+    else if (arg == "--min-time")
+      runner.min_time = std::stod(value());
+    else if (arg == "--filter")
+      runner.filter = value();
+    else if (arg.compare(0, 9, "--kokkos-") != 0 && master)
+      std::cerr << "nlcglib_microbench: ignoring unknown argument " << arg << "\n";
+  }
+
+  for (auto& shape : shapes) {
+    bench_la(runner, shape.first, shape.second);
+    bench_smearing<smearing_type::FERMI_DIRAC>(runner, shape.second);
+    bench_smearing<smearing_type::GAUSSIAN_SPLINE>(runner, shape.second);
+    bench_smearing<smearing_type::GAUSS>(runner, shape.second);
+    bench_smearing<smearing_type::METHFESSEL_PAXTON>(runner, shape.second);
+    bench_smearing<smearing_type::COLD>(runner, shape.second);
+  }
+
+  auto results = runner.results();
+  results["kokkos_execution_space"] = Kokkos::DefaultHostExecutionSpace::name();
+  results["concurrency"] = Kokkos::DefaultHostExecutionSpace::concurrency();
+  if (Communicator(MPI_COMM_WORLD).rank() == 0) {
+    std::ofstream fout(fname);
+    fout << results.dump(2) << "\n";
+  }
+}
+
+int
+main(int argc, char* argv[])
+{
+  Communicator::init(argc, argv);
+  Kokkos::initialize(argc, argv);
+
+  run(argc, argv);
+
+  Kokkos::finalize();
+  Communicator::finalize();
+  return 0;
+}
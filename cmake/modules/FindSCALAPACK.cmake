@@ -0,0 +1,40 @@
+#.rst:
+# FindSCALAPACK
+# -------------
+#
+# Find a generic (netlib / OpenMPI / MPICH) ScaLAPACK library, the BLACS are
+# expected to be part of libscalapack.
+#
+# The following variables are set
+#
+# ::
+#
+#   SCALAPACK_FOUND       - True if ScaLAPACK is found
+#   SCALAPACK_LIBRARIES   - The required libraries
+#
+# The following import target is created
+#
+# ::
+#
+#   SCALAPACK::scalapack
+
+if(NOT POLICY CMP0074)
+  set(_SCALAPACK_PATHS ${SCALAPACK_ROOT} $ENV{SCALAPACK_ROOT})
+endif()
+
+find_library(
+  SCALAPACK_LIBRARIES
+  NAMES scalapack scalapack-openmpi scalapack-mpich
+  HINTS ${_SCALAPACK_PATHS}
+  PATH_SUFFIXES "lib" "lib64"
+)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(SCALAPACK REQUIRED_VARS SCALAPACK_LIBRARIES)
+
+if(SCALAPACK_FOUND AND NOT TARGET SCALAPACK::scalapack)
+  add_library(SCALAPACK::scalapack INTERFACE IMPORTED)
+  set_property(TARGET SCALAPACK::scalapack PROPERTY INTERFACE_LINK_LIBRARIES ${SCALAPACK_LIBRARIES})
+endif()
+
+mark_as_advanced(SCALAPACK_FOUND SCALAPACK_LIBRARIES)
@@ -24,11 +24,31 @@ MACRO(NLCGLIB_SETUP_TARGET _target)
   target_compile_definitions(${_target} PUBLIC $<$<BOOL:${USE_OPENMP}>:__USE_OPENMP>)
   if(LAPACK_VENDOR MATCHES MKL)
     target_compile_definitions(${_target} PUBLIC __USE_MKL)
-    target_link_libraries(${_target}  PRIVATE mkl::mkl_intel_32bit_omp_dyn)
+    if(USE_ILP64)
+      target_link_libraries(${_target}  PRIVATE mkl::mkl_intel_64bit_omp_dyn)
+    else()
+      target_link_libraries(${_target}  PRIVATE mkl::mkl_intel_32bit_omp_dyn)
+    endif()
   else()
     target_link_libraries(${_target} PRIVATE my_lapack)
   endif()
+  if(LAPACK_VENDOR MATCHES OpenBLAS)
+    target_compile_definitions(${_target} PUBLIC __USE_OPENBLAS)
+  endif()
   target_compile_definitions(${_target} PUBLIC $<$<BOOL:${USE_OPENMP}>:__USE_OPENMP>)
   target_compile_definitions(${_target} PUBLIC $<$<BOOL:${USE_CUDA}>:__NLCGLIB__CUDA>)
+  if(USE_ILP64)
+    # MKL_ILP64 / LAPACK_ILP64 switch MKL_INT, lapack_int (and blasint with an OpenBLAS
+    # built with INTERFACE64=1) to 64-bit integers, private s.t. the host code keeps its own BLAS ABI
+    target_compile_definitions(${_target} PRIVATE __NLCGLIB__ILP64 MKL_ILP64 LAPACK_ILP64)
+  endif()
+  if(USE_NUMA)
+    target_compile_definitions(${_target} PRIVATE __NLCGLIB__NUMA)
+    target_link_libraries(${_target} PRIVATE my_numa)
+  endif()
+  if(USE_SCALAPACK)
+    target_compile_definitions(${_target} PRIVATE __NLCGLIB__SCALAPACK)
+    target_link_libraries(${_target} PRIVATE my_scalapack)
+  endif()
   target_include_directories(${_target} PUBLIC $<TARGET_PROPERTY:Kokkos::kokkoscore,INTERFACE_INCLUDE_DIRECTORIES>)
 ENDMACRO()
@@ -2,9 +2,11 @@
 
 #include <array>
 #include <complex>
+#include <cstddef>
 #include <memory>
 #include <map>
 #include <stdexcept>
+#include <string>
 #include <functional>
 #include <vector>
 #include "mpi.h"
@@ -31,6 +33,70 @@ enum class smearing_type
   COLD
 };
 
+/// CG update formula (beta): Fletcher-Reeves, Polak-Ribiere+ (beta >= 0), Hestenes-Stiefel
+/// (beta >= 0)
+enum class cg_update
+{
+  FLETCHER_REEVES,
+  POLAK_RIBIERE_PLUS,
+  HESTENES_STIEFEL
+};
+
+
+/// Counters and wall times [s] collected during a nlcg run.
+struct nlcg_stats
+{
+  /// number of EnergyBase::compute calls
+  int energy_evaluations{0};
+  int line_searches{0};
+  /// quadratic line search failed and fell back to backtracking search
+  int bt_search_fallbacks{0};
+  /// restarts triggered by a failed line search or an ascent direction (not the periodic ones)
+  int forced_restarts{0};
+  /// number of OverlapBase/UltrasoftPrecondBase applications (after caching)
+  int operator_applies{0};
+
+  double time_total{0};
+  /// time spent in EnergyBase::compute
+  double time_energy{0};
+  /// time spent in OpBase::apply, summed over the k-point threads
+  double time_apply{0};
+  double time_line_search{0};
+  double time_descent_direction{0};
+
+  /// CG update formula ("fr", "pr+" or "hs")
+  std::string cg_update{"fr"};
+  /// CG steps restarted by the Powell orthogonality test
+  int powell_restarts{0};
+  /// PR+/HS steps with beta < 0, reset to steepest descent
+  int beta_resets{0};
+
+  /// L-BFGS (nlcg_lbfgs_us_*): number of stored pairs (0: CG), pairs dropped by the curvature
+  /// condition <s, y> > 0 and histories dropped for an ascent direction
+  int lbfgs_history{0};
+  int lbfgs_skipped_pairs{0};
+  int lbfgs_resets{0};
+
+  /// preconditioner kappa of the pseudo-Hamiltonian at the end of the run and number of
+  /// iterations which changed it (adaptive kappa, nlcg_options::kappa_min/kappa_max)
+  double kappa{0};
+  int kappa_updates{0};
+
+  /// contribution of each k-point (ik, ispn) to the squared preconditioned gradient norm
+  /// of the last descent direction
+  std::map<std::pair<int, int>, double> gradient_norm_k;
+
+  /// copies between host and execution space, per phase: (number of copies, bytes)
+  std::map<std::string, std::pair<std::size_t, std::size_t>> transfers;
+
+  /// NUMA-aware mode (nlcg_options::numa): k-points evaluated on their home domain / stolen by a task
+  /// on another domain, and sampled pages of X which are not on the home domain
+  int numa_domains{1};
+  std::size_t numa_local_tasks{0};
+  std::size_t numa_remote_tasks{0};
+  std::size_t numa_sampled_pages{0};
+  std::size_t numa_remote_pages{0};
+};
 
 struct nlcg_info
 {
@@ -38,15 +104,23 @@ struct nlcg_info
   double F;
   double S;
   int iter;
+  nlcg_stats stats;
 };
 
 
+/**
+ * Description of a strided array owned by the host code.
+ *
+ * Sizes and strides are 64-bit, they are narrowed to the BLAS/MPI integer types (32-bit unless
+ * nlcglib is built with USE_ILP64) at the library boundary and an exception is thrown if they do
+ * not fit.
+ */
 template <typename T, int d>
 struct buffer_protocol
 {
   buffer_protocol() = default;
-  buffer_protocol(std::array<int, d> stride,
-                  std::array<int, d> size,
+  buffer_protocol(std::array<std::ptrdiff_t, d> stride,
+                  std::array<std::ptrdiff_t, d> size,
                   T* data,
                   enum memory_type memtype,
                   MPI_Comm mpi_comm=MPI_COMM_SELF)
@@ -59,7 +133,7 @@ struct buffer_protocol
 
   // 1d constructor
   // template<int k=dim, class=std::enable_if_t<k==1>>
-  buffer_protocol(int size,
+  buffer_protocol(std::ptrdiff_t size,
                   T* data,
                   enum memory_type memtype,
                   MPI_Comm mpi_comm= MPI_COMM_SELF)
@@ -71,13 +145,21 @@ struct buffer_protocol
   buffer_protocol(buffer_protocol&&) = default;
   buffer_protocol(const buffer_protocol&) = default;
 
-  std::array<int, d> stride;
-  std::array<int, d> size;
+  std::array<std::ptrdiff_t, d> stride;
+  std::array<std::ptrdiff_t, d> size;
   T* data;
   enum memory_type memtype;
   MPI_Comm mpi_comm{MPI_COMM_SELF};
 };
 
+/**
+ * Buffers of the host code, one per k-point (and spin).
+ *
+ * Lifetime: nlcglib may alias the buffers returned by get() instead of copying them (the
+ * wave-functions, and read-only vectors such as ek and gkvec_ekin). It then holds the
+ * shared_ptr to the BufferBase object for as long as it uses them, hence the buffers must
+ * stay valid and unchanged as long as the object is alive.
+ */
 template<int dim, class numeric_t>
 class BufferBase
 {
@@ -94,7 +176,8 @@ public:
   virtual int size() const = 0;
   /// MPI communicator of i-th entry
   virtual MPI_Comm mpicomm(int i) const = 0;
-  /// MPI communicator over which entries are distributed
+  /// MPI communicator over which entries are distributed, an entry distributed over the ranks
+  /// of mpicomm(i) must be held by exactly one rank of mpicomm()
   virtual MPI_Comm mpicomm() const = 0;
   virtual kindex_t kpoint_index(int i) const = 0;
 };
@@ -115,12 +198,15 @@ public:
   virtual int size() const = 0;
   /// MPI communicator of i-th entry
   virtual MPI_Comm mpicomm(int i) const = 0;
-  /// MPI communicator over which entries are distributed
+  /// MPI communicator over which entries are distributed, an entry distributed over the ranks
+  /// of mpicomm(i) must be held by exactly one rank of mpicomm()
   virtual MPI_Comm mpicomm() const = 0;
   virtual kindex_t kpoint_index(int i) const = 0;
 };
 
 using MatrixBaseZ = BufferBase<2, std::complex<double>>;
+/// real wave-functions (Gamma-point only k-set)
+using MatrixBaseD = BufferBase<2, double>;
 using VectorBaseZ = BufferBase<1, double>;
 using ScalarBaseZ = BufferBase<0, double>;
 
@@ -146,6 +232,28 @@ public:
   virtual void set_chemical_potential(double) = 0;
   virtual double get_chemical_potential() = 0;
   virtual void print_info() const = 0;
+
+  /**
+   * Gamma-point only k-set with real-valued wave-functions.
+   *
+   * If true, the solver works on the real buffers returned by get_C_real, get_hphi_real,
+   * get_sphi_real and calls OpBase::apply_real. The columns must be given in a basis where the
+   * Euclidean inner product is the physical one (e.g. the half G-sphere with the G != 0
+   * coefficients scaled by sqrt(2)).
+   */
+  virtual bool gamma_only() { return false; }
+  virtual std::shared_ptr<MatrixBaseD> get_hphi_real(memory_type)
+  {
+    throw std::runtime_error("EnergyBase::get_hphi_real: not implemented");
+  }
+  virtual std::shared_ptr<MatrixBaseD> get_sphi_real(memory_type)
+  {
+    throw std::runtime_error("EnergyBase::get_sphi_real: not implemented");
+  }
+  virtual std::shared_ptr<MatrixBaseD> get_C_real(memory_type)
+  {
+    throw std::runtime_error("EnergyBase::get_C_real: not implemented");
+  }
 };
 
 class OpBase
@@ -156,7 +264,31 @@ public:
   virtual void apply(const key_t&,
                      MatrixBaseZ::buffer_t& out,
                      MatrixBaseZ::buffer_t& in) const = 0;
+  /// apply to several blocks of the same k-point, host codes may override this to
+  /// compute e.g. the beta-projector overlaps only once for all blocks
+  virtual void apply_batch(const key_t& key,
+                           std::vector<MatrixBaseZ::buffer_t>& out,
+                           std::vector<MatrixBaseZ::buffer_t>& in) const
+  {
+    if (out.size() != in.size()) {
+      throw std::runtime_error("OpBase::apply_batch: number of input and output blocks differ");
+    }
+    for (std::size_t i = 0; i < in.size(); ++i) {
+      this->apply(key, out[i], in[i]);
+    }
+  }
+  /// real-valued variant of apply, required if EnergyBase::gamma_only() is true
+  virtual void apply_real(const key_t&,
+                          MatrixBaseD::buffer_t& out,
+                          MatrixBaseD::buffer_t& in) const
+  {
+    throw std::runtime_error("OpBase::apply_real: not implemented");
+  }
   virtual std::vector<key_t> get_keys() const = 0;
+  /// k-points may be evaluated concurrently (see nlcg_options::kpoint_tasks). By default the
+  /// operators of a solver run are called one at a time. Host codes whose
+  /// apply/apply_batch/apply_real may run concurrently for different k-points return true.
+  virtual bool reentrant() const { return false; }
 };
 
 class OverlapBase : public OpBase
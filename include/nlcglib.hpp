@@ -1,12 +1,89 @@
 #pragma once
 
+#include <memory>
+#include <string>
 #include "interface.hpp"
 
 namespace nlcglib {
 
+/// Initializes Kokkos (unless the caller already did). Calls are counted, the matching last
+/// finalize() finalizes Kokkos if it was initialized here.
 void initialize();
 void finalize();
 
+/// settings of the solver calls made with a nlcg_session
+struct nlcg_options
+{
+  /// defaults, skip_newton_efermi from NLCGLIB_DISABLE_NEWTON_EFERMI, cg from
+  /// NLCGLIB_CG_UPDATE, powell_restart from NLCGLIB_POWELL_RESTART, kpoint_tasks from
+  /// NLCGLIB_KPOINT_TASKS, threads_per_task from NLCGLIB_THREADS_PER_TASK and numa from
+  /// NLCGLIB_NUMA. Throws std::invalid_argument if NLCGLIB_CG_UPDATE is not fr, pr+ or hs.
+  nlcg_options();
+
+  /// text log, written by rank 0 of the solver communicator (empty: none)
+  std::string log_file{"nlcg.out"};
+  /// per-iteration records (JSON lines), written by rank 0 of the solver communicator (empty: none)
+  std::string json_file{"nlcg.json"};
+  /// bisection instead of Newton for the Fermi level of non-monotonous smearings
+  bool skip_newton_efermi{false};
+  /// CG update formula
+  cg_update cg{cg_update::FLETCHER_REEVES};
+  /// restart when |<g, P g_prev>| >= powell_restart * <g, P g> (0: off, typically 0.2)
+  double powell_restart{0};
+  /// adaptive kappa within [kappa_min, kappa_max] if 0 < kappa_min < kappa_max (CG only), the
+  /// kappa argument of the solver call is the initial value. After a change of kappa the eta
+  /// part of the current direction is rescaled to the new kappa.
+  double kappa_min{0};
+  double kappa_max{0};
+  /// k-points evaluated concurrently and BLAS threads per k-point, 0: chosen from the matrix
+  /// sizes and the OpenMP threads. With OpenBLAS the thread count is process-wide and applies to
+  /// k-points evaluated one after the other, see blas_process_threads_scope. Kokkos kernels of
+  /// concurrent k-points run serially on the thread of their task.
+  int kpoint_tasks{0};
+  int threads_per_task{0};
+  /// NUMA-aware placement of the k-point data and pinning of the k-point tasks (libnuma)
+  bool numa{false};
+};
+
+/**
+ * Solver context: options, log sinks and the state kept between calls, e.g. one call per ionic
+ * step of a relaxation or MD run.
+ *
+ * A call of nlcg_us_cpu/nlcg_us_device with a session warm-starts from the previous call: the
+ * chemical potential search starts at the last mu, the line search at the last accepted step,
+ * and the first search direction is conjugated to the last direction of the previous call,
+ * rotated to the new orbitals by their overlap with the previous ones (if the k-points and the
+ * number of bands did not change). That direction is scaled to the size of the new steepest
+ * descent direction and dropped if its slope is not small compared to that of the latter. The state is saved also when the call ends by an exception.
+ * The log files are continued instead of being truncated. The overloads without a session start
+ * from scratch.
+ *
+ * Sessions share no mutable state: calls with different sessions (and different log files) on
+ * disjoint communicators, e.g. the images of a NEB calculation, may run at the same time.
+ */
+class nlcg_session
+{
+public:
+  struct state;
+
+  explicit nlcg_session(const nlcg_options& options = nlcg_options());
+  ~nlcg_session();
+  nlcg_session(const nlcg_session&) = delete;
+  nlcg_session& operator=(const nlcg_session&) = delete;
+
+  /// forget the warm-start data, the next call starts from scratch (log files are continued)
+  void reset();
+  /// number of solver calls made with this session
+  int num_runs() const;
+
+  const nlcg_options& options() const;
+
+  state& get() { return *state_; }
+
+private:
+  std::unique_ptr<state> state_;
+};
+
 nlcg_info
 nlcg_mvp2_cpu(EnergyBase& energy_base,
               smearing_type smearing,
@@ -57,6 +134,20 @@ nlcg_us_device(EnergyBase& energy_base,
                int maxiter,
                int restart);
 
+/// warm-started from the previous call with the same session
+nlcg_info
+nlcg_us_device(EnergyBase& energy_base,
+               UltrasoftPrecondBase& us_precond_base,
+               OverlapBase& overlap_base,
+               smearing_type smear,
+               double T,
+               double tol,
+               double kappa,
+               double tau,
+               int maxiter,
+               int restart,
+               nlcg_session& session);
+
 nlcg_info
 nlcg_us_cpu(EnergyBase& energy_base,
             UltrasoftPrecondBase& us_precond_base,
@@ -69,6 +160,20 @@ nlcg_us_cpu(EnergyBase& energy_base,
             int maxiter,
             int restart);
 
+/// warm-started from the previous call with the same session
+nlcg_info
+nlcg_us_cpu(EnergyBase& energy_base,
+            UltrasoftPrecondBase& us_precond_base,
+            OverlapBase& overlap_base,
+            smearing_type smear,
+            double T,
+            double tol,
+            double kappa,
+            double tau,
+            int maxiter,
+            int restart,
+            nlcg_session& session);
+
 nlcg_info
 nlcg_us_device_cpu(EnergyBase& energy_base,
                    UltrasoftPrecondBase& us_precond_base,
@@ -81,6 +186,20 @@ nlcg_us_device_cpu(EnergyBase& energy_base,
                    int maxiter,
                    int restart);
 
+/// warm-started from the previous call with the same session
+nlcg_info
+nlcg_us_device_cpu(EnergyBase& energy_base,
+                   UltrasoftPrecondBase& us_precond_base,
+                   OverlapBase& overlap_base,
+                   smearing_type smear,
+                   double T,
+                   double tol,
+                   double kappa,
+                   double tau,
+                   int maxiter,
+                   int restart,
+                   nlcg_session& session);
+
 nlcg_info
 nlcg_us_cpu_device(EnergyBase& energy_base,
                    UltrasoftPrecondBase& us_precond_base,
@@ -93,6 +212,78 @@ nlcg_us_cpu_device(EnergyBase& energy_base,
                    int maxiter,
                    int restart);
 
+/// warm-started from the previous call with the same session
+nlcg_info
+nlcg_us_cpu_device(EnergyBase& energy_base,
+                   UltrasoftPrecondBase& us_precond_base,
+                   OverlapBase& overlap_base,
+                   smearing_type smear,
+                   double T,
+                   double tol,
+                   double kappa,
+                   double tau,
+                   int maxiter,
+                   int restart,
+                   nlcg_session& session);
+/**
+ * L-BFGS instead of nonlinear CG, with the same energy, preconditioner and geodesic line search.
+ *
+ * The search direction is the two-loop recursion over the last `history` steps, the preconditioner
+ * is the initial inverse Hessian. Each k-point stores 3 * history matrices of the size of X
+ * (and of eta). The line search starts at the unit step.
+ */
+nlcg_info
+nlcg_lbfgs_us_cpu(EnergyBase& energy_base,
+                  UltrasoftPrecondBase& us_precond_base,
+                  OverlapBase& overlap_base,
+                  smearing_type smear,
+                  double T,
+                  double tol,
+                  double kappa,
+                  double tau,
+                  int maxiter,
+                  int history);
+
+/// warm-started (chemical potential, line search step) from the previous call with the same session
+nlcg_info
+nlcg_lbfgs_us_cpu(EnergyBase& energy_base,
+                  UltrasoftPrecondBase& us_precond_base,
+                  OverlapBase& overlap_base,
+                  smearing_type smear,
+                  double T,
+                  double tol,
+                  double kappa,
+                  double tau,
+                  int maxiter,
+                  int history,
+                  nlcg_session& session);
+
+nlcg_info
+nlcg_lbfgs_us_device(EnergyBase& energy_base,
+                     UltrasoftPrecondBase& us_precond_base,
+                     OverlapBase& overlap_base,
+                     smearing_type smear,
+                     double T,
+                     double tol,
+                     double kappa,
+                     double tau,
+                     int maxiter,
+                     int history);
+
+/// warm-started (chemical potential, line search step) from the previous call with the same session
+nlcg_info
+nlcg_lbfgs_us_device(EnergyBase& energy_base,
+                     UltrasoftPrecondBase& us_precond_base,
+                     OverlapBase& overlap_base,
+                     smearing_type smear,
+                     double T,
+                     double tol,
+                     double kappa,
+                     double tau,
+                     int maxiter,
+                     int history,
+                     nlcg_session& session);
+
 
 // void nlcg_check_gradient_host(EnergyBase& energy);
 
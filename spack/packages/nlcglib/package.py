@@ -23,6 +23,7 @@ class Nlcglib(CMakePackage, CudaPackage):
     variant('openmp', default=True)
     variant('cuda', default=False)
     variant('tests', default=False)
+    variant('scalapack', default=False, description="Use ScaLAPACK for large dense eigenvalue problems")
     variant('build_type',
             default="Release",
             description="CMake build type",
@@ -40,6 +41,7 @@ class Nlcglib(CMakePackage, CudaPackage):
     depends_on('kokkos+cuda', when='+cuda')
     depends_on('googletest', type='build', when='+tests')
     depends_on('nlohmann-json')
+    depends_on('scalapack', when='+scalapack')
 
     def cmake_args(self):
         options = []
@@ -61,6 +63,11 @@ class Nlcglib(CMakePackage, CudaPackage):
         else:
             options.append('-DBUILD_TESTS=Off')
 
+        if '+scalapack' in self.spec:
+            options.append('-DUSE_SCALAPACK=On')
+        else:
+            options.append('-DUSE_SCALAPACK=Off')
+
         if '+wrapper' in self.spec:
             options.append(
                 '-DCMAKE_CXX_COMPILER=%s' % self.spec['kokkos-nvcc-wrapper'].kokkos_cxx
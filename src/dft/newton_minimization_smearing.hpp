@@ -39,7 +39,7 @@ newton_minimization_chemical_potential(Nt&& N, DNt&& dN, D2Nt&& ddN, double mu0,
         // std::printf("%d Nf: %.4f, dNf: %.4f, ddF: %.4f, mu: %.4f\n", iter, Nf, dNf, ddF, mu);
 
         if (std::abs(ddF) < 1e-10) {
-          Logger::GetInstance() << "*Warning* Newton minimization failed (2nd deriv~=0) to find the Fermi energy, "
+          NLCGLIB_LOG_WARNING << "Newton minimization failed (2nd deriv~=0) to find the Fermi energy, "
                                    "using bisection search.\n";
           throw failed_to_converge();
           // TERMINATE(s);
@@ -59,7 +59,7 @@ newton_minimization_chemical_potential(Nt&& N, DNt&& dN, D2Nt&& ddN, double mu0,
         iter++;
         if (iter > maxstep) {
             std::stringstream s;
-            Logger::GetInstance() << "*Warning* Newton minimization failed (maxsteps) to find the Fermi energy, using bisection search.\n";
+            NLCGLIB_LOG_WARNING << "Newton minimization failed (maxsteps) to find the Fermi energy, using bisection search.\n";
             std::cout << "Newton failed" << "\n";
             s << "Newton minimization (chemical potential) failed after 10000 steps!\n";
             throw failed_to_converge();
@@ -1,9 +1,11 @@
 #pragma once
 
 #include <Kokkos_Core.hpp>
+#include <chrono>
 #include "constants.hpp"
 #include "interface.hpp"
 #include "smearing.hpp"
+#include "utils/profiler.hpp"
 
 namespace nlcglib {
 
@@ -18,11 +20,17 @@ public:
 
   void compute();
 
+  /// numeric_t = double: real-valued buffers of a Gamma-point only EnergyBase
+  template <class numeric_t = Kokkos::complex<double>>
   auto get_X();
+  template <class numeric_t = Kokkos::complex<double>>
   auto get_HX();
+  template <class numeric_t = Kokkos::complex<double>>
   auto get_SX();
   auto get_fn();
   auto get_ek();
+  /// read-only ek without a copy, aliases the buffers of EnergyBase (see make_mmvector_view)
+  auto get_ek_view();
   auto get_wk();
   auto get_gkvec_ekin();
   double occupancy();
@@ -37,7 +45,25 @@ public:
   Smearing& get_smearing() { return smearing; }
   double get_chemical_potential() const { return energy.get_chemical_potential(); }
 
+  /// number of EnergyBase::compute calls
+  int num_evaluations() const { return num_evaluations_; }
+  /// time spent in EnergyBase::compute [s]
+  double time_compute() const { return time_compute_; }
+
 private:
+  /// EnergyBase::compute with accounting
+  void compute_energy();
+
+  /// host buffers of EnergyBase, selected by the numeric type of the wave-functions
+  std::shared_ptr<MatrixBaseZ> host_C(Kokkos::complex<double>) { return energy.get_C(memory_type::host); }
+  std::shared_ptr<MatrixBaseD> host_C(double) { return energy.get_C_real(memory_type::host); }
+  std::shared_ptr<MatrixBaseZ> host_hphi(Kokkos::complex<double>) { return energy.get_hphi(memory_type::host); }
+  std::shared_ptr<MatrixBaseD> host_hphi(double) { return energy.get_hphi_real(memory_type::host); }
+  std::shared_ptr<MatrixBaseZ> host_sphi(Kokkos::complex<double>) { return energy.get_sphi(memory_type::host); }
+  std::shared_ptr<MatrixBaseD> host_sphi(double) { return energy.get_sphi_real(memory_type::host); }
+
+  int num_evaluations_{0};
+  double time_compute_{0};
   double T;
   double free_energy;
   double entropy;
@@ -62,6 +88,7 @@ template <class tF, class tX, class tE>
 void
 FreeEnergy::compute(const mvector<tX>& X, const mvector<tF>& fn, const mvector<tE>& en, double mu)
 {
+  NLCGLIB_PROFILE_REGION("energy compute");
   // convert fn to std::vector
   auto map_fn = tapply(
       [](auto fi) {
@@ -77,7 +104,8 @@ FreeEnergy::compute(const mvector<tX>& X, const mvector<tF>& fn, const mvector<t
   for (auto& fi : map_fn) vec_fn.push_back(eval(fi.second));
   for (auto& fi : map_fn) key_fn.push_back(eval(fi.first));
 
-  auto Xsirius = make_mmatrix<Kokkos::HostSpace>(this->energy.get_C(memory_type::host));
+  using numeric_t = typename eval_t<tX>::numeric_t;
+  auto Xsirius = make_mmatrix<Kokkos::HostSpace>(this->host_C(numeric_t{}));
   execute(tapply(
       [](auto x_sirius, auto x) {
         auto xh = Kokkos::create_mirror(x.array());
@@ -90,7 +118,7 @@ FreeEnergy::compute(const mvector<tX>& X, const mvector<tF>& fn, const mvector<t
       X));
 
   energy.set_fn(key_fn, vec_fn);
-  energy.compute();
+  this->compute_energy();
 
   // update fermi energy in SIRIUS (no effect here, but make sure to leave SIRIUS in a consistent state)
   energy.set_chemical_potential(mu);
@@ -102,30 +130,42 @@ FreeEnergy::compute(const mvector<tX>& X, const mvector<tF>& fn, const mvector<t
   free_energy = etot + entropy;
 }
 
+void
+FreeEnergy::compute_energy()
+{
+  auto t0 = std::chrono::steady_clock::now();
+  energy.compute();
+  time_compute_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  num_evaluations_++;
+}
+
 auto
 FreeEnergy::get_fn()
 {
   return make_mmvector<Kokkos::HostSpace>(this->energy.get_fn());
 }
 
+template <class numeric_t>
 auto
 FreeEnergy::get_X()
 {
-  return make_mmatrix<Kokkos::HostSpace>(this->energy.get_C(memory_type::host));
+  return make_mmatrix<Kokkos::HostSpace>(this->host_C(numeric_t{}));
 }
 
 
+template <class numeric_t>
 auto
 FreeEnergy::get_HX()
 {
-  return make_mmatrix<Kokkos::HostSpace>(this->energy.get_hphi(memory_type::host));
+  return make_mmatrix<Kokkos::HostSpace>(this->host_hphi(numeric_t{}));
 }
 
 
+template <class numeric_t>
 auto
 FreeEnergy::get_SX()
 {
-  return make_mmatrix<Kokkos::HostSpace>(this->energy.get_sphi(memory_type::host));
+  return make_mmatrix<Kokkos::HostSpace>(this->host_sphi(numeric_t{}));
 }
 
 auto
@@ -134,6 +174,12 @@ FreeEnergy::get_ek()
   return make_mmvector<Kokkos::HostSpace>(this->energy.get_ek());
 }
 
+auto
+FreeEnergy::get_ek_view()
+{
+  return make_mmvector_view<Kokkos::HostSpace>(this->energy.get_ek());
+}
+
 auto
 FreeEnergy::get_wk()
 {
@@ -167,7 +213,8 @@ FreeEnergy::ks_energy_components()
 void
 FreeEnergy::compute()
 {
-  energy.compute();
+  NLCGLIB_PROFILE_REGION("energy compute");
+  this->compute_energy();
 }
 
 
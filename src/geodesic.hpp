@@ -4,6 +4,8 @@
 
 #include "la/utils.hpp"
 #include "la/lapack.hpp"
+#include "utils/profiler.hpp"
+#include "utils/transfer_stats.hpp"
 
 namespace nlcglib {
 
@@ -12,8 +14,11 @@ struct advance_eta
 {
   advance_eta(double t) : t(t) {}
 
+  /// eta_next has the numeric type of d_eta (eta = diag(ek) is real)
   template <class eta_t, class d_eta_t>
-  KokkosDVector<Kokkos::complex<double>**, nlcglib::SlabLayoutV, Kokkos::LayoutLeft,
+  KokkosDVector<typename std::remove_reference_t<d_eta_t>::numeric_t**,
+                nlcglib::SlabLayoutV,
+                Kokkos::LayoutLeft,
                 typename std::remove_reference_t<eta_t>::storage_t::memory_space>
   operator()(eta_t&& eta, d_eta_t&& d_eta)
   {
@@ -71,16 +76,18 @@ struct advance_x
     return transform_alloc(x_next, eval(ul));
   }
 
-  // ultra-soft case
-  template <class x_t, class dx_t, class ul_t, class op_t>
+  /// ultra-soft case, S (X + t dX) = S X + t S dX is formed from sx = S X and sdx = S dX
+  template <class x_t, class dx_t, class ul_t, class sx_t, class sdx_t>
   to_layout_left_t<std::remove_reference_t<dx_t>>
-  operator()(x_t&& x, dx_t&& dx, ul_t&& ul, op_t&& s)
+  operator()(x_t&& x, dx_t&& dx, ul_t&& ul, sx_t&& sx, sdx_t&& sdx)
   {
-    // pp<to_layout_left_t<dx_t>>::foo;
     auto x_next = empty_like()(x);
     deep_copy(x_next, x);
     add(x_next, eval(dx), t);
-    x_next = loewdin(x_next, eval(s(x_next)));
+    auto sx_next = empty_like()(sx);
+    deep_copy(sx_next, sx);
+    add(sx_next, eval(sdx), t);
+    x_next = loewdin(x_next, sx_next);
     return transform_alloc(x_next, eval(ul));
   }
 
@@ -135,10 +142,16 @@ struct advance_x
 
 
 namespace impl {
-template <class X_t, class eta_t, class g_x_t, class g_eta_t, class Op_t>
+/// SX, SZ: S X and S Z_X
+template <class X_t, class eta_t, class g_x_t, class g_eta_t, class sx_t, class sz_t>
 auto
-geodesic_us(
-    X_t& X, const eta_t& eta, const g_x_t& z_x, const g_eta_t& z_eta, const Op_t& S, double t)
+geodesic_us(X_t& X,
+            const eta_t& eta,
+            const g_x_t& z_x,
+            const g_eta_t& z_eta,
+            const sx_t& SX,
+            const sz_t& SZ,
+            double t)
 {
   // compute eta_next <- eta + t* g_eta
   auto eta_next = local::advance_eta(t)(eta, z_eta);
@@ -149,18 +162,26 @@ geodesic_us(
   auto Ul = std::get<1>(ek_Ul);
 
   // X <- ortho((X + t*g_X) @ Ul)
-  auto x_next = local::advance_x(t)(X, z_x, Ul, S);
+  auto x_next = local::advance_x(t)(X, z_x, Ul, SX, SZ);
 
   return std::make_tuple(ek, Ul, x_next);
 }
 
 
-template <class mem_space_t>
+/// RESIDENT: X, eta, Z are expected in mem_space and Ul, X(t) are returned there
+/// mirrors: otherwise the copies of X, eta, Z are shared with the other trial steps and the
+/// descent direction of the iteration (may be nullptr), see exec_space_mirrors
+template <class mem_space_t, bool RESIDENT = false>
 struct geodesic_us_functor
 {
-  geodesic_us_functor(const mem_space_t& mem_space, double t)
+  geodesic_us_functor(const mem_space_t& mem_space,
+                      double t,
+                      transfer_stats* transfers = nullptr,
+                      exec_space_mirrors* mirrors = nullptr)
       : mem_space(mem_space)
       , t(t)
+      , transfers(transfers)
+      , mirrors(mirrors)
   {
   }
 
@@ -169,30 +190,43 @@ struct geodesic_us_functor
       const X_t& X_h, const eta_t& eta_h, const z_x_t& z_x_h, const z_eta_t& z_eta_h, const Op_t& S)
 
   {
-    // todo
-    auto X = create_mirror_view_and_copy(mem_space, X_h);
-    auto eta = create_mirror_view_and_copy(mem_space, eta_h);
-    auto z_x = create_mirror_view_and_copy(mem_space, z_x_h);
-    auto z_eta = create_mirror_view_and_copy(mem_space, z_eta_h);
-
-    auto result = eval(impl::geodesic_us(X, eta, z_x, z_eta, S, t));
-
-    // copy results to host
-    auto ek = Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace(), std::get<0>(result));
-    auto Ul = create_mirror_view_and_copy(Kokkos::HostSpace(), std::get<1>(result));
-    auto x_next_h = create_mirror_view_and_copy(Kokkos::HostSpace(), std::get<2>(result));
-    return std::make_tuple(ek, Ul, x_next_h);
+    const char* phase = "geodesic";
+    auto X = to_exec_space<RESIDENT>(mem_space, X_h, phase, transfers, mirrors);
+    auto eta = to_exec_space<RESIDENT>(mem_space, eta_h, phase, transfers, mirrors);
+    auto z_x = to_exec_space<RESIDENT>(mem_space, z_x_h, phase, transfers, mirrors);
+    auto z_eta = to_exec_space<RESIDENT>(mem_space, z_eta_h, phase, transfers, mirrors);
+    // S X and S Z in one (batched) call, applied to the execution space buffers of the iteration
+    // s.t. the results are cached across the trial steps of a line search (S X usually by the
+    // descent direction)
+    auto sx_sz = S(X, z_x);
+
+    auto result =
+        eval(impl::geodesic_us(X, eta, z_x, z_eta, std::get<0>(sx_sz), std::get<1>(sx_sz), t));
+
+    // eigenvalues are always needed on the host (smearing)
+    auto ek = counted_mirror(Kokkos::HostSpace(), std::get<0>(result), phase, transfers);
+    auto Ul = from_exec_space<RESIDENT>(std::get<1>(result), phase, transfers);
+    auto x_next = from_exec_space<RESIDENT>(std::get<2>(result), phase, transfers);
+    return std::make_tuple(ek, Ul, x_next);
   }
 
   mem_space_t mem_space;
   double t;
+  transfer_stats* transfers;
+  exec_space_mirrors* mirrors;
 };
 
 }  // namespace impl
 
 /// Geodesic for Ultrasoft PP formulation
-/// returns tuple<ek, Ul, X>
-template <class mem_space_t, class X_t, class eta_t, class z_x_t, class z_eta_t, class Op_t>
+/// returns tuple<ek, Ul, X>, ek on the host, Ul and X in mem_space if RESIDENT
+template <bool RESIDENT = false,
+          class mem_space_t,
+          class X_t,
+          class eta_t,
+          class z_x_t,
+          class z_eta_t,
+          class Op_t>
 auto
 geodesic(const mem_space_t& mem_space,
          const X_t& X_h,
@@ -200,9 +234,12 @@ geodesic(const mem_space_t& mem_space,
          const z_x_t& z_x_h,
          const z_eta_t& z_eta_h,
          const Op_t& S,
-         double t)
+         double t,
+         transfer_stats* transfers = nullptr,
+         exec_space_mirrors* mirrors = nullptr)
 {
-  impl::geodesic_us_functor<mem_space_t> functor(mem_space, t);
+  NLCGLIB_PROFILE_REGION("geodesic");
+  impl::geodesic_us_functor<mem_space_t, RESIDENT> functor(mem_space, t, transfers, mirrors);
 
   auto res = tapply_async(functor, X_h, eta_h, z_x_h, z_eta_h, S);
 
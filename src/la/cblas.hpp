@@ -11,6 +11,7 @@
 
 #include <complex>
 #include <Kokkos_Core.hpp>
+#include "utils/checked_cast.hpp"
 
 
 #ifdef __USE_MKL
@@ -22,6 +23,31 @@
 namespace nlcglib {
 namespace cblas {
 
+/// integer type of the BLAS/LAPACK interface, 64-bit if built with USE_ILP64
+#if defined(__USE_MKL)
+using blas_int = MKL_INT;
+#elif defined(__USE_OPENBLAS)
+using blas_int = blasint;
+#else
+using blas_int = lapack_int;
+#endif
+
+#ifdef __NLCGLIB__ILP64
+static_assert(sizeof(blas_int) == 8 && sizeof(lapack_int) == 8,
+              "USE_ILP64: the BLAS/LAPACK headers do not provide 64-bit integers");
+#endif
+
+/// narrow a matrix dimension or leading dimension to blas_int, throws on overflow
+template <class T>
+inline blas_int
+to_blas_int(T n)
+{
+#ifdef __NLCGLIB__ILP64
+  return checked_cast<blas_int>(n, "cblas");
+#else
+  return checked_cast<blas_int>(n, "cblas (configure with USE_ILP64=On)");
+#endif
+}
 
 struct blas_base
 {
@@ -46,12 +72,12 @@ struct zheevd
 template<>
 struct zheevd<std::complex<double>> : lapack_base
 {
-  inline int static call(CBLAS_ORDER order,
+  inline lapack_int static call(CBLAS_ORDER order,
                          char jobz,
                          char uplo,
-                         int n,
+                         blas_int n,
                          std::complex<double>* a,
-                         const int lda,
+                         const blas_int lda,
                          double* w)
   {
     return LAPACKE_zheevd(order, jobz, uplo, n, reinterpret_cast<CPX *>(a), lda, w);
@@ -62,12 +88,12 @@ struct zheevd<std::complex<double>> : lapack_base
 template <>
 struct zheevd<Kokkos::complex<double>> : lapack_base
 {
-  inline int static call(CBLAS_ORDER order,
+  inline lapack_int static call(CBLAS_ORDER order,
                          char jobz,
                          char uplo,
-                         int n,
+                         blas_int n,
                          Kokkos::complex<double> *a,
-                         const int lda,
+                         const blas_int lda,
                          double *w)
   {
     return LAPACKE_zheevd(order, jobz, uplo, n, reinterpret_cast<CPX *>(a), lda, w);
@@ -75,17 +101,29 @@ struct zheevd<Kokkos::complex<double>> : lapack_base
 };
 
 
+/// real symmetric (Gamma-point)
+template <>
+struct zheevd<double> : lapack_base
+{
+  inline lapack_int static call(
+      CBLAS_ORDER order, char jobz, char uplo, blas_int n, double *a, const blas_int lda, double *w)
+  {
+    return LAPACKE_dsyevd(order, jobz, uplo, n, a, lda, w);
+  }
+};
+
+
 template <typename T>
 struct potrf {};
 
 template<>
 struct potrf<std::complex<double>> : lapack_base
 {
-  inline int static call(CBLAS_ORDER order,
+  inline lapack_int static call(CBLAS_ORDER order,
                          char uplo,
-                         int n,
+                         blas_int n,
                          std::complex<double>* a,
-                         int lda)
+                         blas_int lda)
   {
      return LAPACKE_zpotrf(LAPACK_COL_MAJOR, uplo, n, reinterpret_cast<CPX *>(a), lda);
   }
@@ -94,27 +132,37 @@ struct potrf<std::complex<double>> : lapack_base
 template <>
 struct potrf<Kokkos::complex<double>> : lapack_base
 {
-  inline int static call(CBLAS_ORDER order, char uplo, int n, Kokkos::complex<double> *a, int lda)
+  inline lapack_int static call(CBLAS_ORDER order, char uplo, blas_int n, Kokkos::complex<double> *a, blas_int lda)
   {
      return LAPACKE_zpotrf(LAPACK_COL_MAJOR, uplo, n, reinterpret_cast<CPX *>(a), lda);
   }
 };
 
 
+template <>
+struct potrf<double> : lapack_base
+{
+  inline lapack_int static call(CBLAS_ORDER order, char uplo, blas_int n, double *a, blas_int lda)
+  {
+     return LAPACKE_dpotrf(LAPACK_COL_MAJOR, uplo, n, a, lda);
+  }
+};
+
+
 template <typename T>
 struct potrs {};
 
 template<>
 struct potrs<std::complex<double>> : lapack_base
 {
-  inline int static call(CBLAS_ORDER order,
+  inline lapack_int static call(CBLAS_ORDER order,
                          char uplo,
-                         int n,
-                         int nrhs,
+                         blas_int n,
+                         blas_int nrhs,
                          std::complex<double>* a,
-                         int lda,
+                         blas_int lda,
                          std::complex<double>* b,
-                         int ldb)
+                         blas_int ldb)
   {
     return LAPACKE_zpotrs(order,
                           uplo,
@@ -130,14 +178,14 @@ struct potrs<std::complex<double>> : lapack_base
 template <>
 struct potrs<Kokkos::complex<double>> : lapack_base
 {
-  inline int static call(CBLAS_ORDER order,
+  inline lapack_int static call(CBLAS_ORDER order,
                          char uplo,
-                         int n,
-                         int nrhs,
+                         blas_int n,
+                         blas_int nrhs,
                          Kokkos::complex<double> *a,
-                         int lda,
+                         blas_int lda,
                          Kokkos::complex<double> *b,
-                         int ldb)
+                         blas_int ldb)
   {
     return LAPACKE_zpotrs(order,
                           uplo,
@@ -150,13 +198,30 @@ struct potrs<Kokkos::complex<double>> : lapack_base
   }
 };
 
+template <>
+struct potrs<double> : lapack_base
+{
+  inline lapack_int static call(CBLAS_ORDER order,
+                         char uplo,
+                         blas_int n,
+                         blas_int nrhs,
+                         double *a,
+                         blas_int lda,
+                         double *b,
+                         blas_int ldb)
+  {
+    return LAPACKE_dpotrs(order, uplo, n, nrhs, a, lda, b, ldb);
+  }
+};
+
 template <typename T>
 struct getrf {};
 
 template <>
 struct getrf<Kokkos::complex<double>> : lapack_base
 {
-  inline int static call(CBLAS_ORDER order, int m, int n, Kokkos::complex<double>* A, int lda, int* ipiv)
+  inline lapack_int static call(
+      CBLAS_ORDER order, blas_int m, blas_int n, Kokkos::complex<double>* A, blas_int lda, lapack_int* ipiv)
   {
     return LAPACKE_zgetrf(order, m, n, reinterpret_cast<CPX *>(A), lda, ipiv);
   }
@@ -168,15 +233,15 @@ struct getrs {};
 template <>
 struct getrs<Kokkos::complex<double>> : lapack_base
 {
-  inline int static call(CBLAS_ORDER order,
+  inline lapack_int static call(CBLAS_ORDER order,
                          char uplo,
-                         int n,
-                         int nrhs,
+                         blas_int n,
+                         blas_int nrhs,
                          const Kokkos::complex<double> *A,
-                         int lda,
-                         int *ipiv,
+                         blas_int lda,
+                         lapack_int *ipiv,
                          Kokkos::complex<double> *B,
-                         int ldb)
+                         blas_int ldb)
   {
     return LAPACKE_zgetrs(order,
                           uplo,
@@ -203,17 +268,17 @@ struct gemm<std::complex<double>> : blas_base
   inline static void call(const CBLAS_ORDER Order,
                           const CBLAS_TRANSPOSE TransA,
                           const CBLAS_TRANSPOSE TransB,
-                          const int M,
-                          const int N,
-                          const int K,
+                          const blas_int M,
+                          const blas_int N,
+                          const blas_int K,
                           const std::complex<double> alpha,
                           const std::complex<double> *A,
-                          const int lda,
+                          const blas_int lda,
                           const void *B,
-                          const int ldb,
+                          const blas_int ldb,
                           const std::complex<double> beta,
                           std::complex<double> *C,
-                          const int ldc)
+                          const blas_int ldc)
   {
     cblas_zgemm(Order,
                 TransA,
@@ -240,17 +305,17 @@ struct gemm<Kokkos::complex<double>> : blas_base
   inline static void call(const CBLAS_ORDER Order,
                           const CBLAS_TRANSPOSE TransA,
                           const CBLAS_TRANSPOSE TransB,
-                          const int M,
-                          const int N,
-                          const int K,
+                          const blas_int M,
+                          const blas_int N,
+                          const blas_int K,
                           const Kokkos::complex<double> alpha,
                           const Kokkos::complex<double> *A,
-                          const int lda,
+                          const blas_int lda,
                           const void *B,
-                          const int ldb,
+                          const blas_int ldb,
                           const Kokkos::complex<double> beta,
                           Kokkos::complex<double> *C,
-                          const int ldc)
+                          const blas_int ldc)
   {
     cblas_zgemm(Order,
                 TransA,
@@ -270,7 +335,6 @@ struct gemm<Kokkos::complex<double>> : blas_base
 };
 
 
-
 template <>
 struct gemm<double> : blas_base
 {
@@ -278,17 +342,17 @@ struct gemm<double> : blas_base
   inline static void call(const CBLAS_ORDER Order,
                           const CBLAS_TRANSPOSE TransA,
                           const CBLAS_TRANSPOSE TransB,
-                          const int M,
-                          const int N,
-                          const int K,
+                          const blas_int M,
+                          const blas_int N,
+                          const blas_int K,
                           const double alpha,
                           const double *A,
-                          const int lda,
+                          const blas_int lda,
                           const double *B,
-                          const int ldb,
+                          const blas_int ldb,
                           const double beta,
                           double *C,
-                          const int ld)
+                          const blas_int ld)
   {
     cblas_dgemm(Order, TransA, TransB, M, N, K, alpha, A, lda, B, ldb, beta, C, ld);
   }
@@ -305,16 +369,16 @@ struct geam<Kokkos::complex<double>> : blas_base
   inline static void call(const CBLAS_ORDER Order,
                           const CBLAS_TRANSPOSE TransA,
                           const CBLAS_TRANSPOSE TransB,
-                          const int M,
-                          const int N,
+                          const blas_int M,
+                          const blas_int N,
                           Kokkos::complex<double> alpha,
                           const Kokkos::complex<double> *A,
-                          const int lda,
+                          const blas_int lda,
                           Kokkos::complex<double> beta,
                           const Kokkos::complex<double>* B,
-                          const int ldb,
+                          const blas_int ldb,
                           Kokkos::complex<double> *C,
-                          const int ldc)
+                          const blas_int ldc)
   {
 #ifdef __USE_MKL
     char c_ordering{'C'};
@@ -373,8 +437,8 @@ struct geam<Kokkos::complex<double>> : blas_base
 
     if (TransA == CBLAS_TRANSPOSE::CblasNoTrans && TransB == CBLAS_TRANSPOSE::CblasNoTrans && Order == CblasColMajor) {
 #pragma omp parallel for
-      for (auto j = 0ul; j < N; ++j) {
-        for (auto i = 0ul; i < M; ++i) {
+      for (blas_int j = 0; j < N; ++j) {
+        for (blas_int i = 0; i < M; ++i) {
           cC[i + ldc * j] = alpha_ * (cA[i + lda * j]) + beta_ * cB[i + ldb * j];
         }
       }
@@ -387,5 +451,43 @@ struct geam<Kokkos::complex<double>> : blas_base
 
 };
 
+
+template <>
+struct geam<double> : blas_base
+{
+  inline static void call(const CBLAS_ORDER Order,
+                          const CBLAS_TRANSPOSE TransA,
+                          const CBLAS_TRANSPOSE TransB,
+                          const blas_int M,
+                          const blas_int N,
+                          double alpha,
+                          const double *A,
+                          const blas_int lda,
+                          double beta,
+                          const double *B,
+                          const blas_int ldb,
+                          double *C,
+                          const blas_int ldc)
+  {
+#ifdef __USE_MKL
+    char c_ordering = Order == CBLAS_ORDER::CblasRowMajor ? 'R' : 'C';
+    char transa = TransA == CBLAS_TRANSPOSE::CblasNoTrans ? 'N' : 'T';
+    char transb = TransB == CBLAS_TRANSPOSE::CblasNoTrans ? 'N' : 'T';
+    mkl_domatadd(c_ordering, transa, transb, M, N, alpha, A, lda, beta, B, ldb, C, ldc);
+#else
+    if (TransA == CBLAS_TRANSPOSE::CblasNoTrans && TransB == CBLAS_TRANSPOSE::CblasNoTrans && Order == CblasColMajor) {
+#pragma omp parallel for
+      for (blas_int j = 0; j < N; ++j) {
+        for (blas_int i = 0; i < M; ++i) {
+          C[i + ldc * j] = alpha * A[i + lda * j] + beta * B[i + ldb * j];
+        }
+      }
+    } else {
+      throw std::runtime_error("cblas::geam: transpose args not implemented");
+    }
+#endif
+  }
+};
+
 }  // namespace cblas
 }  // namespace nlcglib
@@ -145,6 +145,53 @@ potrf<Kokkos::complex<double>>::call(cublasFillMode_t uplo,
 
 
 
+template<>
+struct potrf<double> : cusolver_base
+{
+  inline static cusolverStatus_t call(cublasFillMode_t uplo,
+                                      int n,
+                                      double* A,
+                                      int lda,
+                                      int& Info);
+};
+
+cusolverStatus_t
+potrf<double>::call(cublasFillMode_t uplo,
+                    int n,
+                    double* A,
+                    int lda,
+                    int& Info)
+{
+  using numeric_t = double;
+  int lwork = 0;
+  cusolverDnHandle_t cusolver_handle = cusolver::cusolverDnHandle::get();
+  cusolverStatus_t ret_buffer_size =
+    cusolverDnDpotrf_bufferSize(cusolver_handle, uplo, n, A, lda, &lwork);
+  if (ret_buffer_size != CUSOLVER_STATUS_SUCCESS) {
+    std::cerr << "Something went wrong\n"
+              << "return value: " << ret_buffer_size << "\n";
+    exit(1);
+  }
+
+  double* work_ptr;
+  CALL_CUDA(cudaMalloc, (&work_ptr, lwork * sizeof(numeric_t)));
+  int* dev_Info;
+  CALL_CUDA(cudaMalloc, ((void**)&dev_Info, sizeof(int)));
+  cusolverStatus_t ret_cusolver =
+      cusolverDnDpotrf(cusolver_handle, uplo, n, A, lda, work_ptr, lwork, dev_Info);
+  CALL_CUDA(cudaDeviceSynchronize, ());
+  CALL_CUDA(cudaMemcpy, (&Info, dev_Info, sizeof(int), cudaMemcpyDeviceToHost));
+  CALL_CUDA(cudaFree, (work_ptr));
+  if (ret_cusolver != CUSOLVER_STATUS_SUCCESS) {
+    std::cerr << "Something went wrong\n"
+              << "return value: " << ret_cusolver << "\n"
+              << "info: " << Info << "\n";
+    exit(1);
+  }
+  return ret_cusolver;
+}
+
+
 template <typename T>
 struct potrs {};
 
@@ -230,6 +277,45 @@ cusolverStatus_t potrs<Kokkos::complex<double>>::call(cublasFillMode_t uplo,
   return stat;
 }
 
+template<>
+struct potrs<double> : cusolver_base
+{
+  inline static cusolverStatus_t call(cublasFillMode_t uplo,
+                                      int n,
+                                      int nrhs,
+                                      const double* A,
+                                      int lda,
+                                      double* B,
+                                      int ldb);
+};
+
+cusolverStatus_t potrs<double>::call(cublasFillMode_t uplo,
+                                     int n,
+                                     int nrhs,
+                                     const double *A,
+                                     int lda,
+                                     double *B,
+                                     int ldb)
+{
+  cusolverDnHandle_t cusolver_handle = cusolver::cusolverDnHandle::get();
+
+  int* dev_Info;
+  int Info;
+  CALL_CUDA(cudaMalloc, ((void**)&dev_Info, sizeof(int)));
+  cusolverStatus_t stat = cusolverDnDpotrs(cusolver_handle, uplo, n, nrhs, A, lda, B, ldb, dev_Info);
+  CALL_CUDA(cudaDeviceSynchronize, ());
+  CALL_CUDA(cudaMemcpy, (&Info, dev_Info, sizeof(int), cudaMemcpyDeviceToHost));
+
+  if (stat != CUSOLVER_STATUS_SUCCESS) {
+    std::cerr << "Something went wrong\n"
+              << "return value: " << stat << "\n"
+              << "info: " << Info << "\n";
+    exit(1);
+  }
+
+  return stat;
+}
+
 template <typename T>
 struct zheevd : cusolver_base
 { };
@@ -338,6 +424,58 @@ zheevd<Kokkos::complex<double>>::call(cusolverEigMode_t jobz,
   return ret_cusolver;
 }
 
+/// real symmetric (Gamma-point)
+template<>
+struct zheevd<double> : cusolver_base
+{
+  inline static cusolverStatus_t call(cusolverEigMode_t jobz,
+                                      cublasFillMode_t uplo,
+                                      int n,
+                                      double* A,
+                                      int lda,
+                                      double* w,
+                                      int& Info);
+};
+
+cusolverStatus_t
+zheevd<double>::call(cusolverEigMode_t jobz,
+                     cublasFillMode_t uplo,
+                     int n,
+                     double* A,
+                     int lda,
+                     double* w,
+                     int& Info)
+{
+  using numeric_t = double;
+  int lwork = 0;
+  cusolverDnHandle_t cusolver_handle = cusolver::cusolverDnHandle::get();
+  cusolverStatus_t ret_buffer_size =
+    cusolverDnDsyevd_bufferSize(cusolver_handle, jobz, uplo, n, A, lda, w, &lwork);
+  if (ret_buffer_size != CUSOLVER_STATUS_SUCCESS) {
+    std::cerr << "Something went wrong\n"
+              << "return value: " << ret_buffer_size << "\n";
+    exit(1);
+  }
+
+  double* work_ptr;
+  CALL_CUDA(cudaMalloc, (&work_ptr, lwork * sizeof(numeric_t)));
+  int* dev_Info;
+  CALL_CUDA(cudaMalloc, ((void**)&dev_Info, sizeof(int)));
+  cusolverStatus_t ret_cusolver =
+      cusolverDnDsyevd(cusolver_handle, jobz, uplo, n, A, lda, w, work_ptr, lwork, dev_Info);
+  CALL_CUDA(cudaDeviceSynchronize, ());
+  CALL_CUDA(cudaMemcpy, (&Info, dev_Info, sizeof(int), cudaMemcpyDeviceToHost));
+  CALL_CUDA(cudaFree, (work_ptr));
+  if (ret_cusolver != CUSOLVER_STATUS_SUCCESS) {
+    std::cerr << "Error in DnDsyevd\n"
+              << "return value: " << ret_cusolver << "\n"
+              << "info: " << Info << "\n";
+
+    exit(1);
+  }
+  return ret_cusolver;
+}
+
 template <class T>
 struct gemm
 { };
@@ -470,6 +608,30 @@ struct geam<Kokkos::complex<double>>
   }
 };
 
+template <>
+struct geam<double>
+{
+  static const cublasOperation_t H = cublasOperation_t::CUBLAS_OP_T;
+  static const cublasOperation_t N = cublasOperation_t::CUBLAS_OP_N;
+
+  inline static void call(cublasOperation_t transa,
+                          cublasOperation_t transb,
+                          int m,
+                          int n,
+                          double alpha,
+                          const double* A,
+                          int lda,
+                          double beta,
+                          const double* B,
+                          int ldb,
+                          double* C,
+                          int ldc)
+  {
+    cublasDgeam(
+        cublas::cublasHandle::get(), transa, transb, m, n, &alpha, A, lda, &beta, B, ldb, C, ldc);
+  }
+};
+
 
 
 
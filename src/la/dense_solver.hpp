@@ -0,0 +1,166 @@
+#pragma once
+
+#include <Kokkos_Core.hpp>
+#include <complex>
+#include <type_traits>
+#include "la/dvector.hpp"
+#include "la/lapack_cpu.hpp"
+#ifdef __NLCGLIB__CUDA
+#include "la/lapack_cuda.hpp"
+#endif
+#include "la/scalapack.hpp"
+#include "mpi/communicator.hpp"
+#include "utils/env.hpp"
+#include "utils/profiler.hpp"
+
+namespace nlcglib {
+
+/// Back-ends for the small (nbands x nbands) dense problems
+enum class dense_backend
+{
+  /// replicated matrices, solved redundantly with LAPACK (or cuSolver) on every rank
+  lapack,
+  /// redistributed to a 2D block-cyclic layout over the k-point communicator
+  scalapack
+};
+
+/**
+ * Choose the back-end for a dense problem of size n.
+ *
+ * ScaLAPACK is used only if it was found at configure time, the k-point
+ * communicator has more than one rank and n >= NLCGLIB_SCALAPACK_MIN_N.
+ */
+inline dense_backend
+select_dense_backend(int n, const Communicator& comm)
+{
+#ifdef __NLCGLIB__SCALAPACK
+  if (comm.size() > 1 && n >= env::get_scalapack_min_n()) return dense_backend::scalapack;
+#endif
+  return dense_backend::lapack;
+}
+
+namespace dense_solver_impl {
+
+template <class T, class LAYOUT, class... KOKKOS>
+void
+eigh(KokkosDVector<T, LAYOUT, KOKKOS...>& U,
+     Kokkos::View<double*, typename KokkosDVector<T, LAYOUT, KOKKOS...>::storage_t::memory_space>& w,
+     const KokkosDVector<T, LAYOUT, KOKKOS...>& S,
+     const Communicator&,
+     std::false_type /* host */)
+{
+  nlcglib::eigh(U, w, S);
+}
+
+template <class T, class LAYOUT, class... KOKKOS>
+void
+eigh(KokkosDVector<T, LAYOUT, KOKKOS...>& U,
+     Kokkos::View<double*, Kokkos::HostSpace>& w,
+     const KokkosDVector<T, LAYOUT, KOKKOS...>& S,
+     const Communicator& comm,
+     std::true_type /* host */)
+{
+#ifdef __NLCGLIB__SCALAPACK
+  int n = S.array().extent(1);
+  // the ScaLAPACK wrappers are complex<double> only, real (Gamma-point) problems use LAPACK
+  using numeric_t = typename KokkosDVector<T, LAYOUT, KOKKOS...>::numeric_t;
+  if (std::is_same<numeric_t, Kokkos::complex<double>>::value &&
+      S.array().extent(0) == S.array().extent(1) &&
+      select_dense_backend(n, comm) == dense_backend::scalapack) {
+    static_assert(std::is_same<decltype(S.array().layout()), Kokkos::LayoutLeft>::value,
+                  "must be col-major layout");
+    scalapack::zheevd(reinterpret_cast<std::complex<double>*>(U.array().data()),
+                      U.array().stride(1),
+                      w.data(),
+                      reinterpret_cast<const std::complex<double>*>(S.array().data()),
+                      S.array().stride(1),
+                      n,
+                      env::get_scalapack_block_size(),
+                      comm);
+    return;
+  }
+#endif
+  nlcglib::eigh(U, w, S);
+}
+
+template <class T, class LAYOUT, class... KOKKOS>
+void
+solve_sym(KokkosDVector<T, LAYOUT, KOKKOS...>& A,
+          KokkosDVector<T, LAYOUT, KOKKOS...>& RHS,
+          const Communicator&,
+          std::false_type /* host */)
+{
+  nlcglib::solve_sym(A, RHS);
+}
+
+template <class T, class LAYOUT, class... KOKKOS>
+void
+solve_sym(KokkosDVector<T, LAYOUT, KOKKOS...>& A,
+          KokkosDVector<T, LAYOUT, KOKKOS...>& RHS,
+          const Communicator& comm,
+          std::true_type /* host */)
+{
+#ifdef __NLCGLIB__SCALAPACK
+  int n = A.array().extent(0);
+  // the ScaLAPACK wrappers are complex<double> only, real (Gamma-point) problems use LAPACK
+  using numeric_t = typename KokkosDVector<T, LAYOUT, KOKKOS...>::numeric_t;
+  if (std::is_same<numeric_t, Kokkos::complex<double>>::value && A.array().extent(1) == n &&
+      RHS.array().extent(0) == n && select_dense_backend(n, comm) == dense_backend::scalapack) {
+    if (A.array().stride(0) != 1 || RHS.array().stride(0) != 1) {
+      throw std::runtime_error("expecting column major layout");
+    }
+    scalapack::zposv(reinterpret_cast<std::complex<double>*>(A.array().data()),
+                     A.array().stride(1),
+                     reinterpret_cast<std::complex<double>*>(RHS.array().data()),
+                     RHS.array().stride(1),
+                     n,
+                     RHS.array().extent(1),
+                     env::get_scalapack_block_size(),
+                     comm);
+    return;
+  }
+#endif
+  nlcglib::solve_sym(A, RHS);
+}
+
+template <class T, class LAYOUT, class... KOKKOS>
+using is_host_t =
+    std::is_same<typename KokkosDVector<T, LAYOUT, KOKKOS...>::storage_t::memory_space,
+                 Kokkos::HostSpace>;
+
+}  // namespace dense_solver_impl
+
+/**
+ * Hermitian eigenvalue problem for a matrix replicated on the ranks of `comm`.
+ *
+ * Dispatches to the replicated LAPACK solver or to ScaLAPACK, see select_dense_backend.
+ */
+template <class T, class LAYOUT, class... KOKKOS>
+void
+eigh(KokkosDVector<T, LAYOUT, KOKKOS...>& U,
+     Kokkos::View<double*, typename KokkosDVector<T, LAYOUT, KOKKOS...>::storage_t::memory_space>& w,
+     const KokkosDVector<T, LAYOUT, KOKKOS...>& S,
+     const Communicator& comm)
+{
+  NLCGLIB_PROFILE_REGION("eigh");
+  dense_solver_impl::eigh(
+      U, w, S, comm, typename dense_solver_impl::is_host_t<T, LAYOUT, KOKKOS...>::type{});
+}
+
+/**
+ * Hermitian positive definite solve A X = RHS for matrices replicated on the ranks of `comm`.
+ *
+ * RHS is overwritten by the solution, A is destroyed.
+ */
+template <class T, class LAYOUT, class... KOKKOS>
+void
+solve_sym(KokkosDVector<T, LAYOUT, KOKKOS...>& A,
+          KokkosDVector<T, LAYOUT, KOKKOS...>& RHS,
+          const Communicator& comm)
+{
+  NLCGLIB_PROFILE_REGION("solve_sym");
+  dense_solver_impl::solve_sym(
+      A, RHS, comm, typename dense_solver_impl::is_host_t<T, LAYOUT, KOKKOS...>::type{});
+}
+
+}  // namespace nlcglib
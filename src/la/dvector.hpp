@@ -80,8 +80,41 @@ get_mem_type(X&& x)
 }
 
 
+/// numeric type of the buffer_protocol exchanged with the host code
+template <class T>
+struct buffer_numeric
+{
+  using type = T;
+};
+
+template <>
+struct buffer_numeric<Kokkos::complex<double>>
+{
+  using type = std::complex<double>;
+};
+
+template <class T>
+using buffer_numeric_t = typename buffer_numeric<std::remove_cv_t<T>>::type;
+
+/// inverse of buffer_numeric
+template <class T>
+struct kokkos_numeric
+{
+  using type = T;
+};
+
+template <>
+struct kokkos_numeric<std::complex<double>>
+{
+  using type = Kokkos::complex<double>;
+};
+
+template <class T>
+using kokkos_numeric_t = typename kokkos_numeric<std::remove_cv_t<T>>::type;
+
+
 template <class T, class... ARGS>
-buffer_protocol<std::complex<double>, 2>
+buffer_protocol<buffer_numeric_t<typename KokkosDVector<T**, ARGS...>::numeric_t>, 2>
 as_buffer_protocol(const KokkosDVector<T**, ARGS...>& kokkosdvec)
 {
   using type = KokkosDVector<T**, ARGS...>;
@@ -90,25 +123,32 @@ as_buffer_protocol(const KokkosDVector<T**, ARGS...>& kokkosdvec)
 
 
 template <class T, class... ARGS>
-buffer_protocol<std::complex<double>, 2> as_buffer_protocol(KokkosDVector<T**, ARGS...>& kokkosdvec)
+buffer_protocol<buffer_numeric_t<typename KokkosDVector<T**, ARGS...>::numeric_t>, 2>
+as_buffer_protocol(KokkosDVector<T**, ARGS...>& kokkosdvec)
 {
-  using vector_t = KokkosDVector<T, ARGS...>;
+  using vector_t = KokkosDVector<T**, ARGS...>;
   using numeric_t = typename vector_t::storage_t::value_type;
-  static_assert(std::is_same<numeric_t, Kokkos::complex<double>>::value, "todo: remove this limitation");
+  using buffer_numeric_type = buffer_numeric_t<numeric_t>;
+  static_assert(std::is_same<numeric_t, Kokkos::complex<double>>::value ||
+                    std::is_same<numeric_t, double>::value,
+                "buffer_protocol is only defined for complex<double> and double");
 
   auto mem_t = get_mem_type(kokkosdvec);
-  std::array<int, 2> strides;
+  std::array<std::ptrdiff_t, 2> strides;
   strides[0] = kokkosdvec.array().stride(0);
   strides[1] = kokkosdvec.array().stride(1);
 
-  std::array<int, 2> sizes;
+  std::array<std::ptrdiff_t, 2> sizes;
   sizes[0] = kokkosdvec.array().extent(0);
   sizes[1] = kokkosdvec.array().extent(1);
 
   // TODO: is MPI_COMM_SELF always correct here?
-  return buffer_protocol<std::complex<double>, 2>(strides, sizes,
-                                                  reinterpret_cast<std::complex<double>*>(kokkosdvec.array().data()),
-                                                  mem_t, MPI_COMM_SELF);
+  return buffer_protocol<buffer_numeric_type, 2>(
+      strides,
+      sizes,
+      reinterpret_cast<buffer_numeric_type*>(kokkosdvec.array().data()),
+      mem_t,
+      MPI_COMM_SELF);
 }
 
 /// Distributed vector based on Kokkos
@@ -162,7 +202,7 @@ public:
   KokkosDVector(const Map<layout_t>& map, const buffer_protocol<NUMERIC_T, 2>& buffer);
 
   /// local number of elements
-  int lsize() const { return kokkos_.size(); }
+  std::ptrdiff_t lsize() const { return kokkos_.size(); }
 
   const storage_t& array() const { return kokkos_; }
   storage_t& array() { return kokkos_; }
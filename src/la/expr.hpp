@@ -0,0 +1,149 @@
+#pragma once
+
+#include <Kokkos_Core.hpp>
+#include <type_traits>
+#include "exec_space.hpp"
+#include "la/dvector.hpp"
+
+namespace nlcglib {
+
+/**
+ * Elementwise expressions over KokkosDVector.
+ *
+ * Nodes hold Kokkos views and scalars by value and are evaluated per element inside a single
+ * kernel by `assign`, e.g.
+ *
+ *   assign(g_x, wk * expr::col_scale(expr::ref(hx), fn) - wk * expr::ref(xll));
+ *
+ * computes wk * HX diag(fn) - wk * XLL with one pass over memory.
+ */
+namespace expr {
+
+struct expr_tag
+{
+};
+
+template <class E>
+using is_expr = std::is_base_of<expr_tag, std::decay_t<E>>;
+
+/// leaf: A(i, j)
+template <class view_t>
+struct matrix_ref : expr_tag
+{
+  matrix_ref(const view_t& v)
+      : v(v)
+  {
+  }
+
+  KOKKOS_INLINE_FUNCTION auto operator()(int i, int j) const { return v(i, j); }
+
+  view_t v;
+};
+
+/// E(i, j) * x(j)
+template <class E, class vector_t>
+struct col_scale_expr : expr_tag
+{
+  col_scale_expr(const E& e, const vector_t& x)
+      : e(e)
+      , x(x)
+  {
+  }
+
+  KOKKOS_INLINE_FUNCTION auto operator()(int i, int j) const { return e(i, j) * x(j); }
+
+  E e;
+  vector_t x;
+};
+
+/// alpha * E(i, j)
+template <class S, class E>
+struct scaled_expr : expr_tag
+{
+  scaled_expr(S alpha, const E& e)
+      : alpha(alpha)
+      , e(e)
+  {
+  }
+
+  KOKKOS_INLINE_FUNCTION auto operator()(int i, int j) const { return alpha * e(i, j); }
+
+  S alpha;
+  E e;
+};
+
+template <class E1, class E2>
+struct sum_expr : expr_tag
+{
+  sum_expr(const E1& e1, const E2& e2)
+      : e1(e1)
+      , e2(e2)
+  {
+  }
+
+  KOKKOS_INLINE_FUNCTION auto operator()(int i, int j) const { return e1(i, j) + e2(i, j); }
+
+  E1 e1;
+  E2 e2;
+};
+
+template <class T, class LAYOUT, class... KOKKOS>
+auto
+ref(const KokkosDVector<T, LAYOUT, KOKKOS...>& X)
+{
+  using view_t = std::decay_t<decltype(X.array())>;
+  return matrix_ref<view_t>(X.array());
+}
+
+template <class E, class T, class... ARGS>
+std::enable_if_t<is_expr<E>::value, col_scale_expr<E, Kokkos::View<T*, ARGS...>>>
+col_scale(const E& e, const Kokkos::View<T*, ARGS...>& x)
+{
+  return col_scale_expr<E, Kokkos::View<T*, ARGS...>>(e, x);
+}
+
+template <class S, class E>
+std::enable_if_t<is_expr<E>::value && std::is_arithmetic<S>::value, scaled_expr<S, E>>
+operator*(S alpha, const E& e)
+{
+  return scaled_expr<S, E>(alpha, e);
+}
+
+template <class E>
+std::enable_if_t<is_expr<E>::value, scaled_expr<double, E>>
+operator-(const E& e)
+{
+  return scaled_expr<double, E>(-1.0, e);
+}
+
+template <class E1, class E2>
+std::enable_if_t<is_expr<E1>::value && is_expr<E2>::value, sum_expr<E1, E2>>
+operator+(const E1& e1, const E2& e2)
+{
+  return sum_expr<E1, E2>(e1, e2);
+}
+
+template <class E1, class E2>
+std::enable_if_t<is_expr<E1>::value && is_expr<E2>::value, sum_expr<E1, scaled_expr<double, E2>>>
+operator-(const E1& e1, const E2& e2)
+{
+  return sum_expr<E1, scaled_expr<double, E2>>(e1, scaled_expr<double, E2>(-1.0, e2));
+}
+
+}  // namespace expr
+
+/// dst(i, j) <- e(i, j), a single kernel over dst
+template <class T, class LAYOUT, class... KOKKOS, class E>
+std::enable_if_t<expr::is_expr<E>::value>
+assign(KokkosDVector<T**, LAYOUT, KOKKOS...>& dst, const E& e)
+{
+  using memspace = typename KokkosDVector<T**, LAYOUT, KOKKOS...>::storage_t::memory_space;
+  typedef Kokkos::MDRangePolicy<Kokkos::Rank<2>, exec_t<memspace>> mdrange_policy;
+  auto mDST = dst.array();
+  int m = mDST.extent(0);
+  int n = mDST.extent(1);
+  Kokkos::parallel_for(
+      "assign", mdrange_policy({{0, 0}}, {{m, n}}), KOKKOS_LAMBDA(int i, int j) { mDST(i, j) = e(i, j); });
+}
+
+}  // namespace nlcglib
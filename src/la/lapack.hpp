@@ -7,10 +7,12 @@
 #ifdef __NLCGLIB__CUDA
 #include "lapack_cuda.hpp"
 #endif
+#include "dense_solver.hpp"
 #include "mvector.hpp"
 #include "traits.hpp"
 #include "utils.hpp"
 #include "exec_space.hpp"
+#include "utils/profiler.hpp"
 
 namespace nlcglib {
 
@@ -251,8 +253,8 @@ scale_alloc(const M1& src,
             double alpha = 1)
 {
   auto mSRC = src.array();
-  int n = src.map().nrows();
-  int m = src.map().ncols();
+  auto n = src.map().nrows();
+  auto m = src.map().ncols();
   assert(x.extent(0) == m);
   using vector_t = M1;
   // using memspace = typename vector_t::storage_t::memory_space;
@@ -305,15 +307,37 @@ struct inner_ {
              const identity_t<T>& alpha = T{1.0},
              const identity_t<T>& beta = T{0.})
   {
-    int n = A.map().ncols();
-    int m = B.map().ncols();
-    Map<SlabLayoutV> map(A.map().comm(), SlabLayoutV({{0, 0, n, m}}));
+    auto n = A.map().ncols();
+    auto m = B.map().ncols();
+    // the result is replicated on all ranks of A's communicator
+    Map<SlabLayoutV> map(Communicator(), SlabLayoutV({{0, 0, n, m}}));
     to_layout_left_t<M1> C(map);
     inner(C, A, B, alpha, beta);
     return C;
   }
 };
 
+namespace local {
+/// complex conjugate of a matrix entry, identity for real entries (Gamma-point)
+template <class T>
+KOKKOS_INLINE_FUNCTION T
+entry_conj(const T& x)
+{
+  return x;
+}
+
+template <class T>
+KOKKOS_INLINE_FUNCTION Kokkos::complex<T>
+entry_conj(const Kokkos::complex<T>& x)
+{
+  return Kokkos::conj(x);
+}
+}  // namespace local
+
+/// result type of innerh_tr, real matrices give a complex number as well s.t. callers can use .real()
+template <class T>
+using innerh_t = std::conditional_t<std::is_floating_point<T>::value, Kokkos::complex<T>, T>;
+
 /// Hermitian inner product, summed
 struct innerh_tr
 {
@@ -321,7 +345,7 @@ struct innerh_tr
   template <class M1, class M2>
   std::enable_if_t<
     Kokkos::SpaceAccessibility<Kokkos::Cuda, typename M1::storage_t::memory_space>::accessible,
-    typename M1::numeric_t>
+    innerh_t<typename M1::numeric_t>>
   operator()(const M1& X, const M2& Y)
   {
     int nrows = X.array().extent(0);
@@ -343,7 +367,7 @@ struct innerh_tr
     Kokkos::parallel_for(
         "", Kokkos::RangePolicy<Kokkos::Cuda>(0, nrows), KOKKOS_LAMBDA(int i) {
           for (int j = 0; j < ncols; ++j) {
-            tmp(i) += x(i, j) * Kokkos::conj(y(i, j));
+            tmp(i) += x(i, j) * local::entry_conj(y(i, j));
           }
         });
     // sum vector
@@ -352,14 +376,16 @@ struct innerh_tr
         Kokkos::RangePolicy<Kokkos::Cuda>(0, nrows),
         KOKKOS_LAMBDA(int i, T& lsum) { lsum += tmp(i); },
         sum);
-      return sum;
+    // row-distributed X, Y
+    if (!X.map().is_local()) sum = X.map().comm().allreduce(sum, mpi_op::sum);
+    return innerh_t<T>(sum);
   }
 #endif
 
   template <class M1, class M2>
   std::enable_if_t<
       Kokkos::SpaceAccessibility<Kokkos::Serial, typename M1::storage_t::memory_space>::accessible,
-      typename M1::numeric_t>
+      innerh_t<typename M1::numeric_t>>
   operator()(const M1& X, const M2& Y)
   {
     int nrows = X.array().extent(0);
@@ -380,7 +406,7 @@ struct innerh_tr
     Kokkos::parallel_for(
         "", Kokkos::RangePolicy<exec_t<memory_space>>(0, nrows), KOKKOS_LAMBDA(int i) {
           for (int j = 0; j < ncols; ++j) {
-            tmp(i) += x(i, j) * Kokkos::conj(y(i, j));
+            tmp(i) += x(i, j) * local::entry_conj(y(i, j));
           }
         });
     Kokkos::parallel_reduce(
@@ -388,8 +414,10 @@ struct innerh_tr
         Kokkos::RangePolicy<Kokkos::Serial>(0, nrows),
         KOKKOS_LAMBDA(int i, T& lsum) { lsum += tmp(i); },
         sum);
+    // row-distributed X, Y
+    if (!X.map().is_local()) sum = X.map().comm().allreduce(sum, mpi_op::sum);
 
-    return sum;
+    return innerh_t<T>(sum);
   }
 };
 
@@ -443,11 +471,12 @@ loewdin(const KokkosDVector<T**, LAYOUT, KOKKOS...>& X)
 {
   using matrix_t = KokkosDVector<T**, KOKKOS...>;
   using memspace = typename matrix_t::storage_t::memory_space;
+  NLCGLIB_PROFILE_REGION("loewdin");
 
   auto M = inner_()(X, X);
   Kokkos::View<double*, memspace> w("eigvals, loewdin", X.array().extent(1));
   auto U = empty_like()(M);
-  eigh(U, w, M);
+  eigh(U, w, M, X.map().comm());
 
   loewdin_aux(w);
 
@@ -457,7 +486,7 @@ loewdin(const KokkosDVector<T**, LAYOUT, KOKKOS...>& X)
   outer(R, M, U);
 
   auto Y = zeros_like()(X);
-  transform(Y, Kokkos::complex<double>{0.0}, Kokkos::complex<double>{1.0}, X, R);
+  transform(Y, T{0.0}, T{1.0}, X, R);
 
   return Y;
 }
@@ -470,11 +499,12 @@ loewdin(const KokkosDVector<T**, LAYOUT, KOKKOS...>& X,
 {
   using matrix_t = KokkosDVector<T**, KOKKOS...>;
   using memspace = typename matrix_t::storage_t::memory_space;
+  NLCGLIB_PROFILE_REGION("loewdin");
 
   auto M = inner_()(X, SX);
   Kokkos::View<double*, memspace> w("eigvals, loewdin", X.array().extent(1));
   auto U = empty_like()(M);
-  eigh(U, w, M);
+  eigh(U, w, M, X.map().comm());
 
   loewdin_aux(w);
 
@@ -484,7 +514,7 @@ loewdin(const KokkosDVector<T**, LAYOUT, KOKKOS...>& X,
   outer(R, M, U);
 
   auto Y = zeros_like()(X);
-  transform(Y, Kokkos::complex<double>{0.0}, Kokkos::complex<double>{1.0}, X, R);
+  transform(Y, T{0.0}, T{1.0}, X, R);
 
   return Y;
 }
@@ -30,24 +30,28 @@ eigh(KokkosDVector<T, LAYOUT, KOKKOS...>& U,
 {
   static_assert(std::is_same<decltype(S.array().layout()), Kokkos::LayoutLeft>::value,
                 "must be col-major layout");
-  int lda = U.array().stride(1);
+  auto lda = cblas::to_blas_int(U.array().stride(1));
 
-  // check number of MPI ranks in communicator
-  if (S.map().is_local()) {
-    int n = U.map().ncols();
+  // small matrices are replicated on all ranks of the k-point communicator, if the map is not
+  // local the eigenvalue problem is solved redundantly on every rank
+  if (S.array().extent(0) == S.array().extent(1)) {
+    auto n = cblas::to_blas_int(U.map().ncols());
     Kokkos::deep_copy(U.array(), S.array());
-    lapack_int info = LAPACKE_zheevd(LAPACK_COL_MAJOR,                                     /* matrix layout */
-                                     'V',                                                  /* jobz */
-                                     'U',                                                  /* uplot */
-                                     n,                                                    /* matrix size */
-                                     reinterpret_cast<lapack_complex_double*>(U.array().data()), /* Complex double */
-                                     lda,                                                    /* lda */
-                                     w.data()                                              /* eigenvalues */
+    using numeric_t = typename KokkosDVector<T, LAYOUT, KOKKOS...>::numeric_t;
+    // zheevd, or dsyevd for real symmetric matrices (Gamma-point)
+    using zheevd_t = cblas::zheevd<numeric_t>;
+    lapack_int info = zheevd_t::call(CblasColMajor,    /* matrix layout */
+                                     zheevd_t::VECTOR, /* jobz */
+                                     'U',              /* uplo */
+                                     n,                /* matrix size */
+                                     U.array().data(), /* matrix */
+                                     lda,              /* lda */
+                                     w.data()          /* eigenvalues */
     );
     if (info != 0)
       throw std::runtime_error("cblas zheevd failed");
   } else {
-    throw std::runtime_error("not yet implemented");
+    throw std::runtime_error("eigh: expected a replicated square matrix");
   }
 }
 
@@ -58,7 +62,9 @@ std::enable_if_t<std::is_same<typename KokkosDVector<T, LAYOUT, KOKKOS...>::stor
 solve_sym(KokkosDVector<T, LAYOUT, KOKKOS...>& A,
           KokkosDVector<T, LAYOUT, KOKKOS...>& RHS)
 {
-  if (A.map().is_local() && RHS.map().is_local()) {
+  // A, RHS are replicated on all ranks of the k-point communicator (solved redundantly)
+  if (A.array().extent(0) == A.array().extent(1) &&
+      RHS.array().extent(0) == A.array().extent(0)) {
     typedef KokkosDVector<T**, LAYOUT, KOKKOS...> vector_t;
     typedef typename vector_t::storage_t::value_type numeric_t;
 
@@ -67,21 +73,21 @@ solve_sym(KokkosDVector<T, LAYOUT, KOKKOS...>& A,
       throw std::runtime_error("expecting column major layout");
     }
 
-    int n = A.map().nrows();
-    int lda = A.array().stride(1);
-    int ldb = RHS.array().stride(1);
+    auto n = cblas::to_blas_int(A.map().nrows());
+    auto lda = cblas::to_blas_int(A.array().stride(1));
+    auto ldb = cblas::to_blas_int(RHS.array().stride(1));
     auto ptr_B = RHS.array().data();
     auto ptr_A = A.array().data();
 
     char uplo = 'U';
     auto order = CBLAS_ORDER::CblasColMajor;
     potrf_t::call(order, uplo, n, ptr_A, lda);
-    int nrhs = RHS.array().extent(1);
+    auto nrhs = cblas::to_blas_int(RHS.array().extent(1));
 
     typedef cblas::potrs<numeric_t> potrs_t;
     potrs_t::call(order, uplo, n, nrhs, ptr_A, lda, ptr_B, ldb);
   } else {
-    throw std::runtime_error("not implemented");
+    throw std::runtime_error("solve_sym: expected replicated matrices");
   }
 }
 
@@ -119,22 +125,22 @@ inner(KokkosDVector<T0**, LAYOUT0, KOKKOS0...>& C,
                 "a,b not on same memory");
   static_assert(std::is_same<LAYOUT1, LAYOUT2>::value, "matrix layout do not match");
 
-  // single rank
-  if (A.map().is_local() && B.map().is_local() && C.map().is_local()) {
-    int m = A.map().ncols();
-    int k = A.map().nrows();
-    int n = B.map().ncols();
-    numeric_t* A_ptr = A.array().data();
-    numeric_t* B_ptr = B.array().data();
-    numeric_t* C_ptr = C.array().data();
+  auto m = cblas::to_blas_int(A.map().ncols());
+  auto k = cblas::to_blas_int(A.map().nrows());
+  auto n = cblas::to_blas_int(B.map().ncols());
+  numeric_t* A_ptr = A.array().data();
+  numeric_t* B_ptr = B.array().data();
+  numeric_t* C_ptr = C.array().data();
 
-    if (A.array().stride(0) != 1 || B.array().stride(0) != 1 || C.array().stride(0) != 1) {
-      throw std::runtime_error("expecting column major layout");
-    }
-    int lda = A.array().stride(1);
-    int ldb = B.array().stride(1);
-    int ldc = C.array().stride(1);
+  if (A.array().stride(0) != 1 || B.array().stride(0) != 1 || C.array().stride(0) != 1) {
+    throw std::runtime_error("expecting column major layout");
+  }
+  auto lda = cblas::to_blas_int(A.array().stride(1));
+  auto ldb = cblas::to_blas_int(B.array().stride(1));
+  auto ldc = cblas::to_blas_int(C.array().stride(1));
 
+  // single rank
+  if (A.map().is_local() && B.map().is_local()) {
     // single rank inner product
     cblas::gemm<numeric_t>::call(CblasColMajor,
                                  cblas::gemm<numeric_t>::H,
@@ -151,7 +157,60 @@ inner(KokkosDVector<T0**, LAYOUT0, KOKKOS0...>& C,
                                  C_ptr,
                                  ldc);
   } else {
-    throw std::runtime_error("not implemented.");
+    // A, B are row-distributed over the k-point communicator: local gemm + allreduce,
+    // the result is replicated on all ranks
+    const auto& comm = A.map().comm();
+    if (!comm.congruent(B.map().comm())) {
+      throw std::runtime_error("inner: A, B must be distributed over the same communicator");
+    }
+    // rank 0 adds beta * C, the other ranks contribute their partial product only
+    numeric_t beta_loc = comm.rank() == 0 ? beta : numeric_t{0.0};
+    if (ldc == m) {
+      // contiguous C: reduced in-place
+      cblas::gemm<numeric_t>::call(CblasColMajor,
+                                   cblas::gemm<numeric_t>::H,
+                                   CblasNoTrans,
+                                   m,
+                                   n,
+                                   k,
+                                   alpha,
+                                   A_ptr,
+                                   lda,
+                                   B_ptr,
+                                   ldb,
+                                   beta_loc,
+                                   C_ptr,
+                                   ldc);
+      comm.allreduce(C_ptr, static_cast<std::ptrdiff_t>(m) * n, mpi_op::sum);
+      return;
+    }
+    Kokkos::View<numeric_t**, Kokkos::LayoutLeft, Kokkos::HostSpace> tmp(
+        Kokkos::view_alloc(Kokkos::WithoutInitializing, "inner tmp"), m, n);
+    for (cblas::blas_int j = 0; j < n; ++j) {
+      for (cblas::blas_int i = 0; i < m; ++i) {
+        tmp(i, j) = beta_loc == numeric_t{0.0} ? numeric_t{0.0} : C_ptr[i + ldc * j];
+      }
+    }
+    cblas::gemm<numeric_t>::call(CblasColMajor,
+                                 cblas::gemm<numeric_t>::H,
+                                 CblasNoTrans,
+                                 m,
+                                 n,
+                                 k,
+                                 alpha,
+                                 A_ptr,
+                                 lda,
+                                 B_ptr,
+                                 ldb,
+                                 beta_loc,
+                                 tmp.data(),
+                                 m);
+    comm.allreduce(tmp.data(), static_cast<std::ptrdiff_t>(m) * n, mpi_op::sum);
+    for (cblas::blas_int j = 0; j < n; ++j) {
+      for (cblas::blas_int i = 0; i < m; ++i) {
+        C_ptr[i + ldc * j] = tmp(i, j);
+      }
+    }
   }
 }
 
@@ -187,11 +246,11 @@ std::enable_if_t<
                 "a,b not on same memory");
   static_assert(std::is_same<LAYOUT1, LAYOUT2>::value, "matrix layout do not match");
 
-  // single rank
-  if (A.map().is_local() && B.map().is_local() && C.map().is_local()) {
-    int m = A.map().ncols();
-    int k = A.map().nrows();
-    int n = B.map().ncols();
+  // A @ B^H of two row-distributed matrices would be distributed in both dimensions
+  if (B.map().is_local()) {
+    auto m = cblas::to_blas_int(A.map().ncols());
+    auto k = cblas::to_blas_int(A.map().nrows());
+    auto n = cblas::to_blas_int(B.map().ncols());
     numeric_t* A_ptr = A.array().data();
     numeric_t* B_ptr = B.array().data();
     numeric_t* C_ptr = C.array().data();
@@ -199,9 +258,9 @@ std::enable_if_t<
     if (A.array().stride(0) != 1 || B.array().stride(0) != 1 || C.array().stride(0) != 1) {
       throw std::runtime_error("expecting column major layout");
     }
-    int lda = A.array().stride(1);
-    int ldb = B.array().stride(1);
-    int ldc = C.array().stride(1);
+    auto lda = cblas::to_blas_int(A.array().stride(1));
+    auto ldb = cblas::to_blas_int(B.array().stride(1));
+    auto ldc = cblas::to_blas_int(C.array().stride(1));
 
     // single rank inner product
     cblas::gemm<numeric_t>::call(CblasColMajor,
@@ -219,7 +278,7 @@ std::enable_if_t<
                                  C_ptr,
                                  ldc);
   } else {
-    throw std::runtime_error("not implemented.");
+    throw std::runtime_error("outer: B must not be distributed.");
   }
 }
 
@@ -249,11 +308,11 @@ transform(KokkosDVector<T0**, LAYOUT0, KOKKOS0...>& C,
                 "a,b not on same memory");
   static_assert(std::is_same<LAYOUT1, LAYOUT2>::value, "matrix layout do not match");
 
-  if (A.map().is_local() && B.map().is_local() && C.map().is_local()) {
-    /* single rank */
-    int m = A.map().nrows();
-    int n = B.map().ncols();
-    int k = A.map().ncols();
+  // A, C may be row-distributed, B is replicated -> local operation
+  if (B.map().is_local()) {
+    auto m = cblas::to_blas_int(A.map().nrows());
+    auto n = cblas::to_blas_int(B.map().ncols());
+    auto k = cblas::to_blas_int(A.map().ncols());
     numeric_t* A_ptr = A.array().data();
     numeric_t* B_ptr = B.array().data();
     numeric_t* C_ptr = C.array().data();
@@ -261,9 +320,9 @@ transform(KokkosDVector<T0**, LAYOUT0, KOKKOS0...>& C,
     if(A.array().stride(0) != 1 || B.array().stride(0) != 1 || C.array().stride(0) != 1) {
       throw std::runtime_error("expecting column major layout");
     }
-    int lda = A.array().stride(1);
-    int ldb = B.array().stride(1);
-    int ldc = C.array().stride(1);
+    auto lda = cblas::to_blas_int(A.array().stride(1));
+    auto ldb = cblas::to_blas_int(B.array().stride(1));
+    auto ldc = cblas::to_blas_int(C.array().stride(1));
 
     // single rank inner product
     cblas::gemm<numeric_t>::call(CblasColMajor,
@@ -281,7 +340,7 @@ transform(KokkosDVector<T0**, LAYOUT0, KOKKOS0...>& C,
                                  C_ptr,
                                  ldc);
   } else {
-    throw std::runtime_error("not implemented.");
+    throw std::runtime_error("transform: B must not be distributed.");
   }
 }
 
@@ -302,26 +361,22 @@ add(M0& C,
                              typename vector1_t::storage_t::memory_space>::value,
                 "c,a not on same memory");
 
-  if (A.map().is_local() && C.map().is_local()) {
-    /* single rank */
-    int m = A.map().nrows();
-    int n = C.map().ncols();
-    numeric_t* A_ptr = A.array().data();
-    numeric_t* C_ptr = C.array().data();
-
-    if (A.array().stride(0) != 1 || C.array().stride(0) != 1) {
-      throw std::runtime_error("expecting column major layout");
-    }
-    // assume there are no strides
-    int lda = A.array().stride(1);
-    int ldc = C.array().stride(1);
+  // A, C have the same (possibly row-distributed) layout -> always local
+  auto m = cblas::to_blas_int(A.map().nrows());
+  auto n = cblas::to_blas_int(C.map().ncols());
+  numeric_t* A_ptr = A.array().data();
+  numeric_t* C_ptr = C.array().data();
 
-    using geam = cblas::geam<numeric_t>;
-    geam::call(
-        CblasColMajor, geam::N, geam::N, m, n, alpha, A_ptr, lda, beta, C_ptr, ldc, C_ptr, ldc);
-  } else {
-    throw std::runtime_error("not implemented.");
+  if (A.array().stride(0) != 1 || C.array().stride(0) != 1) {
+    throw std::runtime_error("expecting column major layout");
   }
+  // assume there are no strides
+  auto lda = cblas::to_blas_int(A.array().stride(1));
+  auto ldc = cblas::to_blas_int(C.array().stride(1));
+
+  using geam = cblas::geam<numeric_t>;
+  geam::call(
+      CblasColMajor, geam::N, geam::N, m, n, alpha, A_ptr, lda, beta, C_ptr, ldc, C_ptr, ldc);
 }
 
 }  // namespace nlcglib
@@ -2,6 +2,7 @@
 #include <type_traits>
 #include "la/cuda.hpp"
 #include "la/dvector.hpp"
+#include "utils/checked_cast.hpp"
 
 namespace nlcglib {
 
@@ -21,8 +22,8 @@ eigh(KokkosDVector<T, LAYOUT, KOKKOS...>& U,
     deep_copy(U, S);
 
     // assert status_create == CUSOLVER_STATUS_SUCCESS
-    int n = U.map().nrows();
-    int lda = U.array().stride(1);
+    auto n = checked_cast<int>(U.map().nrows(), "cublas/cusolver");
+    auto lda = checked_cast<int>(U.array().stride(1), "cublas/cusolver");
     typedef cuda::zheevd<numeric_t> zheevd_t;
     int Info;
     zheevd_t::call(zheevd_t::VECTOR, zheevd_t::UPPER, n, U.array().data(), lda, w.data(), Info);
@@ -41,8 +42,8 @@ cholesky(KokkosDVector<T, LAYOUT, KOKKOS...>& A)
     typedef typename vector_t::storage_t::value_type numeric_t;
     // first call potrf
     typedef cuda::potrf<numeric_t> potrf_t;
-    int n = A.map().nrows();
-    int lda = A.array().stride(1);
+    auto n = checked_cast<int>(A.map().nrows(), "cublas/cusolver");
+    auto lda = checked_cast<int>(A.array().stride(1), "cublas/cusolver");
     auto ptr_A = A.array().data();
     auto uplo = potrf_t::UPPER;
     int info_potrf;
@@ -64,16 +65,16 @@ solve_sym(KokkosDVector<T, LAYOUT, KOKKOS...>& A,
     typedef typename vector_t::storage_t::value_type numeric_t;
     // first call potrf
     typedef cuda::potrf<numeric_t> potrf_t;
-    int n = A.map().nrows();
-    int lda = A.array().stride(1);
-    int ldb = RHS.array().stride(1);
+    auto n = checked_cast<int>(A.map().nrows(), "cublas/cusolver");
+    auto lda = checked_cast<int>(A.array().stride(1), "cublas/cusolver");
+    auto ldb = checked_cast<int>(RHS.array().stride(1), "cublas/cusolver");
     auto ptr_B = RHS.array().data();
     auto ptr_A = A.array().data();
 
     auto uplo = potrf_t::UPPER;
     int info_potrf;
     potrf_t::call(uplo, n, ptr_A, lda, info_potrf);
-    int nrhs = RHS.array().extent(1);
+    auto nrhs = checked_cast<int>(RHS.array().extent(1), "cublas/cusolver");
 
     typedef cuda::potrs<numeric_t> potrs_t;
     potrs_t::call(uplo, n, nrhs, ptr_A, lda, ptr_B, ldb);
@@ -105,16 +106,16 @@ inner(M0& c,
       throw std::runtime_error("expecting column major layout");
     }
 
-    int m = a.map().ncols();
-    int k = a.map().nrows();
-    int n = b.map().ncols();
+    auto m = checked_cast<int>(a.map().ncols(), "cublas/cusolver");
+    auto k = checked_cast<int>(a.map().nrows(), "cublas/cusolver");
+    auto n = checked_cast<int>(b.map().ncols(), "cublas/cusolver");
     numeric_t* A_ptr = a.array().data();
     numeric_t* B_ptr = b.array().data();
     numeric_t* C_ptr = c.array().data();
 
-    int lda = a.array().stride(1);
-    int ldb = b.array().stride(1);
-    int ldc = c.array().stride(1);
+    auto lda = checked_cast<int>(a.array().stride(1), "cublas/cusolver");
+    auto ldb = checked_cast<int>(b.array().stride(1), "cublas/cusolver");
+    auto ldc = checked_cast<int>(c.array().stride(1), "cublas/cusolver");
 
     using gemm = cuda::gemm<numeric_t>;
     gemm::call(gemm::H, gemm::N, m, n, k, alpha, A_ptr, lda, B_ptr, ldb, beta, C_ptr, ldc);
@@ -155,16 +156,16 @@ outer(M0& c,
       throw std::runtime_error("expecting column major layout");
     }
 
-    int m = a.map().ncols();
-    int k = a.map().nrows();
-    int n = b.map().ncols();
+    auto m = checked_cast<int>(a.map().ncols(), "cublas/cusolver");
+    auto k = checked_cast<int>(a.map().nrows(), "cublas/cusolver");
+    auto n = checked_cast<int>(b.map().ncols(), "cublas/cusolver");
     numeric_t* A_ptr = a.array().data();
     numeric_t* B_ptr = b.array().data();
     numeric_t* C_ptr = c.array().data();
 
-    int lda = a.array().stride(1);
-    int ldb = b.array().stride(1);
-    int ldc = c.array().stride(1);
+    auto lda = checked_cast<int>(a.array().stride(1), "cublas/cusolver");
+    auto ldb = checked_cast<int>(b.array().stride(1), "cublas/cusolver");
+    auto ldc = checked_cast<int>(c.array().stride(1), "cublas/cusolver");
 
     using gemm = cuda::gemm<numeric_t>;
     gemm::call(gemm::N, gemm::H, m, n, k, alpha, A_ptr, lda, B_ptr, ldb, beta, C_ptr, ldc);
@@ -198,9 +199,9 @@ transform(M0& C,
 
   if (A.map().is_local() && B.map().is_local() && C.map().is_local()) {
     /* single rank */
-    int m = A.map().nrows();
-    int n = B.map().ncols();
-    int k = A.map().ncols();
+    auto m = checked_cast<int>(A.map().nrows(), "cublas/cusolver");
+    auto n = checked_cast<int>(B.map().ncols(), "cublas/cusolver");
+    auto k = checked_cast<int>(A.map().ncols(), "cublas/cusolver");
     numeric_t* A_ptr = A.array().data();
     numeric_t* B_ptr = B.array().data();
     numeric_t* C_ptr = C.array().data();
@@ -209,9 +210,9 @@ transform(M0& C,
       throw std::runtime_error("expecting column major layout");
     }
     // assume there are no strides
-    int lda = A.array().stride(1);
-    int ldb = B.array().stride(1);
-    int ldc = C.array().stride(1);
+    auto lda = checked_cast<int>(A.array().stride(1), "cublas/cusolver");
+    auto ldb = checked_cast<int>(B.array().stride(1), "cublas/cusolver");
+    auto ldc = checked_cast<int>(C.array().stride(1), "cublas/cusolver");
 
     using gemm = cuda::gemm<numeric_t>;
     gemm::call(gemm::N, gemm::N, m, n, k, alpha, A_ptr, lda, B_ptr, ldb, beta, C_ptr, ldc);
@@ -239,8 +240,8 @@ add(M0& C,
 
   if (A.map().is_local() && C.map().is_local()) {
     /* single rank */
-    int m = A.map().nrows();
-    int n = C.map().ncols();
+    auto m = checked_cast<int>(A.map().nrows(), "cublas/cusolver");
+    auto n = checked_cast<int>(C.map().ncols(), "cublas/cusolver");
     numeric_t* A_ptr = A.array().data();
     numeric_t* C_ptr = C.array().data();
 
@@ -248,8 +249,8 @@ add(M0& C,
       throw std::runtime_error("expecting column major layout");
     }
     // assume there are no strides
-    int lda = A.array().stride(1);
-    int ldc = C.array().stride(1);
+    auto lda = checked_cast<int>(A.array().stride(1), "cublas/cusolver");
+    auto ldc = checked_cast<int>(C.array().stride(1), "cublas/cusolver");
 
     using geam = cuda::geam<numeric_t>;
     geam::call(geam::N, geam::N, m, n, alpha, A_ptr, lda, beta, C_ptr, ldc, C_ptr, ldc);
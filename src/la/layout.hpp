@@ -1,6 +1,7 @@
 #pragma once
 
 #include <mpi.h>
+#include <cstddef>
 #include <initializer_list>
 #include <vector>
 
@@ -11,7 +12,7 @@ namespace nlcglib {
  */
 struct Block
 {
-  Block(int x_, int y_, int nrows_, int ncols_)
+  Block(std::ptrdiff_t x_, std::ptrdiff_t y_, std::ptrdiff_t nrows_, std::ptrdiff_t ncols_)
       : x(x_)
       , y(y_)
       , nrows(nrows_)
@@ -22,11 +23,11 @@ struct Block
   Block() = default;
 
   /// row begin
-  int x;
+  std::ptrdiff_t x;
   /// col begin
-  int y;
-  int nrows;
-  int ncols;
+  std::ptrdiff_t y;
+  std::ptrdiff_t nrows;
+  std::ptrdiff_t ncols;
 };
 
 /**
@@ -53,13 +54,13 @@ public:
 
 public:
   /// local number of rows
-  int nrows() const { throw std::runtime_error("invalid"); }
+  std::ptrdiff_t nrows() const { throw std::runtime_error("invalid"); }
   /// local number of columns
-  int ncols() const { throw std::runtime_error("invalid"); }
+  std::ptrdiff_t ncols() const { throw std::runtime_error("invalid"); }
 
 protected:
-  int nrow_{-1};
-  int ncol_{-1};
+  std::ptrdiff_t nrow_{-1};
+  std::ptrdiff_t ncol_{-1};
   std::vector<block_t> blocks_;
 };
 
@@ -68,7 +69,7 @@ protected:
 class SlabLayoutV : public BlockLayout
 {
 public:
-  SlabLayoutV(const std::vector<block_t>& blocks, int ncols = -1)
+  SlabLayoutV(const std::vector<block_t>& blocks, std::ptrdiff_t ncols = -1)
       : BlockLayout(blocks)
   {
     ncol_ = ncols;
@@ -86,9 +87,9 @@ public:
   // SlabLayoutV(const SlabLayoutV&) = default;
   // SlabLayoutV(SlabLayoutV&&) = default;
   /// local number of rows
-  int nrows() const { return nrow_; }
+  std::ptrdiff_t nrows() const { return nrow_; }
   /// local number of columns
-  int ncols() const { return ncol_; }
+  std::ptrdiff_t ncols() const { return ncol_; }
 };
 
 
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "traits.hpp"
+
+namespace nlcglib {
+
+/**
+ * Deferred call fun(eval(args)...), the result is computed at most once.
+ *
+ * Closure and arguments are stored by value (no type erasure), copies of a node share the
+ * memoized result. Arguments may be lazy themselves, they are evaluated on first use.
+ * A default constructed node is empty and must not be called.
+ */
+template <class F, class... ARGS>
+class lazy_node
+{
+public:
+  using result_type =
+      std::decay_t<decltype(std::declval<F&>()(eval(std::declval<const ARGS&>())...))>;
+
+  lazy_node() = default;
+
+  lazy_node(F fun, ARGS... args)
+      : state_(std::make_shared<state>(std::move(fun), std::move(args)...))
+  {
+  }
+
+  const result_type& operator()() const
+  {
+    state& s = *state_;
+    std::call_once(s.once, [&s]() { s.compute(std::index_sequence_for<ARGS...>{}); });
+    return *s.result();
+  }
+
+  /// true if the result has been computed (may be called from any thread)
+  bool ready() const { return state_ && state_->has_value.load(std::memory_order_acquire); }
+
+private:
+  struct state
+  {
+    state(F&& fun, ARGS&&... args)
+        : fun(std::move(fun))
+        , args(std::move(args)...)
+    {
+    }
+
+    state(const state&) = delete;
+    state& operator=(const state&) = delete;
+
+    ~state()
+    {
+      if (has_value.load(std::memory_order_relaxed)) result()->~result_type();
+    }
+
+    template <std::size_t... I>
+    void compute(std::index_sequence<I...>)
+    {
+      new (&storage) result_type(fun(eval(std::get<I>(args))...));
+      has_value.store(true, std::memory_order_release);
+    }
+
+    result_type* result() { return reinterpret_cast<result_type*>(&storage); }
+
+    F fun;
+    std::tuple<ARGS...> args;
+    std::once_flag once;
+    std::atomic<bool> has_value{false};
+    typename std::aligned_storage<sizeof(result_type), alignof(result_type)>::type storage;
+  };
+
+  std::shared_ptr<state> state_;
+};
+
+template <class F, class... ARGS>
+lazy_node<std::decay_t<F>, std::decay_t<ARGS>...>
+make_lazy(F&& fun, ARGS&&... args)
+{
+  return lazy_node<std::decay_t<F>, std::decay_t<ARGS>...>(std::forward<F>(fun),
+                                                           std::forward<ARGS>(args)...);
+}
+
+}  // namespace nlcglib
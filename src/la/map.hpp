@@ -27,9 +27,9 @@ public:
   Map& operator=(Map&& other) = default;
 
   /// global number of rows
-  int nrows() const { return layout_.nrows(); }
+  std::ptrdiff_t nrows() const { return layout_.nrows(); }
   /// global number of columns
-  int ncols() const { return layout_.ncols(); }
+  std::ptrdiff_t ncols() const { return layout_.ncols(); }
   bool is_local() const { return comm_.size() == 1; }
   Communicator& comm() { return comm_; }
   const Communicator& comm() const { return comm_; }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <map>
+#include <iterator>
+#include <stdexcept>
 #include <vector>
 #include <numeric>
 #include <algorithm>
@@ -15,6 +17,8 @@
 #include "la/dvector.hpp"
 #include "utils.hpp"
 #include "gpu/acc.hpp"
+#include "la/mvector_index.hpp"
+#include "utils/thread_budget.hpp"
 
 namespace nlcglib {
 
@@ -24,13 +28,21 @@ class mvector_base
 };
 
 
+/**
+ * Values per k-point (ik, ispn) of this rank.
+ *
+ * Flat storage: (key, value) pairs sorted by key in a contiguous array, plus a shared
+ * mvector_index over the keys. Lookup by key is a binary search, access by position
+ * (key(i), value(i)) is O(1). mvectors with the same key set share the index, see
+ * same_index(). Inserting a new key invalidates iterators and references.
+ */
 template<class T>
 class mvector : public mvector_base<mvector<T>, T> {
   static_assert(std::is_same<T, std::remove_reference_t<T>>::value, "must have ownership");
 public:
   using value_type = T;
   using key_t = std::pair<int, int>;
-  using container_t = std::map<key_t, T>;
+  using container_t = std::vector<std::pair<key_t, T>>;
 
 public :
   mvector(Communicator comm) : comm_(comm) {}
@@ -38,28 +50,52 @@ public :
   mvector(const mvector&) = default;
   mvector(mvector&&) = default;
   mvector& operator=(const mvector&) = default;
-  mvector(const container_t& data) : data_(data) {}
+  mvector& operator=(mvector&&) = default;
+  mvector(const std::map<key_t, T>& data) : data_(data.begin(), data.end()) { this->update_index(); }
+
+  /// default constructed values for the keys of `index`
+  mvector(Communicator comm, std::shared_ptr<const mvector_index> index)
+      : data_(index ? index->size() : 0)
+      , index_(index)
+      , comm_(comm)
+  {
+    for (std::size_t i = 0; i < data_.size(); ++i) data_[i].first = index->key(i);
+  }
 
   T& operator[] (key_t k)
   {
-    return data_[k];
+    auto it = this->lower_bound(k);
+    if (it == data_.end() || it->first != k) {
+      it = data_.emplace(it, k, T{});
+      this->update_index();
+    }
+    return it->second;
   }
 
   const T& operator[] (key_t k) const
   {
-    return data_.at(k);
+    return this->at(k);
   }
 
   T& at(key_t k)
   {
-    return data_.at(k);
+    auto it = this->find(k);
+    if (it == data_.end()) throw std::out_of_range("mvector::at");
+    return it->second;
   }
 
   const T& at(key_t k) const
   {
-    return data_.at(k);
+    auto it = this->find(k);
+    if (it == data_.end()) throw std::out_of_range("mvector::at");
+    return it->second;
   }
 
+  /// value at position i (in key order)
+  T& value(std::size_t i) { return data_[i].second; }
+  const T& value(std::size_t i) const { return data_[i].second; }
+
+  const key_t& key(std::size_t i) const { return data_[i].first; }
 
   auto begin()
   {
@@ -85,28 +121,47 @@ public :
     return this->data_;
   }
 
-  auto find()
+  auto find(const key_t& k)
+  {
+    auto it = this->lower_bound(k);
+    return (it != data_.end() && it->first == k) ? it : data_.end();
+  }
+
+  auto find(const key_t& k) const
   {
-    return data_.find();
+    auto it = this->lower_bound(k);
+    return (it != data_.end() && it->first == k) ? it : data_.end();
   }
 
   auto size() { return data_.size(); }
   auto size() const { return data_.size(); }
 
+  /// shared key index, nullptr if empty
+  const std::shared_ptr<const mvector_index>& index() const { return index_; }
+
+  /// true if other stores the same keys at the same positions
+  template <class Z>
+  bool same_index(const mvector<Z>& other) const
+  {
+    return index_ && index_ == other.index();
+  }
+
   mvector empty_like();
 
   mvector& operator=(std::map<key_t, T>&& data)
   {
-    data_ = std::forward<std::map<key_t, T>>(data);
+    data_.assign(std::make_move_iterator(data.begin()), std::make_move_iterator(data.end()));
+    this->update_index();
+    return *this;
   }
 
   template<typename Z>
   mvector& operator=(mvector<Z>& other)
   {
     // iterate over keys and call assign
-    for(auto& elem : data_) {
-      auto key = elem.first;
-      data_[key] = eval(other.at(key));
+    for (std::size_t i = 0; i < data_.size(); ++i) {
+      data_[i].second =
+          eval(this->same_index(other) ? other.value(i) : other.at(data_[i].first));
     }
     return *this;
   }
@@ -116,6 +171,10 @@ public :
     return comm_;
   }
 
+  /// keeps the host code buffers aliased by unmanaged entries alive, see make_mmvector_view
+  void set_owner(std::shared_ptr<const void> owner) { owner_ = std::move(owner); }
+  const std::shared_ptr<const void>& owner() const { return owner_; }
+
   template<class X=T>
   std::enable_if_t<std::is_scalar<X>::value, mvector<X>>
   allgather(Communicator comm = Communicator{MPI_COMM_NULL}) const;
@@ -125,8 +184,30 @@ public :
   allgather(Communicator comm = Communicator{MPI_COMM_NULL}) const;
 
 private:
+  auto lower_bound(const key_t& k)
+  {
+    return std::lower_bound(
+        data_.begin(), data_.end(), k, [](const auto& elem, const key_t& k) { return elem.first < k; });
+  }
+
+  auto lower_bound(const key_t& k) const
+  {
+    return std::lower_bound(
+        data_.begin(), data_.end(), k, [](const auto& elem, const key_t& k) { return elem.first < k; });
+  }
+
+  /// after a change of the key set, data_ must be sorted and unique
+  void update_index()
+  {
+    std::vector<key_t> keys(data_.size());
+    std::transform(data_.begin(), data_.end(), keys.begin(), [](auto& elem) { return elem.first; });
+    index_ = mvector_index::get(keys);
+  }
+
   container_t data_;
+  std::shared_ptr<const mvector_index> index_;
   Communicator comm_;
+  std::shared_ptr<const void> owner_;
 };
 
 template<class T>
@@ -156,8 +237,11 @@ mvector<T>::allgather(Communicator comm) const
 
   comm.allgather(serialize_buffer.data(), nelems);
 
-  // copy data into return object
+  // copy data into return object, sorted by key
+  std::sort(serialize_buffer.begin(), serialize_buffer.end(),
+            [](auto& a, auto& b) { return a.first < b.first; });
   result.data_ = container_t(serialize_buffer.begin(), serialize_buffer.end());
+  result.update_index();
 
   return result;
 }
@@ -272,28 +356,35 @@ mvector<T>::allgather(Communicator comm) const
 }
 
 
-template<class mspc, class xspc=mspc, class _=void>
+/// numeric_t: numeric type of the host buffer (std::complex<double> or double)
+template <class mspc, class xspc = mspc, class numeric_t = std::complex<double>, class _ = void>
 struct make_mmatrix_return_type
 {};
 
-template <class mspc, class xspc>
-struct make_mmatrix_return_type<mspc, xspc, std::enable_if_t<std::is_same<mspc, xspc>::value>>
+template <class mspc, class xspc, class numeric_t>
+struct make_mmatrix_return_type<mspc,
+                                xspc,
+                                numeric_t,
+                                std::enable_if_t<std::is_same<mspc, xspc>::value>>
 {
-  using type = KokkosDVector<Kokkos::complex<double>**,
+  using type = KokkosDVector<kokkos_numeric_t<numeric_t>**,
                              SlabLayoutV,
                              Kokkos::LayoutStride,
                              mspc,
                              Kokkos::MemoryUnmanaged>;
 };
 
-template <class mspc, class xspc>
-struct make_mmatrix_return_type<mspc, xspc, std::enable_if_t<!std::is_same<mspc, xspc>::value>>
+template <class mspc, class xspc, class numeric_t>
+struct make_mmatrix_return_type<mspc,
+                                xspc,
+                                numeric_t,
+                                std::enable_if_t<!std::is_same<mspc, xspc>::value>>
 {
-  using type = KokkosDVector<Kokkos::complex<double>**,
+  using type = KokkosDVector<kokkos_numeric_t<numeric_t>**,
                              SlabLayoutV,
                              Kokkos::LayoutLeft,
                              xspc>;
-  using view_type = KokkosDVector<Kokkos::complex<double>**,
+  using view_type = KokkosDVector<kokkos_numeric_t<numeric_t>**,
                                   SlabLayoutV,
                                   Kokkos::LayoutStride,
                                   mspc,
@@ -304,13 +395,13 @@ struct make_mmatrix_return_type<mspc, xspc, std::enable_if_t<!std::is_same<mspc,
 /// @brief create an mvector from SIRIUS adaptor
 /// @tparam T Kokkos memory space
 /// @tparam execution memory space
-template <class T, class X=T>
-mvector<typename make_mmatrix_return_type<T, X>::type>
-make_mmatrix(std::shared_ptr<MatrixBaseZ> matrix_base, std::enable_if_t<std::is_same<T, X>::value>* _ = nullptr)
+template <class T, class X=T, class numeric_t>
+mvector<typename make_mmatrix_return_type<T, X, numeric_t>::type>
+make_mmatrix(std::shared_ptr<BufferBase<2, numeric_t>> matrix_base, std::enable_if_t<std::is_same<T, X>::value>* _ = nullptr)
 {
   static_assert(std::is_same<T,X>::value, "invalid template parameters");
   using memspace = T;
-  typedef typename make_mmatrix_return_type<T>::type matrix_t;
+  typedef typename make_mmatrix_return_type<T, X, numeric_t>::type matrix_t;
   mvector<matrix_t> mvector(Communicator(matrix_base->mpicomm()));
   // kokkosDvector
   int num_vec = matrix_base->size();
@@ -339,14 +430,54 @@ make_mmatrix(std::shared_ptr<MatrixBaseZ> matrix_base, std::enable_if_t<std::is_
 }
 
 
+/// migrate the i-th entry to numa::home_domain(i), no-op unless NUMA-aware mode is on and the
+/// k-points are evaluated in concurrent tasks (otherwise every thread works on every k-point)
+template <class T, class LAYOUT, class... ARGS>
+void
+numa_place(const mvector<KokkosDVector<T, LAYOUT, ARGS...>>& x)
+{
+  using storage_t = typename KokkosDVector<T, LAYOUT, ARGS...>::storage_t;
+  if (!numa_enabled() || !kpoint_tasks_concurrent() ||
+      !Kokkos::SpaceAccessibility<Kokkos::HostSpace, typename storage_t::memory_space>::accessible)
+    return;
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    const auto& array = x.value(i).array();
+    numa::place(array.data(),
+                array.span() * sizeof(typename storage_t::value_type),
+                numa::home_domain(i));
+  }
+}
+
+/// sample the pages of all entries, counts pages which are not on the entry's home domain
+template <class T, class LAYOUT, class... ARGS>
+void
+numa_count_remote_pages(const mvector<KokkosDVector<T, LAYOUT, ARGS...>>& x,
+                        std::size_t& sampled,
+                        std::size_t& remote)
+{
+  using storage_t = typename KokkosDVector<T, LAYOUT, ARGS...>::storage_t;
+  if (!numa_enabled() ||
+      !Kokkos::SpaceAccessibility<Kokkos::HostSpace, typename storage_t::memory_space>::accessible)
+    return;
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    const auto& array = x.value(i).array();
+    numa::count_remote_pages(array.data(),
+                             array.span() * sizeof(typename storage_t::value_type),
+                             numa::home_domain(i),
+                             sampled,
+                             remote);
+  }
+}
+
+
 /// copy implementation
-template<class T, class X>
-mvector<typename make_mmatrix_return_type<T, X>::type>
-make_mmatrix(std::shared_ptr<MatrixBaseZ> matrix_base, std::enable_if_t<!std::is_same<T, X>::value>* _ =nullptr)
+template<class T, class X, class numeric_t>
+mvector<typename make_mmatrix_return_type<T, X, numeric_t>::type>
+make_mmatrix(std::shared_ptr<BufferBase<2, numeric_t>> matrix_base, std::enable_if_t<!std::is_same<T, X>::value>* _ =nullptr)
 {
   static_assert(!std::is_same<T, X>::value, "invalid template parameters");
   using memspace = T;
-  typedef typename make_mmatrix_return_type<T, X>::type matrix_t;
+  typedef typename make_mmatrix_return_type<T, X, numeric_t>::type matrix_t;
   mvector<matrix_t> mvector(Communicator(matrix_base->mpicomm()));
   // kokkosDvector
   int num_vec = matrix_base->size();
@@ -370,13 +501,17 @@ make_mmatrix(std::shared_ptr<MatrixBaseZ> matrix_base, std::enable_if_t<!std::is
     // copy view T, using cuda memcpy ...
     matrix_t mat(Map<>(comm, SlabLayoutV({{0, 0, buffer.size[0], buffer.size[1]}})));
     // issue memcpy
-    acc::copy(mat.array().data(), buffer.data, buffer.size[0]*buffer.size[1]);
+    acc::copy(mat.array().data(), buffer.data, static_cast<std::size_t>(buffer.size[0]) * buffer.size[1]);
     mvector[kindex] = mat;
   }
+  // the copies were first touched by the calling thread
+  numa_place(mvector);
   return mvector;
 }
 
 
+/// copy of the buffers of vector_base in memory space T, for entries which are modified or
+/// outlive vector_base
 template<class T>
 auto make_mmvector(std::shared_ptr<VectorBaseZ> vector_base)
 {
@@ -410,6 +545,44 @@ auto make_mmvector(std::shared_ptr<VectorBaseZ> vector_base)
 }
 
 
+/**
+ * Read-only import of vector_base without copies (counterpart of make_mmatrix<T, T>).
+ *
+ * The entries are unmanaged views of the buffers of vector_base, which must be in memory space
+ * T (throws otherwise, use make_mmvector to copy across spaces). The returned mvector holds
+ * vector_base (mvector::owner), copies of it share the ownership: the entries stay valid as
+ * long as one of them exists, provided the host code does not reallocate or modify the buffers
+ * owned by the BufferBase object meanwhile. Views copied out of the mvector do not hold it.
+ */
+template <class T>
+auto
+make_mmvector_view(std::shared_ptr<VectorBaseZ> vector_base)
+{
+  using memspace = T;
+  using vector_t = Kokkos::View<const double*, memspace, Kokkos::MemoryUnmanaged>;
+  mvector<vector_t> mvector(Communicator(vector_base->mpicomm()));
+  int num_vec = vector_base->size();
+  for (int i = 0; i < num_vec; ++i) {
+    auto buffer = vector_base->get(i);
+#ifdef __NLCGLIB__CUDA
+    if (Kokkos::SpaceAccessibility<Kokkos::Cuda, memspace>::accessible) {
+      if (buffer.memtype != memory_type::device)
+        throw std::runtime_error("expected device memory, but got " +
+                                 memory_names.at(buffer.memtype));
+    }
+#endif
+    if (Kokkos::SpaceAccessibility<Kokkos::Serial, memspace>::accessible) {
+      if (buffer.memtype != memory_type::host)
+        throw std::runtime_error("expected host memory, but got " +
+                                 memory_names.at(buffer.memtype));
+    }
+    mvector[vector_base->kpoint_index(i)] = vector_t(buffer.data, buffer.size[0]);
+  }
+  mvector.set_owner(std::move(vector_base));
+  return mvector;
+}
+
+
 inline auto make_mmscalar(std::shared_ptr<ScalarBaseZ> scalar_base)
 {
   mvector<ScalarBaseZ::buffer_t> mvector(Communicator(scalar_base->mpicomm()));
@@ -427,11 +600,10 @@ template <typename T>
 auto
 eval_threaded(const mvector<T>& input)
 {
-  mvector<std::remove_reference_t<decltype(eval(std::declval<T>()))>> result;
-  for (auto& elem : input) {
-    auto key = elem.first;
-    result[key] = eval(elem.second);
-  }
+  mvector<std::remove_reference_t<decltype(eval(std::declval<T>()))>> result(Communicator(),
+                                                                            input.index());
+  // k-points run concurrently according to the current thread_partition
+  for_each_kpoint(input.size(), [&](std::size_t i) { result.value(i) = eval(input.value(i)); });
   return result;
 }
 
@@ -459,14 +631,26 @@ auto sum(const Kokkos::View<numeric_t*, ARGS...>& x)
 }
 
 
-template <class T>
-std::enable_if_t<is_kokkos_view<eval_t<T>>::value, mvector<std::function<double()> > >
+template <class T, class = std::enable_if_t<is_kokkos_view<eval_t<T>>::value>>
+auto
 sum(const mvector<T>& x)
 {
   return tapply([](auto xi) { return(sum(eval(xi))); }, x);
 }
 
 
+/// sum over the k-points stored on this rank (no reduction), see reduction_batch
+template<class T>
+std::enable_if_t<std::is_scalar<eval_t<T>>::value || std::is_same<Kokkos::complex<double>, T>::value, eval_t<T>>
+local_sum(const mvector<T>& x)
+{
+  eval_t<T> sum = 0;
+  for (auto& elem: x) {
+    sum += eval(elem.second);
+  }
+  return sum;
+}
+
 template<class T>
 std::enable_if_t<std::is_scalar<eval_t<T>>::value || std::is_same<Kokkos::complex<double>, T>::value, eval_t<T>>
 sum(const mvector<T>& x, Communicator comm = Communicator{MPI_COMM_NULL})
@@ -477,11 +661,7 @@ sum(const mvector<T>& x, Communicator comm = Communicator{MPI_COMM_NULL})
     throw std::runtime_error("mvector::allgather: most likely gave unintended communicator");
   }
 
-  eval_t<T> sum = 0;
-  for (auto& elem: x) {
-    sum += eval(elem.second);
-  }
-  return comm.allreduce(sum, mpi_op::sum);
+  return comm.allreduce(local_sum(x), mpi_op::sum);
 }
 
 
@@ -527,63 +707,46 @@ auto copy(const mvector<X>& x)
 }
 
 
-template <class... T>
-auto unzip(const mvector<std::tuple<T...>>& V) {
-  std::tuple<mvector<T>...> U;
-
-  for (auto& elem : V) {
-    auto key = elem.first;
-    unzip(elem.second, U, key);
-  }
-
-  return U;
-}
-
-
-template <class... T>
-auto
-unzip(const mvector<std::tuple<T...>>& V, const Communicator& commk)
-{
-  std::tuple<mvector<T>...> U = std::make_tuple(mvector<T>{commk}...);
-
-  for (auto& elem : V) {
-    auto key = elem.first;
-    unzip(elem.second, U, key);
-  }
-
-  return U;
-}
-
-
 template <int POS>
 struct unzip_impl
 {
-  template <class key_t, class... T>
-  static auto apply(const std::tuple<T...>& src, std::tuple<mvector<T>...>& dst, const key_t& key)
+  template <class... T>
+  static void apply(const std::tuple<T...>& src, std::tuple<mvector<T>...>& dst, std::size_t i)
   {
-    auto& dsti = std::get<POS>(dst);
-    dsti[key] = std::get<POS>(src);
-    unzip_impl<POS - 1>::apply(src, dst, key);
+    std::get<POS>(dst).value(i) = std::get<POS>(src);
+    unzip_impl<POS - 1>::apply(src, dst, i);
   }
 };
 
 template <>
 struct unzip_impl<0>
 {
-  template <class key_t, class... T>
-  static auto apply(const std::tuple<T...>& src, std::tuple<mvector<T>...>& dst, const key_t& key)
+  template <class... T>
+  static void apply(const std::tuple<T...>& src, std::tuple<mvector<T>...>& dst, std::size_t i)
   {
-    auto& dsti = std::get<0>(dst);
-    dsti[key] = std::get<0>(src);
+    std::get<0>(dst).value(i) = std::get<0>(src);
   }
 };
 
-template <class key_t, class... T>
+
+/// mvector<tuple> -> tuple<mvector>, the results share the key index of V
+template <class... T>
 auto
-unzip(const std::tuple<T...>& src, std::tuple<mvector<T>...>& dst, const key_t& key)
+unzip(const mvector<std::tuple<T...>>& V, const Communicator& commk)
 {
-  using tuple_t = std::tuple<T...>;
-  unzip_impl<std::tuple_size<tuple_t>::value-1>::apply(src, dst , key);
+  std::tuple<mvector<T>...> U = std::make_tuple(mvector<T>(commk, V.index())...);
+
+  for (std::size_t i = 0; i < V.size(); ++i) {
+    unzip_impl<sizeof...(T) - 1>::apply(V.value(i), U, i);
+  }
+
+  return U;
+}
+
+
+template <class... T>
+auto unzip(const mvector<std::tuple<T...>>& V) {
+  return unzip(V, Communicator());
 }
 
 
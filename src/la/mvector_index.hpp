@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace nlcglib {
+
+/**
+ * Sorted set of k-point keys (ik, ispn) of an mvector.
+ *
+ * Indices are interned: all mvectors holding the same key set refer to the same
+ * index object, so two mvectors with equal index pointers store their entries at the same
+ * positions and can be traversed together by position instead of by key lookup.
+ */
+class mvector_index
+{
+public:
+  using key_t = std::pair<int, int>;
+
+  /// shared index for the given (sorted, unique) keys
+  static std::shared_ptr<const mvector_index> get(const std::vector<key_t>& keys)
+  {
+    static std::mutex mutex;
+    static std::map<std::vector<key_t>, std::weak_ptr<const mvector_index>> registry;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = registry.find(keys);
+    if (it != registry.end()) {
+      if (auto index = it->second.lock()) return index;
+    }
+    // drop indices which are no longer referenced
+    for (auto jt = registry.begin(); jt != registry.end();) {
+      jt = jt->second.expired() ? registry.erase(jt) : std::next(jt);
+    }
+    auto index = std::shared_ptr<const mvector_index>(new mvector_index(keys));
+    registry[keys] = index;
+    return index;
+  }
+
+  std::size_t size() const { return keys_.size(); }
+
+  const key_t& key(std::size_t i) const { return keys_[i]; }
+
+  const std::vector<key_t>& keys() const { return keys_; }
+
+  /// position of key, size() if not present
+  std::size_t find(const key_t& key) const
+  {
+    auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+    if (it == keys_.end() || *it != key) return keys_.size();
+    return it - keys_.begin();
+  }
+
+private:
+  explicit mvector_index(std::vector<key_t> keys)
+      : keys_(std::move(keys))
+  {
+  }
+
+  std::vector<key_t> keys_;
+};
+
+}  // namespace nlcglib
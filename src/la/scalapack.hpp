@@ -0,0 +1,360 @@
+#pragma once
+
+#ifdef __NLCGLIB__SCALAPACK
+
+#include <mpi.h>
+#include <Kokkos_Core.hpp>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "mpi/communicator.hpp"
+
+extern "C" {
+int Csys2blacs_handle(MPI_Comm comm);
+void Cfree_blacs_system_handle(int handle);
+void Cblacs_gridinit(int* icontxt, char* order, int nprow, int npcol);
+void Cblacs_gridinfo(int icontxt, int* nprow, int* npcol, int* myrow, int* mycol);
+void Cblacs_gridexit(int icontxt);
+
+int numroc_(const int* n, const int* nb, const int* iproc, const int* isrcproc, const int* nprocs);
+void descinit_(int* desc,
+               const int* m,
+               const int* n,
+               const int* mb,
+               const int* nb,
+               const int* irsrc,
+               const int* icsrc,
+               const int* ictxt,
+               const int* lld,
+               int* info);
+void pzheevd_(const char* jobz,
+              const char* uplo,
+              const int* n,
+              std::complex<double>* a,
+              const int* ia,
+              const int* ja,
+              const int* desca,
+              double* w,
+              std::complex<double>* z,
+              const int* iz,
+              const int* jz,
+              const int* descz,
+              std::complex<double>* work,
+              const int* lwork,
+              double* rwork,
+              const int* lrwork,
+              int* iwork,
+              const int* liwork,
+              int* info);
+void pzpotrf_(const char* uplo,
+              const int* n,
+              std::complex<double>* a,
+              const int* ia,
+              const int* ja,
+              const int* desca,
+              int* info);
+void pzpotrs_(const char* uplo,
+              const int* n,
+              const int* nrhs,
+              const std::complex<double>* a,
+              const int* ia,
+              const int* ja,
+              const int* desca,
+              std::complex<double>* b,
+              const int* ib,
+              const int* jb,
+              const int* descb,
+              int* info);
+void pzgemr2d_(const int* m,
+               const int* n,
+               const std::complex<double>* a,
+               const int* ia,
+               const int* ja,
+               const int* desca,
+               std::complex<double>* b,
+               const int* ib,
+               const int* jb,
+               const int* descb,
+               const int* ictxt);
+}
+
+namespace nlcglib {
+namespace scalapack {
+
+/// BLACS process grid over a communicator (RAII)
+class blacs_grid
+{
+public:
+  /// most square grid nprow x npcol with nprow <= npcol over all ranks of comm
+  explicit blacs_grid(const Communicator& comm)
+      : blacs_grid(comm, square_nprow(comm.size()), comm.size() / square_nprow(comm.size()))
+  {
+  }
+
+  /// nprow x npcol grid over the first nprow * npcol ranks of comm, context() is -1 on the others
+  blacs_grid(const Communicator& comm, int nprow, int npcol)
+      : nprow_(nprow)
+      , npcol_(npcol)
+  {
+    handle_ = Csys2blacs_handle(comm.raw());
+    ctxt_ = handle_;
+    char order[] = "R";
+    Cblacs_gridinit(&ctxt_, order, nprow_, npcol_);
+    if (ctxt_ < 0) {
+      myrow_ = mycol_ = -1;
+    } else {
+      int nprow_out, npcol_out;
+      Cblacs_gridinfo(ctxt_, &nprow_out, &npcol_out, &myrow_, &mycol_);
+    }
+  }
+
+  blacs_grid(const blacs_grid&) = delete;
+  blacs_grid& operator=(const blacs_grid&) = delete;
+
+  ~blacs_grid()
+  {
+    if (ctxt_ >= 0) Cblacs_gridexit(ctxt_);
+    Cfree_blacs_system_handle(handle_);
+  }
+
+  int context() const { return ctxt_; }
+  int nprow() const { return nprow_; }
+  int npcol() const { return npcol_; }
+  int myrow() const { return myrow_; }
+  int mycol() const { return mycol_; }
+
+private:
+  static int square_nprow(int nranks)
+  {
+    int nprow = static_cast<int>(std::sqrt(static_cast<double>(nranks)));
+    while (nranks % nprow != 0) --nprow;
+    return nprow;
+  }
+
+  int handle_;
+  int ctxt_;
+  int nprow_;
+  int npcol_;
+  int myrow_;
+  int mycol_;
+};
+
+/// BLACS grids of a communicator
+struct blacs_grids
+{
+  explicit blacs_grids(const Communicator& comm)
+      : full(comm)
+      , root(comm, 1, 1)
+  {
+  }
+
+  /// 2D grid over all ranks, used by the solvers
+  blacs_grid full;
+  /// 1x1 grid on rank 0, target of the redistribution in gather
+  blacs_grid root;
+};
+
+namespace detail {
+inline int
+delete_blacs_grids(MPI_Comm, int, void* attr, void*)
+{
+  delete static_cast<blacs_grids*>(attr);
+  return MPI_SUCCESS;
+}
+}  // namespace detail
+
+/**
+ * BLACS grids of comm, created on the first call (collective over comm) and cached as an
+ * attribute of the communicator, i.e. released by MPI_Comm_free.
+ */
+inline const blacs_grids&
+get_blacs_grids(const Communicator& comm)
+{
+  static std::mutex mutex;
+  static int keyval = [] {
+    int keyval;
+    MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, &detail::delete_blacs_grids, &keyval, nullptr);
+    return keyval;
+  }();
+  std::lock_guard<std::mutex> lock(mutex);
+  void* attr{nullptr};
+  int found{0};
+  MPI_Comm_get_attr(comm.raw(), keyval, &attr, &found);
+  if (found) return *static_cast<blacs_grids*>(attr);
+  auto* grids = new blacs_grids(comm);
+  MPI_Comm_set_attr(comm.raw(), keyval, grids);
+  return *grids;
+}
+
+/// Local part of a 2D block-cyclic distributed matrix
+struct block_cyclic_matrix
+{
+  block_cyclic_matrix(const blacs_grid& grid, int m, int n, int nb)
+      : m(m)
+      , n(n)
+      , nb(nb)
+  {
+    int izero = 0;
+    int myrow = grid.myrow();
+    int mycol = grid.mycol();
+    int nprow = grid.nprow();
+    int npcol = grid.npcol();
+    mloc = numroc_(&m, &nb, &myrow, &izero, &nprow);
+    nloc = numroc_(&n, &nb, &mycol, &izero, &npcol);
+    int lld = std::max(1, mloc);
+    int ctxt = grid.context();
+    int info;
+    descinit_(desc, &m, &n, &nb, &nb, &izero, &izero, &ctxt, &lld, &info);
+    if (info != 0) throw std::runtime_error("descinit failed, info=" + std::to_string(info));
+    data.resize(static_cast<std::size_t>(lld) * std::max(1, nloc));
+  }
+
+  /// global index of local row/column `l` on process coordinate `p` out of `np`
+  static int global_index(int l, int p, int np, int nb) { return ((l / nb) * np + p) * nb + l % nb; }
+
+  int m, n, nb;
+  int mloc, nloc;
+  int desc[9];
+  std::vector<std::complex<double>> data;
+};
+
+/// replicated (column-major, leading dimension lda) -> 2D block-cyclic, purely local copy
+inline void
+scatter(block_cyclic_matrix& dst, const std::complex<double>* src, int lda, const blacs_grid& grid)
+{
+  int lld = std::max(1, dst.mloc);
+  for (int jl = 0; jl < dst.nloc; ++jl) {
+    int j = block_cyclic_matrix::global_index(jl, grid.mycol(), grid.npcol(), dst.nb);
+    for (int il = 0; il < dst.mloc; ++il) {
+      int i = block_cyclic_matrix::global_index(il, grid.myrow(), grid.nprow(), dst.nb);
+      dst.data[il + jl * lld] = src[i + static_cast<std::size_t>(j) * lda];
+    }
+  }
+}
+
+/// 2D block-cyclic -> replicated on all ranks of `comm`: pzgemr2d to rank 0 and broadcast
+inline void
+gather(std::complex<double>* dst,
+       int lda,
+       const block_cyclic_matrix& src,
+       const blacs_grids& grids,
+       const Communicator& comm)
+{
+  int m = src.m;
+  int n = src.n;
+  // contiguous dst is filled in-place, otherwise through a buffer
+  std::vector<std::complex<double>> buf;
+  std::complex<double>* ptr = dst;
+  if (lda != m) {
+    buf.resize(static_cast<std::size_t>(m) * n);
+    ptr = buf.data();
+  }
+  // column-major m x n on the 1x1 grid, ranks outside of the grid pass context -1
+  int desc[9] = {1, -1, m, n, m, n, 0, 0, 1};
+  if (grids.root.context() >= 0) {
+    int izero = 0;
+    int ctxt = grids.root.context();
+    int lld = std::max(1, m);
+    int info;
+    descinit_(desc, &m, &n, &m, &n, &izero, &izero, &ctxt, &lld, &info);
+    if (info != 0) throw std::runtime_error("descinit failed, info=" + std::to_string(info));
+  }
+  int ione = 1;
+  int ctxt = grids.full.context();
+  pzgemr2d_(&m, &n, src.data.data(), &ione, &ione, src.desc, ptr, &ione, &ione, desc, &ctxt);
+  comm.bcast(ptr, static_cast<std::ptrdiff_t>(m) * n, 0);
+  if (lda != m) {
+    for (int j = 0; j < n; ++j)
+      std::copy(buf.data() + static_cast<std::size_t>(j) * m,
+                buf.data() + static_cast<std::size_t>(j + 1) * m,
+                dst + static_cast<std::size_t>(j) * lda);
+  }
+}
+
+/**
+ * Hermitian eigenvalue problem S = U diag(w) U^H with pzheevd.
+ *
+ * S and U are replicated (col-major), the result is replicated again on return.
+ */
+inline void
+zheevd(std::complex<double>* U,
+       int ldu,
+       double* w,
+       const std::complex<double>* S,
+       int lds,
+       int n,
+       int nb,
+       const Communicator& comm)
+{
+  const auto& grids = get_blacs_grids(comm);
+  const auto& grid = grids.full;
+  block_cyclic_matrix A(grid, n, n, nb);
+  block_cyclic_matrix Z(grid, n, n, nb);
+  scatter(A, S, lds, grid);
+
+  char jobz = 'V';
+  char uplo = 'U';
+  int ione = 1;
+  int info;
+  // workspace query
+  int lwork = -1, lrwork = -1, liwork = -1;
+  std::complex<double> work_q;
+  double rwork_q;
+  int iwork_q;
+  pzheevd_(&jobz, &uplo, &n, A.data.data(), &ione, &ione, A.desc, w, Z.data.data(), &ione, &ione,
+           Z.desc, &work_q, &lwork, &rwork_q, &lrwork, &iwork_q, &liwork, &info);
+  lwork = static_cast<int>(work_q.real());
+  lrwork = static_cast<int>(rwork_q);
+  liwork = iwork_q;
+  std::vector<std::complex<double>> work(lwork);
+  std::vector<double> rwork(lrwork);
+  std::vector<int> iwork(liwork);
+  pzheevd_(&jobz, &uplo, &n, A.data.data(), &ione, &ione, A.desc, w, Z.data.data(), &ione, &ione,
+           Z.desc, work.data(), &lwork, rwork.data(), &lrwork, iwork.data(), &liwork, &info);
+  if (info != 0) throw std::runtime_error("pzheevd failed, info=" + std::to_string(info));
+
+  gather(U, ldu, Z, grids, comm);
+}
+
+/**
+ * Solve A X = B for hermitian positive definite A with pzpotrf/pzpotrs.
+ *
+ * A and B are replicated (col-major), B is overwritten by the solution.
+ */
+inline void
+zposv(std::complex<double>* A,
+      int lda,
+      std::complex<double>* B,
+      int ldb,
+      int n,
+      int nrhs,
+      int nb,
+      const Communicator& comm)
+{
+  const auto& grids = get_blacs_grids(comm);
+  const auto& grid = grids.full;
+  block_cyclic_matrix Ad(grid, n, n, nb);
+  block_cyclic_matrix Bd(grid, n, nrhs, nb);
+  scatter(Ad, A, lda, grid);
+  scatter(Bd, B, ldb, grid);
+
+  char uplo = 'U';
+  int ione = 1;
+  int info;
+  pzpotrf_(&uplo, &n, Ad.data.data(), &ione, &ione, Ad.desc, &info);
+  if (info != 0) throw std::runtime_error("pzpotrf failed, info=" + std::to_string(info));
+  pzpotrs_(&uplo, &n, &nrhs, Ad.data.data(), &ione, &ione, Ad.desc, Bd.data.data(), &ione, &ione,
+           Bd.desc, &info);
+  if (info != 0) throw std::runtime_error("pzpotrs failed, info=" + std::to_string(info));
+
+  gather(B, ldb, Bd, grids, comm);
+}
+
+}  // namespace scalapack
+}  // namespace nlcglib
+
+#endif /* __NLCGLIB__SCALAPACK */
@@ -1,12 +1,14 @@
 #pragma once
 
 #include <Kokkos_Core.hpp>
+#include <algorithm>
 #include <functional>
 #include <future>
 #include <vector>
 #include <la/dvector.hpp>
 #include <exec_space.hpp>
 #include <traits.hpp>
+#include "la/lazy.hpp"
 
 namespace nlcglib {
 
@@ -88,7 +90,17 @@ template <class T, class LAYOUT, class... KOKKOS_ARGS>
 auto
 _identity_like(const KokkosDVector<T**, LAYOUT, KOKKOS_ARGS...>& input)
 {
-  throw std::runtime_error("not implemented");
+  using mat_t = to_layout_left_t<KokkosDVector<T**, LAYOUT, KOKKOS_ARGS...>>;
+  using memspc = typename mat_t::storage_t::memory_space;
+  using numeric_t = typename mat_t::numeric_t;
+  mat_t id(input.map());
+  auto arr = id.array();
+  int n = std::min(arr.extent(0), arr.extent(1));
+  Kokkos::parallel_for(
+      "identity", Kokkos::RangePolicy<exec_t<memspc>>(0, n), KOKKOS_LAMBDA(int i) {
+        arr(i, i) = numeric_t{1.0};
+      });
+  return id;
 }
 
 inline std::vector<double>
@@ -113,6 +125,15 @@ struct zeros_like
   }
 };
 
+struct identity_like
+{
+  template <class T>
+  auto operator()(T&& t) const
+  {
+    return _identity_like(std::forward<T>(t));
+  }
+};
+
 
 template <class T, class... ARGS>
 Kokkos::View<T*, ARGS...>
@@ -189,18 +210,37 @@ print(const Kokkos::View<T*, ARGS...>& x)
   std::cout << "\n";
 }
 
-/// threaded apply over mvector
+namespace mvector_impl {
+
+/// entry of c for the i-th key of arg0, by position if c shares the key index of arg0
+template <class T, class ARG0>
+decltype(auto)
+zip_at(const mvector<T>& c, const ARG0& arg0, std::size_t i)
+{
+  return c.same_index(arg0) ? c.value(i) : c.at(arg0.key(i));
+}
+
+/// operators (Overlap, USPreconditioner, ...) are looked up by key
+template <class C, class ARG0>
+decltype(auto)
+zip_at(const C& c, const ARG0& arg0, std::size_t i)
+{
+  return c.at(arg0.key(i));
+}
+
+}  // namespace mvector_impl
+
+/// lazy apply over mvector, returns an mvector of lazy_node (evaluated at most once)
 template <class FUNCTOR, class ARG, class... ARGS>
 auto
 tapply(FUNCTOR&& fun, const ARG& arg0, const ARGS&... args)
 {
-  using R = decltype(fun(eval(std::declval<typename ARG::value_type>()),
-                         eval(std::declval<typename ARGS::value_type>())...));
-  mvector<std::function<R()>> result(arg0.commk());
-  for (auto& elem : arg0) {
-    auto key = elem.first;
-    auto get_key = [key](auto container) { return container.at(key); };
-    result[key] = std::bind(fun, eval(get_key(arg0)), eval(get_key(args))...);
+  using node_t = lazy_node<std::decay_t<FUNCTOR>,
+                           typename ARG::value_type,
+                           std::decay_t<decltype(mvector_impl::zip_at(args, arg0, 0))>...>;
+  mvector<node_t> result(arg0.commk(), arg0.index());
+  for (std::size_t i = 0; i < arg0.size(); ++i) {
+    result.value(i) = node_t(fun, arg0.value(i), mvector_impl::zip_at(args, arg0, i)...);
   }
   return result;
 }
@@ -216,17 +256,13 @@ template <class OP, class ARG0, class... ARGS>
 auto
 tapply_op(OP&& op, const ARG0& arg0, const ARGS&... args)
 {
-  // TODO: would need op for a single key here ...
-  // using R = decltype(op(eval(std::declval<ARG0>()), eval(std::declval<ARGS>())...));
-  using R = decltype(empty_like()(eval(std::declval<typename ARG0::value_type>())));
-
-  mvector<std::function<R()>> result(arg0.commk());
-  for (auto& elem : arg0) {
-    auto key = elem.first;
-    // find_type<decltype(key)>::t;
-    auto get_key = [key](auto container) { return container.at(key); };
-    auto fun = op.at(key);
-    result[key] = [=](){ return fun(eval(get_key(arg0)), eval(get_key(args))...); };
+  using node_t = lazy_node<std::decay_t<decltype(op.at(arg0.key(0)))>,
+                           typename ARG0::value_type,
+                           std::decay_t<decltype(mvector_impl::zip_at(args, arg0, 0))>...>;
+
+  mvector<node_t> result(arg0.commk(), arg0.index());
+  for (std::size_t i = 0; i < arg0.size(); ++i) {
+    result.value(i) = node_t(op.at(arg0.key(i)), arg0.value(i), mvector_impl::zip_at(args, arg0, i)...);
   }
   return result;
 }
@@ -238,13 +274,12 @@ tapply_async(FUNCTOR&& fun, const ARG& arg0, const ARGS&... args)
 {
   using R = decltype(fun(eval(std::declval<typename ARG::value_type>()),
                          eval(std::declval<typename ARGS::value_type>())...));
-  mvector<std::shared_future<R>> result(arg0.commk());
-  for (auto& elem : arg0) {
-    auto key = elem.first;
-    auto get_key = [key](auto container) { return container.at(key); };
-    result[key] = std::async(std::launch::deferred,
-                             std::bind(fun, eval(get_key(arg0)), eval(get_key(args))...))
-                      .share();
+  mvector<std::shared_future<R>> result(arg0.commk(), arg0.index());
+  for (std::size_t i = 0; i < arg0.size(); ++i) {
+    result.value(i) =
+        std::async(std::launch::deferred,
+                   std::bind(fun, eval(arg0.value(i)), eval(mvector_impl::zip_at(args, arg0, i))...))
+            .share();
   }
   return result;
 }
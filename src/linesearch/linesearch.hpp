@@ -31,13 +31,15 @@ public:
       // sprintf(msg, "slope = %.5e > 0, abort!", slope);
       throw SlopeError();
     }
-    Logger::GetInstance() << "line search t_trial = " << std::scientific << t_trial << "\n";
+    NLCGLIB_LOG_DEBUG << "line search t_trial = " << std::scientific << t_trial << "\n";
     double F0 = FE.get_F();
+    num_searches++;
     try {
       return std::tuple_cat(qline(G, FE, slope, force_restart), std::make_tuple(line_search_info{"qline"}));
     } catch (StepError& step_error) {
       Logger::GetInstance() << "\t"
                             << "quadratic line search failed -> backtracking search\n";
+      num_bt_search++;
       return std::tuple_cat(bt_search(G, FE, F0, force_restart), std::make_tuple(line_search_info{"btsearch"}));
     }
   }
@@ -46,6 +48,18 @@ public:
   double t_trial{0.2};
   /// parameter for backtracking search
   double tau{0.1};
+
+  /// accept a trial step with F(t) <= F(0) + armijo * t * slope without the quadratic fit
+  /// (0: off, the trial step is always refined)
+  double armijo{0};
+
+  /// step accepted by the last search (0 if it was reset to the starting point)
+  double t_last{0};
+
+  /// number of calls
+  int num_searches{0};
+  /// number of fallbacks to backtracking search
+  int num_bt_search{0};
 };
 
 
@@ -65,15 +79,16 @@ line_search::bt_search(GEODESIC& G, FREE_ENERGY& FE, double F0, bool& force_rest
   while (t > 1e-8) {
     auto ek_ul = G(t);
     double Fp = FE.get_F();
-    Logger::GetInstance() << "fd slope: " << std::scientific << std::setprecision(3) << (Fp - F0) / t << " t: " << t
-                          << " F:" << std::fixed << std::setprecision(13) << Fp << "\n";
+    NLCGLIB_LOG_DEBUG << "fd slope: " << std::scientific << std::setprecision(3) << (Fp - F0) / t << " t: " << t
+                      << " F:" << std::fixed << std::setprecision(13) << Fp << "\n";
     if (Fp < F0) {
-      Logger::GetInstance() << "fd slope: " << std::scientific << std::setprecision(3) << (Fp - F0)/t << "\n";
+      NLCGLIB_LOG_DEBUG << "fd slope: " << std::scientific << std::setprecision(3) << (Fp - F0)/t << "\n";
       force_restart = false;
+      t_last = t;
       return ek_ul;
     }
     t *= tau;
-    Logger::GetInstance() << "\tbacktracking search tau = " << std::scientific << std::setprecision(5) << t << "\n";
+    NLCGLIB_LOG_DEBUG << "\tbacktracking search tau = " << std::scientific << std::setprecision(5) << t << "\n";
   }
   // TODO: let logger print state
   Logger::GetInstance().flush();
@@ -81,6 +96,7 @@ line_search::bt_search(GEODESIC& G, FREE_ENERGY& FE, double F0, bool& force_rest
     throw DescentError();
   } else {
     force_restart = true;
+    t_last = 0;
     return G(0);  // reset gradient
   }
 }
@@ -114,16 +130,24 @@ line_search::qline(GEODESIC& G, FREE_ENERGY& FE, double slope, bool& force_resta
     b = slope;
 
     // evaluate at trial point and obtain new F
-    G(tsearch);
+    auto ek_ul_trial = G(tsearch);
     F1 = FE.get_F();
 
+    // sufficient decrease, e.g. the unit step of a quasi-Newton direction
+    if (armijo > 0 && F1 <= F0 + armijo * tsearch * slope) {
+      NLCGLIB_LOG_DEBUG << "\t trial step accepted, t = " << tsearch << "\n";
+      force_restart = false;
+      t_last = tsearch;
+      return ek_ul_trial;
+    }
+
     a = (F1 - b * tsearch - c) / (tsearch * tsearch);
 
     t_min = -b / (2 * a);
 
     // check curvature, might need to increase trial point
     if (a < 0) {
-      Logger::GetInstance() << "\t in line-search increase t_trial by *5 \n";
+      NLCGLIB_LOG_DEBUG << "\t in line-search increase t_trial by *5 \n";
       tsearch *= 5;
     } else {
       break;
@@ -135,18 +159,19 @@ line_search::qline(GEODESIC& G, FREE_ENERGY& FE, double slope, bool& force_resta
   // evaluate FE at predicted minimum
   auto ek_ul = G(t_min);
   double F_min = FE.get_F();
-  Logger::GetInstance() << "\t t_min = " << t_min <<  ", q line prediction error: " << std::scientific << std::setprecision(8) << (F_pred - F_min) <<  "\n";
+  NLCGLIB_LOG_DEBUG << "\t t_min = " << t_min <<  ", q line prediction error: " << std::scientific << std::setprecision(8) << (F_pred - F_min) <<  "\n";
 
   if (F_min > F0) {
-    Logger::GetInstance() << std::setprecision(13)
-                          << "\t quadratic line search failed:"
-                          << "\t - F_min: " << F_min << "\n"
-                          << "\t  -F0:    " << F0 << "\n\n";
+    NLCGLIB_LOG_WARNING << std::setprecision(13)
+                        << "\t quadratic line search failed:"
+                        << "\t - F_min: " << F_min << "\n"
+                        << "\t  -F0:    " << F0 << "\n\n";
     throw StepError();
   }
 
   // reset force_restart
   force_restart = false;
+  t_last = t_min;
 
   return ek_ul;
 }
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <mpi.h>
+#include <memory>
 #include <vector>
 #include <numeric>
+#include <stdexcept>
 #include "mpi_type.hpp"
+#include "utils/checked_cast.hpp"
 #include <cassert>
 
 #define CALL_MPI(func__, args__)                                        \
@@ -17,6 +20,82 @@
 
 namespace nlcglib {
 
+/**
+ * Handle of a non-blocking allreduce.
+ *
+ * Owns the send/receive buffer, the reduction is completed by wait() (or by the
+ * destructor, so that the buffer never goes out of scope while MPI writes to it).
+ */
+template <class T>
+class iallreduce_handle
+{
+public:
+  iallreduce_handle() = default;
+  iallreduce_handle(std::unique_ptr<std::vector<T>> buffer, MPI_Request request)
+      : buffer_(std::move(buffer))
+      , request_(request)
+      , pending_(true)
+  {
+  }
+
+  iallreduce_handle(const iallreduce_handle&) = delete;
+  iallreduce_handle& operator=(const iallreduce_handle&) = delete;
+
+  iallreduce_handle(iallreduce_handle&& other)
+      : buffer_(std::move(other.buffer_))
+      , request_(other.request_)
+      , pending_(other.pending_)
+  {
+    other.pending_ = false;
+  }
+
+  iallreduce_handle& operator=(iallreduce_handle&& other)
+  {
+    if (this != &other) {
+      this->wait_();
+      buffer_ = std::move(other.buffer_);
+      request_ = other.request_;
+      pending_ = other.pending_;
+      other.pending_ = false;
+    }
+    return *this;
+  }
+
+  ~iallreduce_handle() { this->wait_(); }
+
+  /// true if the reduction has completed (does not block)
+  bool test()
+  {
+    if (pending_) {
+      int flag;
+      CALL_MPI(MPI_Test, (&request_, &flag, MPI_STATUS_IGNORE));
+      pending_ = !flag;
+    }
+    return !pending_;
+  }
+
+  /// block until the reduction has completed, returns the reduced values
+  const std::vector<T>& wait()
+  {
+    this->wait_();
+    if (!buffer_) throw std::runtime_error("iallreduce_handle: no reduction in flight");
+    return *buffer_;
+  }
+
+private:
+  void wait_()
+  {
+    if (pending_) {
+      CALL_MPI(MPI_Wait, (&request_, MPI_STATUS_IGNORE));
+      pending_ = false;
+    }
+  }
+
+  std::unique_ptr<std::vector<T>> buffer_;
+  MPI_Request request_{MPI_REQUEST_NULL};
+  bool pending_{false};
+};
+
 class Communicator
 {
  public:
@@ -65,6 +144,16 @@ class Communicator
       return false;
   }
 
+  /// same group of processes in the same order (MPI_IDENT or MPI_CONGRUENT)
+  bool congruent(const Communicator& other) const
+  {
+    if (mpicomm_ == MPI_COMM_NULL || other.mpicomm_ == MPI_COMM_NULL)
+      return mpicomm_ == other.mpicomm_;
+    int result;
+    CALL_MPI(MPI_Comm_compare, (mpicomm_, other.mpicomm_, &result));
+    return result == MPI_IDENT || result == MPI_CONGRUENT;
+  }
+
   bool operator<(const Communicator& other)
   {
     return this->size() < other.size();
@@ -119,9 +208,32 @@ class Communicator
   template <class VAL>
   std::vector<std::vector<VAL>> allgather(const std::vector<VAL>& values) const;
 
+  /// gather variable sized arrays to `root` (MPI_Gatherv), the result is empty on other ranks
+  template <class VAL>
+  std::vector<std::vector<VAL>> gather(const std::vector<VAL>& values, int root) const;
+
   template <class T>
   T allreduce(T val, enum mpi_op op) const;
 
+  /// in-place allreduce of an array, throws if count exceeds the MPI (int) count range
+  template <class T>
+  void allreduce(T* buffer, std::ptrdiff_t count, enum mpi_op op) const;
+
+  /// broadcast of an array from `root`, throws if count exceeds the MPI (int) count range
+  template <class T>
+  void bcast(T* buffer, std::ptrdiff_t count, int root) const;
+
+  /// non-blocking allreduce of an array, see iallreduce_handle
+  template <class T>
+  iallreduce_handle<T> iallreduce(std::vector<T> values, enum mpi_op op) const;
+
+  /// non-blocking allreduce of a scalar, the result is `handle.wait()[0]`
+  template <class T>
+  iallreduce_handle<T> iallreduce(T val, enum mpi_op op) const
+  {
+    return this->iallreduce(std::vector<T>{val}, op);
+  }
+
   void barrier() const
   {
     CALL_MPI(MPI_Barrier, (mpicomm_));
@@ -209,6 +321,40 @@ Communicator::allgather(const std::vector<VAL>& values) const
   return result;
 }
 
+template <class VAL>
+std::vector<std::vector<VAL>>
+Communicator::gather(const std::vector<VAL>& values, int root) const
+{
+  int nranks = this->size();
+  int nelems_local = values.size();
+  std::vector<int> nelems(nranks);
+  CALL_MPI(MPI_Gather, (&nelems_local, 1, MPI_INT, nelems.data(), 1, MPI_INT, root, mpicomm_));
+  std::vector<int> scan(nranks + 1, 0);
+  std::partial_sum(nelems.begin(), nelems.end(), scan.data() + 1);
+
+  bool is_root = this->rank() == root;
+  std::vector<VAL> recv_buffer(is_root ? scan[nranks] : 0);
+  CALL_MPI(MPI_Gatherv,
+           (values.data(),
+            nelems_local,
+            mpi_type<VAL>::type(),
+            recv_buffer.data(),
+            nelems.data(),
+            scan.data(),
+            mpi_type<VAL>::type(),
+            root,
+            mpicomm_));
+
+  std::vector<std::vector<VAL>> result;
+  if (is_root) {
+    result.resize(nranks);
+    for (int i = 0; i < nranks; ++i) {
+      result[i] = std::vector<VAL>(recv_buffer.data() + scan[i], recv_buffer.data() + scan[i + 1]);
+    }
+  }
+  return result;
+}
+
 template <class T>
 T Communicator::allreduce(T val, enum mpi_op op) const
 {
@@ -237,4 +383,70 @@ T Communicator::allreduce(T val, enum mpi_op op) const
   return result;
 }
 
+template <class T>
+void
+Communicator::bcast(T* buffer, std::ptrdiff_t n, int root) const
+{
+  int count = checked_cast<int>(n, "MPI_Bcast");
+  CALL_MPI(MPI_Bcast, (buffer, count, mpi_type<T>::type(), root, mpicomm_));
+}
+
+template <class T>
+void
+Communicator::allreduce(T* buffer, std::ptrdiff_t n, enum mpi_op op) const
+{
+  int count = checked_cast<int>(n, "MPI_Allreduce");
+  switch (op) {
+    case mpi_op::sum: {
+      CALL_MPI(MPI_Allreduce,
+               (MPI_IN_PLACE, buffer, count, mpi_type<T>::type(), mpi_op_<mpi_op::sum>::value(), mpicomm_));
+      break;
+    }
+    case mpi_op::min: {
+      CALL_MPI(MPI_Allreduce,
+               (MPI_IN_PLACE, buffer, count, mpi_type<T>::type(), mpi_op_<mpi_op::min>::value(), mpicomm_));
+      break;
+    }
+    case mpi_op::max: {
+      CALL_MPI(MPI_Allreduce,
+               (MPI_IN_PLACE, buffer, count, mpi_type<T>::type(), mpi_op_<mpi_op::max>::value(), mpicomm_));
+      break;
+    }
+    default: {
+      throw std::runtime_error("Error: invalid MPI_Op given.");
+    }
+  }
+}
+
+template <class T>
+iallreduce_handle<T>
+Communicator::iallreduce(std::vector<T> values, enum mpi_op op) const
+{
+  // the buffer is heap allocated, so that its address survives moves of the handle
+  auto buffer = std::make_unique<std::vector<T>>(std::move(values));
+  int count = buffer->size();
+  MPI_Op mpiop;
+  switch (op) {
+    case mpi_op::sum: {
+      mpiop = mpi_op_<mpi_op::sum>::value();
+      break;
+    }
+    case mpi_op::min: {
+      mpiop = mpi_op_<mpi_op::min>::value();
+      break;
+    }
+    case mpi_op::max: {
+      mpiop = mpi_op_<mpi_op::max>::value();
+      break;
+    }
+    default: {
+      throw std::runtime_error("Error: invalid MPI_Op given.");
+    }
+  }
+  MPI_Request request;
+  CALL_MPI(MPI_Iallreduce,
+           (MPI_IN_PLACE, buffer->data(), count, mpi_type<T>::type(), mpiop, mpicomm_, &request));
+  return iallreduce_handle<T>(std::move(buffer), request);
+}
+
 }  // namespace nlcglib
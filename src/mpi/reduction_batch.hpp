@@ -0,0 +1,144 @@
+#pragma once
+
+#include <Kokkos_Complex.hpp>
+#include <complex>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "communicator.hpp"
+
+namespace nlcglib {
+
+/**
+ * Collects named partial sums and reduces all of them with a single allreduce.
+ *
+ * Usage:
+ *   reduction_batch batch(commk);
+ *   batch.add("fr", fr_loc);
+ *   batch.add("slope", slope_loc);
+ *   batch.flush();  // or flush_async() and do k-point local work
+ *   double fr = batch.get("fr");
+ *
+ * Adding to an existing name accumulates. Complex values occupy two slots.
+ */
+class reduction_batch
+{
+public:
+  explicit reduction_batch(const Communicator& comm)
+      : comm_(comm)
+  {
+  }
+
+  void add(const std::string& name, double value)
+  {
+    double* slot = this->slot(name, 1);
+    slot[0] += value;
+  }
+
+  void add(const std::string& name, const std::complex<double>& value)
+  {
+    double* slot = this->slot(name, 2);
+    slot[0] += value.real();
+    slot[1] += value.imag();
+  }
+
+  void add(const std::string& name, const Kokkos::complex<double>& value)
+  {
+    this->add(name, std::complex<double>(value.real(), value.imag()));
+  }
+
+  /// reduce all partial sums (blocking)
+  void flush()
+  {
+    this->check_open();
+    comm_.allreduce(values_.data(), values_.size(), mpi_op::sum);
+    state_ = state::reduced;
+  }
+
+  /// start the reduction, results are waited for in get()
+  void flush_async()
+  {
+    this->check_open();
+    handle_ = std::make_unique<iallreduce_handle<double>>(comm_.iallreduce(values_, mpi_op::sum));
+    state_ = state::in_flight;
+  }
+
+  /// true if the reduced values are available
+  bool ready()
+  {
+    if (state_ == state::in_flight) return handle_->test();
+    return state_ == state::reduced;
+  }
+
+  double get(const std::string& name) { return this->result(name, 1)[0]; }
+
+  std::complex<double> get_complex(const std::string& name)
+  {
+    const double* v = this->result(name, 2);
+    return std::complex<double>(v[0], v[1]);
+  }
+
+  /// drop all entries, the batch can be reused afterwards
+  void clear()
+  {
+    handle_.reset();
+    values_.clear();
+    offsets_.clear();
+    state_ = state::open;
+  }
+
+  std::size_t size() const { return offsets_.size(); }
+
+private:
+  enum class state
+  {
+    open,
+    in_flight,
+    reduced
+  };
+
+  void check_open() const
+  {
+    if (state_ != state::open) throw std::runtime_error("reduction_batch: already flushed");
+  }
+
+  double* slot(const std::string& name, int width)
+  {
+    this->check_open();
+    auto it = offsets_.find(name);
+    if (it == offsets_.end()) {
+      it = offsets_.emplace(name, std::make_pair(values_.size(), width)).first;
+      values_.resize(values_.size() + width, 0);
+    } else if (it->second.second != width) {
+      throw std::runtime_error("reduction_batch: " + name + " added as real and complex");
+    }
+    return values_.data() + it->second.first;
+  }
+
+  const double* result(const std::string& name, int width)
+  {
+    if (state_ == state::open) throw std::runtime_error("reduction_batch: not flushed");
+    if (state_ == state::in_flight) {
+      values_ = handle_->wait();
+      handle_.reset();
+      state_ = state::reduced;
+    }
+    auto it = offsets_.find(name);
+    if (it == offsets_.end()) throw std::runtime_error("reduction_batch: unknown entry " + name);
+    if (it->second.second != width)
+      throw std::runtime_error("reduction_batch: " + name + " has a different type");
+    return values_.data() + it->second.first;
+  }
+
+  Communicator comm_;
+  std::vector<double> values_;
+  /// name -> (offset, width)
+  std::map<std::string, std::pair<std::size_t, int>> offsets_;
+  std::unique_ptr<iallreduce_handle<double>> handle_;
+  state state_{state::open};
+};
+
+}  // namespace nlcglib
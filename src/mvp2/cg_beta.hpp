@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cmath>
+#include "interface.hpp"
+
+namespace nlcglib {
+
+/// beta of a CG step, 0 restarts (steepest descent)
+struct cg_beta_result
+{
+  double beta{0};
+  /// restarted by the Powell test
+  bool powell_restart{false};
+  /// PR+/HS beta < 0 reset to 0
+  bool reset{false};
+};
+
+/**
+ * CG update formulas in the preconditioned metric, see descent_direction.
+ *
+ * fr = <g, Δ>, fr_old = <g_prev, Δ_prev>, slope_zp = <g, Z(n-1)>, gp_delta = <G(n-1), Δ> and
+ * gp_zp = <G(n-1), Z(n-1)>, G(n-1) is the transported previous gradient. Without it
+ * (has_gradient == false) the Fletcher-Reeves beta is returned.
+ */
+inline cg_beta_result
+cg_beta(cg_update update,
+        double powell_restart,
+        double fr,
+        double fr_old,
+        double slope_zp,
+        double gp_delta,
+        double gp_zp,
+        bool has_gradient)
+{
+  cg_beta_result res;
+  // consecutive gradients far from orthogonal
+  if (has_gradient && powell_restart > 0 && std::abs(gp_delta) >= powell_restart * std::abs(fr)) {
+    res.powell_restart = true;
+    return res;
+  }
+  if (!has_gradient || update == cg_update::FLETCHER_REEVES) {
+    res.beta = fr / fr_old;
+    return res;
+  }
+
+  double b = 0;
+  if (update == cg_update::POLAK_RIBIERE_PLUS) {
+    b = (fr - gp_delta) / fr_old;
+  } else {
+    double denom = slope_zp - gp_zp;
+    b = denom == 0 ? 0 : -(fr - gp_delta) / denom;
+  }
+  if (!(b > 0)) {
+    res.reset = true;
+    return res;
+  }
+  res.beta = b;
+  return res;
+}
+
+}  // namespace nlcglib
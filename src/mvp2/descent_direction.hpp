@@ -1,19 +1,53 @@
 #pragma once
 
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include "cg_beta.hpp"
 #include "descent_direction_impl.hpp"
+#include "mpi/reduction_batch.hpp"
+#include "utils/profiler.hpp"
 
 namespace nlcglib {
 
-template <enum smearing_type SMEARING_TYPE>
+/**
+ * RESIDENT: CG state (X, Z, ul) lives in the execution space, see descent_direction_impl
+ *
+ * With the Polak-Ribiere+ and Hestenes-Stiefel updates or the Powell restart test, the gradient
+ * of the last direction is kept and transported to the next iterate like Z (rotated by ul).
+ * In the preconditioned metric, with Δ = -P g and G(n-1) the transported previous gradient:
+ *   FR:  beta = <g, Δ> / <g_prev, Δ_prev>
+ *   PR+: beta = max(0, <g - G(n-1), Δ> / <g_prev, Δ_prev>)
+ *   HS:  beta = max(0, -<g - G(n-1), Δ> / <g - G(n-1), Z(n-1)>)
+ * and beta = 0 (steepest descent) if |<G(n-1), Δ>| >= powell_restart * |<g, Δ>|, see cg_beta.
+ *
+ * kappa only scales Δ_eta, it may be changed between iterations (set_kappa, see adaptive_kappa).
+ * The eta part of the current direction is then rescaled by the ratio of the new and old kappa
+ * (scale_eta), s.t. the next conjugated step combines directions of the same kappa.
+ */
+template <enum smearing_type SMEARING_TYPE, bool RESIDENT = false>
 class descent_direction
 {
 public:
-  descent_direction(double T, double kappa)
+  /// transfers: records host <-> execution space copies (may be nullptr)
+  /// mirrors: execution space copies of X shared with the geodesic (may be nullptr)
+  descent_direction(double T,
+                    double kappa,
+                    transfer_stats* transfers = nullptr,
+                    exec_space_mirrors* mirrors = nullptr)
       : T(T)
       , kappa(kappa)
+      , transfers(transfers)
+      , mirrors(mirrors)
   {
   }
 
+  /// uses the gradient kept by the last call of conjugated/restarted (Fletcher-Reeves if none)
+  /// restart: steepest descent (beta = 0), Z(n-1) is only transported for slope_zp
   template <class mem_t,
             class x_t,
             class e_t,
@@ -38,7 +72,8 @@ public:
                   double mu,
                   op_t&& S,
                   prec_t&& P,
-                  F&& free_energy);
+                  F&& free_energy,
+                  bool restart = false);
 
   /// restarted CG step or steepest descent
   template <class mem_t,
@@ -61,12 +96,203 @@ public:
       prec_t&& P,
       F&& free_energy);
 
+  /// steepest descent direction and gradient (<g, Δ>, Δ_X, Δ_eta, g_X, g_eta), Δ = -P g
+  template <class mem_t,
+            class x_t,
+            class e_t,
+            class f_t,
+            class hx_t,
+            class op_t,
+            class prec_t,
+            class F>
+  auto gradient(const mem_t& memspc,
+                const mvector<x_t>& X,
+                const mvector<e_t>& en,
+                const mvector<f_t>& fn,
+                const mvector<hx_t>& hx,
+                const mvector<double>& wk,
+                double mu,
+                op_t&& S,
+                prec_t&& P,
+                F&& free_energy)
+  {
+    return this->steepest(memspc, X, en, fn, hx, wk, mu, S, P, free_energy, true);
+  }
+
+  /// per k-point contributions to fr of the last computed direction (local k-points)
+  const mvector<double>& fr_k() const { return fr_k_; }
+
+  /// eta contributions to fr and to the slope <g, Z> of the last computed direction
+  double fr_eta() const { return fr_eta_; }
+  double slope_eta() const { return slope_eta_; }
+  /// <g, Z(n-1)> and its eta contribution of the last conjugated step (0 after a restart)
+  double slope_zp() const { return slope_zp_; }
+  double slope_zp_eta() const { return slope_zp_eta_; }
+
+  /// preconditioner of the pseudo-Hamiltonian, used from the next direction on
+  void set_kappa(double kappa) { this->kappa = kappa; }
+  double get_kappa() const { return kappa; }
+
+  /**
+   * Scales the eta part of the last computed direction by r, e.g. r = kappa_new / kappa_old after
+   * set_kappa. fr and slope (in/out) are updated as if the direction had been computed with r *
+   * kappa.
+   */
+  template <class z_t>
+  void scale_eta(double r, mvector<z_t>& z_eta, double& fr, double& slope)
+  {
+    eval_threaded(tapply_async(
+        [r](auto z) {
+          assign(z, r * expr::ref(z));
+          return "void";
+        },
+        z_eta));
+    fr += (r - 1) * fr_eta_;
+    slope += (r - 1) * slope_eta_;
+    fr_eta_ *= r;
+    slope_eta_ *= r;
+  }
+
+  /// CG update formula and Powell restart threshold (0: off)
+  void set_update(cg_update update, double powell_restart)
+  {
+    update_ = update;
+    powell_restart_ = powell_restart;
+  }
+  cg_update update() const { return update_; }
+
+  /// the gradient is kept for the next conjugated step
+  bool needs_gradient() const
+  {
+    return update_ != cg_update::FLETCHER_REEVES || powell_restart_ > 0;
+  }
+
+  /**
+   * The next conjugated step continues a direction of an earlier solver call (warm start), fr_old
+   * is the fr of that direction. The residuals of the two calls are unrelated, Z(n-1) is scaled to
+   * the size of Δ instead: beta = sqrt(fr / fr_old).
+   */
+  void set_warm_start() { warm_start_ = true; }
+  /// beta of the last conjugated step
+  double last_beta() const { return beta_; }
+
+  /// conjugated steps restarted by the Powell test / with beta < 0 (PR+, HS)
+  int num_powell_restarts() const { return num_powell_restarts_; }
+  int num_beta_resets() const { return num_beta_resets_; }
+
 private:
+  /// (fr, Δ_X, Δ_eta, g_X, g_eta), the gradients are empty unless with_gradient
+  template <class mem_t,
+            class x_t,
+            class e_t,
+            class f_t,
+            class hx_t,
+            class op_t,
+            class prec_t,
+            class F>
+  std::tuple<double,
+             mvector<to_layout_left_t<x_t>>,
+             mvector<to_layout_left_t<x_t>>,
+             mvector<to_layout_left_t<x_t>>,
+             mvector<to_layout_left_t<x_t>>>
+  steepest(const mem_t& memspc,
+           const mvector<x_t>& X,
+           const mvector<e_t>& en,
+           const mvector<f_t>& fn,
+           const mvector<hx_t>& hx,
+           const mvector<double>& wk,
+           double mu,
+           op_t&& S,
+           prec_t&& P,
+           F&& free_energy,
+           bool with_gradient);
+
+  /// fr + c * fr_mu per k-point
+  mvector<double> with_mu_term(const mvector<double>& fr, const mvector<double>& fr_mu, double c)
+  {
+    mvector<double> res = fr;
+    for (std::size_t i = 0; i < res.size(); ++i) res.value(i) += c * fr_mu.value(i);
+    return res;
+  }
+
+  /// g_eta <- g_eta + c * g_eta_mu (in-place)
+  template <class g_t, class gmu_t>
+  void add_mu_term(g_t& g_eta, const gmu_t& g_eta_mu, double c)
+  {
+    eval_threaded(tapply_async(
+        [c](auto g, auto g_mu) {
+          (void)add(g, g_mu, c);
+          return "void";
+        },
+        g_eta,
+        g_eta_mu));
+  }
+
+  /// beta of the selected update, 0 restarts (steepest descent)
+  double beta(double fr, double fr_old, double slope_zp, double gp_delta, double gp_zp,
+              bool has_gradient);
+
+  /// (g_X, g_eta) kept for the next conjugated step, in the representation of the directions
+  /// returned by restarted/conjugated for the wave-functions x_t
+  template <class x_t>
+  using gradient_t = std::pair<mvector<to_layout_left_t<x_t>>, mvector<to_layout_left_t<x_t>>>;
+
+  template <class G>
+  void set_gradient(G&& g)
+  {
+    using g_t = std::decay_t<G>;
+    g_prev_ = std::make_shared<g_t>(std::forward<G>(g));
+    g_prev_type_ = typeid(g_t);
+  }
+
+  /// nullptr if there is none, throws if it was stored with a different type
+  template <class G>
+  const G* get_gradient() const
+  {
+    if (!g_prev_) return nullptr;
+    if (g_prev_type_ != std::type_index(typeid(G))) {
+      throw std::runtime_error("descent_direction: the previous gradient has a different type");
+    }
+    return static_cast<const G*>(g_prev_.get());
+  }
+
   double T;
   double kappa;
+  transfer_stats* transfers;
+  exec_space_mirrors* mirrors;
+  mvector<double> fr_k_;
+  cg_update update_{cg_update::FLETCHER_REEVES};
+  double powell_restart_{0};
+  int num_powell_restarts_{0};
+  int num_beta_resets_{0};
+  bool warm_start_{false};
+  double beta_{0};
+  double fr_eta_{0};
+  double slope_eta_{0};
+  double slope_zp_{0};
+  double slope_zp_eta_{0};
+  /// (g_X, g_eta) of the last direction, type depends on the memory space of the run
+  std::shared_ptr<void> g_prev_;
+  std::type_index g_prev_type_{typeid(void)};
 };
 
-template <enum smearing_type SMEARING_TYPE>
+template <enum smearing_type SMEARING_TYPE, bool RESIDENT>
+double
+descent_direction<SMEARING_TYPE, RESIDENT>::beta(
+    double fr, double fr_old, double slope_zp, double gp_delta, double gp_zp, bool has_gradient)
+{
+  auto res =
+      cg_beta(update_, powell_restart_, fr, fr_old, slope_zp, gp_delta, gp_zp, has_gradient);
+  if (res.powell_restart) {
+    num_powell_restarts_++;
+    NLCGLIB_LOG_INFO << "Powell restart: |<G(n-1), P g>| / <g, P g> = " << std::setprecision(3)
+                     << std::abs(gp_delta / fr) << "\n";
+  }
+  if (res.reset) num_beta_resets_++;
+  return res.beta;
+}
+
+template <enum smearing_type SMEARING_TYPE, bool RESIDENT>
 template <class mem_t,
           class x_t,
           class e_t,
@@ -79,7 +305,7 @@ template <class mem_t,
           class prec_t,
           class F>
 auto
-descent_direction<SMEARING_TYPE>::conjugated(const mem_t& memspc,
+descent_direction<SMEARING_TYPE, RESIDENT>::conjugated(const mem_t& memspc,
                                              double fr_old,
                                              const mvector<x_t>& X,
                                              const mvector<e_t>& en,
@@ -92,39 +318,98 @@ descent_direction<SMEARING_TYPE>::conjugated(const mem_t& memspc,
                                              double mu,
                                              op_t&& S,
                                              prec_t&& P,
-                                             F&& free_energy)
+                                             F&& free_energy,
+                                             bool restart)
 {
+  NLCGLIB_PROFILE_REGION("descent direction");
   double mo = free_energy.occupancy();
-  /* always executed on CPU */
-  double dFdmu = GradEtaHelper<SMEARING_TYPE>::dFdmu(free_energy.get_ek(), en, fn, wk, mu, T, mo);
-  double sumfn = GradEtaHelper<SMEARING_TYPE>::dmu_deta(en, wk, mu, T, mo);
-
   auto commk = wk.commk();
 
-  descent_direction_impl<mem_t, SMEARING_TYPE> functor(memspc, mu, dFdmu, sumfn, T, kappa, mo);
+  /* always executed on CPU, the reduction is in flight while the directions are computed,
+   * its result enters through c * g_eta_mu, see descent_direction_impl */
+  reduction_batch mu_batch(commk);
+  mu_batch.add("dFdmu",
+               GradEtaHelper<SMEARING_TYPE>::dFdmu_local(
+                   free_energy.get_ek_view(), en, fn, wk, mu, T, mo));
+  mu_batch.add("dmu_deta", GradEtaHelper<SMEARING_TYPE>::dmu_deta_local(en, wk, mu, T, mo));
+  mu_batch.flush_async();
+
+  // gradient of the previous direction, in the representation of Z(n-1)
+  static_assert(std::is_same<zxp_t, to_layout_left_t<x_t>>::value &&
+                    std::is_same<zetap_t, to_layout_left_t<x_t>>::value,
+                "descent_direction::conjugated: Z(n-1) must be a direction returned by "
+                "restarted/conjugated");
+  using g_t = gradient_t<x_t>;
+  const g_t* g_prev = this->needs_gradient() ? this->get_gradient<g_t>() : nullptr;
+
+  descent_direction_impl<mem_t, SMEARING_TYPE, RESIDENT> functor(memspc,
+                                                                mu,
+                                                                T,
+                                                                kappa,
+                                                                mo,
+                                                                transfers,
+                                                                this->needs_gradient(),
+                                                                g_prev != nullptr,
+                                                                mirrors);
 
-  auto res = eval_threaded(tapply_async(functor, X, en, fn, hx, zxp, zetap, ul, S, P, wk));
+  // without a previous gradient Z(n-1) is passed as placeholder (not read)
+  const auto& gxp = g_prev ? g_prev->first : zxp;
+  const auto& getap = g_prev ? g_prev->second : zetap;
+  auto res = eval_threaded(
+      tapply_async(functor, X, en, fn, hx, zxp, zetap, ul, gxp, getap, S, P, wk));
 
   auto ures = unzip(res);
 
-  double fr = sum(std::get<0>(ures), commk);
+  double c =
+      GradEta<SMEARING_TYPE>::mu_coefficient(mu_batch.get("dmu_deta"), mu_batch.get("dFdmu"));
+  fr_k_ = this->with_mu_term(std::get<0>(ures), std::get<12>(ures), c);
+  reduction_batch fr_batch(commk);
+  fr_batch.add("fr", local_sum(fr_k_));
+  fr_batch.add("slope_zp", local_sum(std::get<5>(ures)));
+  fr_batch.add("fr_eta", local_sum(std::get<10>(ures)));
+  fr_batch.add("slope_zp_eta", local_sum(std::get<11>(ures)));
+  fr_batch.add("fr_mu", local_sum(std::get<12>(ures)));
+  fr_batch.add("slope_zp_mu", local_sum(std::get<13>(ures)));
+  if (g_prev) {
+    fr_batch.add("gp_delta", local_sum(std::get<8>(ures)));
+    fr_batch.add("gp_zp", local_sum(std::get<9>(ures)));
+  }
+  fr_batch.flush();
+  double fr = fr_batch.get("fr");
+  double slope_zp = fr_batch.get("slope_zp") + c * fr_batch.get("slope_zp_mu");
+  double gp_delta = g_prev ? fr_batch.get("gp_delta") : 0;
+  double gp_zp = g_prev ? fr_batch.get("gp_zp") : 0;
+  slope_zp_ = slope_zp;
+  slope_zp_eta_ = fr_batch.get("slope_zp_eta") + c * fr_batch.get("slope_zp_mu");
 
-  double gamma = fr / fr_old;
+  double gamma = 0;
+  if (warm_start_) {
+    gamma = fr_old != 0 ? std::sqrt(std::abs(fr / fr_old)) : 0;
+    warm_start_ = false;
+  } else if (!restart) {
+    gamma = this->beta(fr, fr_old, slope_zp, gp_delta, gp_zp, g_prev != nullptr);
+  }
+  beta_ = gamma;
+  if (this->needs_gradient()) {
+    this->add_mu_term(std::get<7>(ures), std::get<14>(ures), c);
+    this->set_gradient(g_t(std::get<6>(ures), std::get<7>(ures)));
+  }
 
-  Logger::GetInstance() << " CG gamma " << std::setprecision(3) << gamma << "\n";
+  NLCGLIB_LOG_DEBUG << " CG gamma " << std::setprecision(3) << gamma << "\n";
 
   auto delta_x = std::get<1>(ures);
   auto delta_eta = std::get<2>(ures);
 
   auto z_x = std::get<3>(ures);
   auto z_eta = std::get<4>(ures);
-  double slope_zp = sum(std::get<5>(ures), commk);
 
   /* this is tr{<Z|g>} = tr{<Δ + γ*Z(n-1)|g>} = tr{<Δ |g>} + γ * tr{<Z(n-1)|g>}
    *            ^                                   ^                  ^
    *          slope  =                             fr    + γ *     slope_zp
    */
   double slope = fr + gamma * slope_zp;
+  fr_eta_ = fr_batch.get("fr_eta") + c * fr_batch.get("fr_mu");
+  slope_eta_ = fr_eta_ + gamma * slope_zp_eta_;
 
   eval_threaded(
       // note: this operation is in-place and overwrite z_x, z_eta
@@ -143,7 +428,7 @@ descent_direction<SMEARING_TYPE>::conjugated(const mem_t& memspc,
   return std::make_tuple(fr, slope, z_x, z_eta);
 }
 
-template <enum smearing_type SMEARING_TYPE>
+template <enum smearing_type SMEARING_TYPE, bool RESIDENT>
 template <class mem_t,
           class x_t,
           class e_t,
@@ -153,7 +438,7 @@ template <class mem_t,
           class prec_t,
           class F>
 std::tuple<double, mvector<to_layout_left_t<x_t>>, mvector<to_layout_left_t<x_t>>>
-descent_direction<SMEARING_TYPE>::restarted(const mem_t& memspc,
+descent_direction<SMEARING_TYPE, RESIDENT>::restarted(const mem_t& memspc,
                                             const mvector<x_t>& X,
                                             const mvector<e_t>& en,
                                             const mvector<f_t>& fn,
@@ -164,22 +449,76 @@ descent_direction<SMEARING_TYPE>::restarted(const mem_t& memspc,
                                             prec_t&& P,
                                             F&& free_energy)
 {
-  double mo = free_energy.occupancy();
-  double dFdmu = GradEtaHelper<SMEARING_TYPE>::dFdmu(free_energy.get_ek(), en, fn, wk, mu, T, mo);
-  double sumfn = GradEtaHelper<SMEARING_TYPE>::dmu_deta(en, wk, mu, T, mo);
+  auto res = this->steepest(
+      memspc, X, en, fn, hx, wk, mu, S, P, free_energy, this->needs_gradient());
+  if (this->needs_gradient()) {
+    this->set_gradient(gradient_t<x_t>(std::get<3>(res), std::get<4>(res)));
+  }
+  return std::make_tuple(std::get<0>(res), std::get<1>(res), std::get<2>(res));
+}
 
+template <enum smearing_type SMEARING_TYPE, bool RESIDENT>
+template <class mem_t,
+          class x_t,
+          class e_t,
+          class f_t,
+          class hx_t,
+          class op_t,
+          class prec_t,
+          class F>
+std::tuple<double,
+           mvector<to_layout_left_t<x_t>>,
+           mvector<to_layout_left_t<x_t>>,
+           mvector<to_layout_left_t<x_t>>,
+           mvector<to_layout_left_t<x_t>>>
+descent_direction<SMEARING_TYPE, RESIDENT>::steepest(const mem_t& memspc,
+                                           const mvector<x_t>& X,
+                                           const mvector<e_t>& en,
+                                           const mvector<f_t>& fn,
+                                           const mvector<hx_t>& hx,
+                                           const mvector<double>& wk,
+                                           double mu,
+                                           op_t&& S,
+                                           prec_t&& P,
+                                           F&& free_energy,
+                                           bool with_gradient)
+{
+  NLCGLIB_PROFILE_REGION("descent direction");
+  double mo = free_energy.occupancy();
   auto commk = wk.commk();
 
-  descent_direction_impl<mem_t, SMEARING_TYPE> functor(memspc, mu, dFdmu, sumfn, T, kappa, mo);
+  /* always executed on CPU, the reduction is in flight while the directions are computed,
+   * its result enters through c * g_eta_mu, see descent_direction_impl */
+  reduction_batch mu_batch(commk);
+  mu_batch.add("dFdmu",
+               GradEtaHelper<SMEARING_TYPE>::dFdmu_local(
+                   free_energy.get_ek_view(), en, fn, wk, mu, T, mo));
+  mu_batch.add("dmu_deta", GradEtaHelper<SMEARING_TYPE>::dmu_deta_local(en, wk, mu, T, mo));
+  mu_batch.flush_async();
+
+  descent_direction_impl<mem_t, SMEARING_TYPE, RESIDENT> functor(
+      memspc, mu, T, kappa, mo, transfers, with_gradient, false, mirrors);
 
   auto res = eval_threaded(tapply_async(functor, X, en, fn, hx, S, P, wk));
   auto ures = unzip(res);
 
-  double fr = sum(std::get<0>(ures), commk);
-  auto z_x = std::get<1>(ures);
-  auto z_eta = std::get<2>(ures);
-
-  return std::make_tuple(fr, z_x, z_eta);
+  double c =
+      GradEta<SMEARING_TYPE>::mu_coefficient(mu_batch.get("dmu_deta"), mu_batch.get("dFdmu"));
+  fr_k_ = this->with_mu_term(std::get<0>(ures), std::get<6>(ures), c);
+  if (with_gradient) this->add_mu_term(std::get<4>(ures), std::get<7>(ures), c);
+  reduction_batch fr_batch(commk);
+  fr_batch.add("fr", local_sum(fr_k_));
+  fr_batch.add("fr_eta", local_sum(std::get<5>(ures)));
+  fr_batch.add("fr_mu", local_sum(std::get<6>(ures)));
+  fr_batch.flush();
+  double fr = fr_batch.get("fr");
+  fr_eta_ = fr_batch.get("fr_eta") + c * fr_batch.get("fr_mu");
+  slope_eta_ = fr_eta_;
+  slope_zp_ = 0;
+  slope_zp_eta_ = 0;
+  using z_t = mvector<to_layout_left_t<x_t>>;
+  return std::make_tuple(
+      fr, std::get<1>(ures), std::get<2>(ures), z_t(std::get<3>(ures)), z_t(std::get<4>(ures)));
 }
 
 
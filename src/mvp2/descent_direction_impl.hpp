@@ -6,23 +6,52 @@
 #include "mvp2.hpp"
 #include "pseudo_hamiltonian/grad_eta.hpp"
 #include "utils/logger.hpp"
+#include "utils/transfer_stats.hpp"
 
 
 namespace nlcglib {
 
-template <class memspace_t, enum smearing_type smearing_t>
+/**
+ * RESIDENT: X, Z(n-1), ul are expected in memspace and the directions are returned there,
+ * otherwise they are copied from/to the host. en, fn and HX are always copied.
+ * Copies are recorded in `transfers` (may be nullptr). The copy of X is shared through `mirrors`
+ * (may be nullptr) with the geodesic of the iteration, s.t. S X is reused, see exec_space_mirrors.
+ *
+ * with_gradient: the gradients (g_X, g_eta) are returned to the caller (otherwise empty).
+ * previous_gradient: the conjugated step transports the previous gradient G(n-1) like Z(n-1)
+ * and returns tr{<G(n-1)|Δ>} and tr{<G(n-1)|Z(n-1)>} (PR+/HS updates, Powell restart test),
+ * otherwise both are zero and G(n-1) is not read.
+ *
+ * The eta contributions to fr and to tr{<Z(n-1)|g>} are returned separately as well, they are
+ * used to adapt kappa, see adaptive_kappa.
+ *
+ * g_eta is evaluated without its chemical potential term c * g_eta_mu (see GradEta::g_eta_mu),
+ * s.t. the reduction of c = dFdmu / dmu_deta can run while the directions are computed. The
+ * contributions of g_eta_mu to fr and tr{<Z(n-1)|g>} (and g_eta_mu itself if with_gradient) are
+ * returned as the last elements of the tuples, the caller adds them scaled by c.
+ */
+template <class memspace_t, enum smearing_type smearing_t, bool RESIDENT = false>
 class descent_direction_impl
 {
 public:
-  descent_direction_impl(
-      const memspace_t& memspc, double mu, double dFdmu, double sumfn, double T, double kappa, double mo)
+  descent_direction_impl(const memspace_t& memspc,
+                         double mu,
+                         double T,
+                         double kappa,
+                         double mo,
+                         transfer_stats* transfers = nullptr,
+                         bool with_gradient = false,
+                         bool previous_gradient = false,
+                         exec_space_mirrors* mirrors = nullptr)
       : memspc(memspc)
       , mu(mu)
-      , dFdmu(dFdmu)
-      , sumfn(sumfn)
       , T(T)
       , kappa(kappa)
       , mo(mo)
+      , transfers(transfers)
+      , with_gradient(with_gradient)
+      , previous_gradient(previous_gradient)
+      , mirrors(mirrors)
   {
   }
 
@@ -34,6 +63,8 @@ public:
             class zxp_t,
             class zetap_t,
             class ul_t,
+            class gxp_t,
+            class getap_t,
             class op_t,
             class prec_t>
   auto operator()(x_t&& X,
@@ -43,6 +74,8 @@ public:
                   zxp_t&& zxp,
                   zetap_t&& zetap,
                   ul_t&& ul,
+                  gxp_t&& gxp,
+                  getap_t&& getap,
                   op_t&& S,
                   prec_t&& P,
                   double wk);
@@ -59,13 +92,24 @@ public:
             class prec_t,
             class zxp_t,
             class zetap_t,
-            class ul_t>
+            class ul_t,
+            class gxp_t,
+            class getap_t>
   std::tuple<double,
              to_layout_left_t<x_t>,
              to_layout_left_t<zetap_t>,
              to_layout_left_t<x_t>,
              to_layout_left_t<zetap_t>,
-             double>
+             double,
+             to_layout_left_t<x_t>,
+             to_layout_left_t<zetap_t>,
+             double,
+             double,
+             double,
+             double,
+             double,
+             double,
+             to_layout_left_t<zetap_t>>
   exec_spc(x_t&& x,
            e_t&& e,
            f_t&& f,
@@ -75,30 +119,50 @@ public:
            zxp_t&& zxp,
            zetap_t&& zetap,
            ul_t&& ul,
+           gxp_t&& gxp,
+           getap_t&& getap,
            double wk);
 
   /* CG conjugated direction gradients */
   template <class x_t, class sx_t, class zxp_t, class zetap_t, class ul_t, class gx_t, class geta_t>
-  std::tuple<double, to_layout_left_t<zxp_t>, to_layout_left_t<zetap_t>> exec_conjugate(
+  std::tuple<double, to_layout_left_t<zxp_t>, to_layout_left_t<zetap_t>, double> exec_conjugate(
       x_t&& x, sx_t&& sx, zxp_t&& zxp, zetap_t&& zetap, ul_t&& ul, gx_t&& gx, geta_t&& geta);
 
   /* CG restart gradients */
   template <class x_t, class e_t, class f_t, class hx_t, class op_t, class prec_t>
-  std::tuple<double, to_layout_left_t<x_t>, to_layout_left_t<x_t>> exec_spc(
-      x_t&& x, e_t&& e, f_t&& f, hx_t&& hx, op_t&& s, prec_t&& p, double wk);
+  std::tuple<double,
+             to_layout_left_t<x_t>,
+             to_layout_left_t<x_t>,
+             to_layout_left_t<x_t>,
+             to_layout_left_t<x_t>,
+             double,
+             double,
+             to_layout_left_t<x_t>>
+  exec_spc(x_t&& x, e_t&& e, f_t&& f, hx_t&& hx, op_t&& s, prec_t&& p, double wk);
 
 private:
+  /* copy of a gradient to the host (unless resident), empty without with_gradient */
+  template <class y_t>
+  auto gradient_from_exec_space(const y_t& y, const char* phase)
+  {
+    using result_t = decltype(from_exec_space<RESIDENT>(y, phase, transfers));
+    if (!with_gradient) return result_t{};
+    return from_exec_space<RESIDENT>(y, phase, transfers);
+  }
+
   memspace_t memspc;
   double mu;
-  double dFdmu;
-  double sumfn;
   double T;
   double kappa;
   double mo;
+  transfer_stats* transfers;
+  bool with_gradient;
+  bool previous_gradient;
+  exec_space_mirrors* mirrors;
 };
 
 
-template <class memspc_t, enum smearing_type smearing_t>
+template <class memspc_t, enum smearing_type smearing_t, bool RESIDENT>
 template <class x_t,
           class e_t,
           class f_t,
@@ -107,14 +171,25 @@ template <class x_t,
           class prec_t,
           class zxp_t,
           class zetap_t,
-          class ul_t>
+          class ul_t,
+          class gxp_t,
+          class getap_t>
 std::tuple<double,
            to_layout_left_t<x_t>,
            to_layout_left_t<zetap_t>,
            to_layout_left_t<x_t>,
            to_layout_left_t<zetap_t>,
-           double>
-descent_direction_impl<memspc_t, smearing_t>::exec_spc(x_t&& x,
+           double,
+           to_layout_left_t<x_t>,
+           to_layout_left_t<zetap_t>,
+           double,
+           double,
+           double,
+           double,
+           double,
+           double,
+           to_layout_left_t<zetap_t>>
+descent_direction_impl<memspc_t, smearing_t, RESIDENT>::exec_spc(x_t&& x,
                                                        e_t&& e,
                                                        f_t&& f,
                                                        hx_t&& hx,
@@ -123,37 +198,69 @@ descent_direction_impl<memspc_t, smearing_t>::exec_spc(x_t&& x,
                                                        zxp_t&& zxp,
                                                        zetap_t&& zetap,
                                                        ul_t&& ul,
+                                                       gxp_t&& gxp,
+                                                       getap_t&& getap,
                                                        double wk)
 {
+  // S X, P S X and P H X are computed exactly once and reused below
   auto sx = s(x);
-  auto llm = local::lmult()(x, sx, hx, p);
-  auto gx = local::gradx()(sx, hx, f, llm, wk);
-  auto delta_x = local::precondgx_us()(sx, hx, p, llm);
+  auto llm = local::lmult_us()(sx, hx, p);
+  auto gx = local::gradx()(sx, hx, f, std::get<0>(llm), wk);
+  auto delta_x = local::precondgx_us()(std::get<3>(llm), std::get<2>(llm), std::get<1>(llm));
   auto hij = inner_()(x, hx, wk);
-  // // std::cout << dFdmu << ", " << sumfn << "\n";
 
+  // g_eta without the chemical potential term, see g_eta_mu
   GradEta<smearing_t> grad_eta(this->T, this->kappa);
-  auto g_eta = grad_eta.g_eta(hij, mu, wk, e, f, this->sumfn, this->dFdmu, this->mo);
+  auto g_eta = grad_eta.g_eta(hij, mu, wk, e, f, 0, 0, this->mo);
+  auto g_eta_mu = grad_eta.g_eta_mu(hij, mu, wk, e, this->mo);
   auto delta_eta = _delta_eta(this->kappa)(hij, e, wk);
 
   double fr_x = 2 * innerh_tr()(gx, delta_x).real();
   double fr_eta = innerh_tr()(g_eta, delta_eta).real();
   double fr = fr_x + fr_eta;
+  double fr_mu = innerh_tr()(g_eta_mu, delta_eta).real();
 
   // CG contributions
   auto res_conj = this->exec_conjugate(x, sx, zxp, zetap, ul, gx, g_eta);
   double slope_zp = std::get<0>(res_conj);
   auto z_x = std::get<1>(res_conj);
   auto z_eta = std::get<2>(res_conj);
+  double slope_zp_eta = std::get<3>(res_conj);
+  double slope_zp_mu = innerh_tr()(z_eta, g_eta_mu).real();
+
+  // G(n-1), rotated and projected like Z(n-1)
+  double gp_delta{0};
+  double gp_zp{0};
+  if (previous_gradient) {
+    auto gx_tmp = local::rotatex()(gxp, ul);
+    auto gxp_rot = local::conjugatex()(gx_tmp, x, sx);
+    auto getap_rot = local::rotateeta()(getap, ul);
+    gp_delta = 2 * innerh_tr()(gxp_rot, delta_x).real() + innerh_tr()(getap_rot, delta_eta).real();
+    gp_zp = 2 * innerh_tr()(gxp_rot, z_x).real() + innerh_tr()(getap_rot, z_eta).real();
+  }
 
-  return std::make_tuple(fr, delta_x, delta_eta, z_x, z_eta, slope_zp);
+  return std::make_tuple(fr,
+                         delta_x,
+                         delta_eta,
+                         z_x,
+                         z_eta,
+                         slope_zp,
+                         gx,
+                         g_eta,
+                         gp_delta,
+                         gp_zp,
+                         fr_eta,
+                         slope_zp_eta,
+                         fr_mu,
+                         slope_zp_mu,
+                         g_eta_mu);
 }
 
 
-template <class memspc_t, enum smearing_type smearing_t>
+template <class memspc_t, enum smearing_type smearing_t, bool RESIDENT>
 template <class x_t, class sx_t, class zxp_t, class zetap_t, class ul_t, class gx_t, class geta_t>
-std::tuple<double, to_layout_left_t<zxp_t>, to_layout_left_t<zetap_t>>
-descent_direction_impl<memspc_t, smearing_t>::exec_conjugate(
+std::tuple<double, to_layout_left_t<zxp_t>, to_layout_left_t<zetap_t>, double>
+descent_direction_impl<memspc_t, smearing_t, RESIDENT>::exec_conjugate(
     x_t&& x, sx_t&& sx, zxp_t&& zxp, zetap_t&& zetap, ul_t&& ul, gx_t&& gx, geta_t&& geta)
 {
   auto zx_tmp = local::rotatex()(zxp, ul);
@@ -166,35 +273,44 @@ descent_direction_impl<memspc_t, smearing_t>::exec_conjugate(
   auto slope_eta_loc = innerh_tr()(zeta, geta).real();
   double slope_loc = slope_x_loc + slope_eta_loc;
 
-  return std::make_tuple(slope_loc, zx, zeta);
+  return std::make_tuple(slope_loc, zx, zeta, slope_eta_loc);
 }
 
 
-template <class memspc_t, enum smearing_type smearing_t>
+template <class memspc_t, enum smearing_type smearing_t, bool RESIDENT>
 template <class x_t, class e_t, class f_t, class hx_t, class op_t, class prec_t>
-std::tuple<double, to_layout_left_t<x_t>, to_layout_left_t<x_t>>
-descent_direction_impl<memspc_t, smearing_t>::exec_spc(
+std::tuple<double,
+           to_layout_left_t<x_t>,
+           to_layout_left_t<x_t>,
+           to_layout_left_t<x_t>,
+           to_layout_left_t<x_t>,
+           double,
+           double,
+           to_layout_left_t<x_t>>
+descent_direction_impl<memspc_t, smearing_t, RESIDENT>::exec_spc(
     x_t&& x, e_t&& e, f_t&& f, hx_t&& hx, op_t&& s, prec_t&& p, double wk)
 {
   auto sx = s(x);
-  auto llm = local::lmult()(x, sx, hx, p);
-  auto gx = local::gradx()(sx, hx, f, llm, wk);
-  auto delta_x = local::precondgx_us()(sx, hx, p, llm);
+  auto llm = local::lmult_us()(sx, hx, p);
+  auto gx = local::gradx()(sx, hx, f, std::get<0>(llm), wk);
+  auto delta_x = local::precondgx_us()(std::get<3>(llm), std::get<2>(llm), std::get<1>(llm));
   auto hij = inner_()(x, hx, wk);
 
   GradEta<smearing_t> grad_eta(this->T, this->kappa);
-  auto g_eta = grad_eta.g_eta(hij, mu, wk, e, f, this->sumfn, this->dFdmu, this->mo);
+  auto g_eta = grad_eta.g_eta(hij, mu, wk, e, f, 0, 0, this->mo);
+  auto g_eta_mu = grad_eta.g_eta_mu(hij, mu, wk, e, this->mo);
   auto delta_eta = _delta_eta(this->kappa)(hij, e, wk);
 
   double fr_x = 2 * innerh_tr()(gx, delta_x).real();
   double fr_eta = innerh_tr()(g_eta, delta_eta).real();
   double fr = fr_x + fr_eta;
+  double fr_mu = innerh_tr()(g_eta_mu, delta_eta).real();
 
-  return std::make_tuple(fr, delta_x, delta_eta);
+  return std::make_tuple(fr, delta_x, delta_eta, gx, g_eta, fr_eta, fr_mu, g_eta_mu);
 }
 
 
-template <class memspc_t, enum smearing_type smearing_t>
+template <class memspc_t, enum smearing_type smearing_t, bool RESIDENT>
 template <class x_t,
           class e_t,
           class f_t,
@@ -202,31 +318,40 @@ template <class x_t,
           class zxp_t,
           class zetap_t,
           class ul_t,
+          class gxp_t,
+          class getap_t,
           class op_t,
           class prec_t>
 auto
-descent_direction_impl<memspc_t, smearing_t>::operator()(x_t&& X_h,
+descent_direction_impl<memspc_t, smearing_t, RESIDENT>::operator()(x_t&& X_h,
                                                          e_t&& en_h,
                                                          f_t&& fn_h,
                                                          hx_t&& hx_h,
                                                          zxp_t&& zxp_h,
                                                          zetap_t&& zetap_h,
                                                          ul_t&& ul_h,
+                                                         gxp_t&& gxp_h,
+                                                         getap_t&& getap_h,
                                                          op_t&& S,
                                                          prec_t&& P,
                                                          double wk)
 {
-  auto X = create_mirror_view_and_copy(memspc, X_h);
-  auto en = Kokkos::create_mirror_view_and_copy(memspc, en_h);
-  auto fn = Kokkos::create_mirror_view_and_copy(memspc, fn_h);
-  auto HX = create_mirror_view_and_copy(memspc, hx_h);
+  const char* phase = "descent direction";
+  auto X = to_exec_space<RESIDENT>(memspc, X_h, phase, transfers, mirrors);
+  auto en = counted_mirror(memspc, en_h, phase, transfers);
+  auto fn = counted_mirror(memspc, fn_h, phase, transfers);
+  auto HX = counted_mirror(memspc, hx_h, phase, transfers);
 
   // previous search directions
-  auto ZXp = create_mirror_view_and_copy(memspc, zxp_h);
-  auto Zetap = create_mirror_view_and_copy(memspc, zetap_h);
-  auto ul = create_mirror_view_and_copy(memspc, ul_h);
+  auto ZXp = to_exec_space<RESIDENT>(memspc, zxp_h, phase, transfers);
+  auto Zetap = to_exec_space<RESIDENT>(memspc, zetap_h, phase, transfers);
+  auto ul = to_exec_space<RESIDENT>(memspc, ul_h, phase, transfers);
+  // previous gradients, placeholders (not read) without previous_gradient
+  auto gxp = previous_gradient ? to_exec_space<RESIDENT>(memspc, gxp_h, phase, transfers) : ZXp;
+  auto getap =
+      previous_gradient ? to_exec_space<RESIDENT>(memspc, getap_h, phase, transfers) : Zetap;
 
-  auto res = this->exec_spc(X, en, fn, HX, S, P, ZXp, Zetap, ul, wk);
+  auto res = this->exec_spc(X, en, fn, HX, S, P, ZXp, Zetap, ul, gxp, getap, wk);
 
   // steepest descent vars
   double fr = std::get<0>(res);
@@ -238,28 +363,49 @@ descent_direction_impl<memspc_t, smearing_t>::operator()(x_t&& X_h,
   auto z_eta = std::get<4>(res);
   double slope_zp = std::get<5>(res);
 
-  // copy Δ to host
-  auto delta_x_h = create_mirror_view_and_copy(Kokkos::HostSpace(), delta_x);
-  auto delta_eta_h = create_mirror_view_and_copy(Kokkos::HostSpace(), delta_eta);
-
-  // copy Z to host
-  auto z_x_h = create_mirror_view_and_copy(Kokkos::HostSpace(), z_x);
-  auto z_eta_h = create_mirror_view_and_copy(Kokkos::HostSpace(), z_eta);
-
-  /// return slopes and Δ, Z (host memeory)
-  return std::make_tuple(fr, delta_x_h, delta_eta_h, z_x_h, z_eta_h, slope_zp);
+  // copy Δ, Z to host (unless resident)
+  auto delta_x_h = from_exec_space<RESIDENT>(delta_x, phase, transfers);
+  auto delta_eta_h = from_exec_space<RESIDENT>(delta_eta, phase, transfers);
+  auto z_x_h = from_exec_space<RESIDENT>(z_x, phase, transfers);
+  auto z_eta_h = from_exec_space<RESIDENT>(z_eta, phase, transfers);
+  auto g_x_h = this->gradient_from_exec_space(std::get<6>(res), phase);
+  auto g_eta_h = this->gradient_from_exec_space(std::get<7>(res), phase);
+  double gp_delta = std::get<8>(res);
+  double gp_zp = std::get<9>(res);
+  double fr_eta = std::get<10>(res);
+  double slope_zp_eta = std::get<11>(res);
+  double fr_mu = std::get<12>(res);
+  double slope_zp_mu = std::get<13>(res);
+  auto g_eta_mu_h = this->gradient_from_exec_space(std::get<14>(res), phase);
+
+  return std::make_tuple(fr,
+                         delta_x_h,
+                         delta_eta_h,
+                         z_x_h,
+                         z_eta_h,
+                         slope_zp,
+                         g_x_h,
+                         g_eta_h,
+                         gp_delta,
+                         gp_zp,
+                         fr_eta,
+                         slope_zp_eta,
+                         fr_mu,
+                         slope_zp_mu,
+                         g_eta_mu_h);
 }
 
-template <class memspc_t, enum smearing_type smearing_t>
+template <class memspc_t, enum smearing_type smearing_t, bool RESIDENT>
 template <class x_t, class e_t, class f_t, class hx_t, class op_t, class prec_t>
 auto
-descent_direction_impl<memspc_t, smearing_t>::operator()(
+descent_direction_impl<memspc_t, smearing_t, RESIDENT>::operator()(
     x_t&& X_h, e_t&& en_h, f_t&& fn_h, hx_t&& hx_h, op_t&& S, prec_t&& P, double wk)
 {
-  auto X = create_mirror_view_and_copy(memspc, X_h);
-  auto en = Kokkos::create_mirror_view_and_copy(memspc, en_h);
-  auto fn = Kokkos::create_mirror_view_and_copy(memspc, fn_h);
-  auto HX = create_mirror_view_and_copy(memspc, hx_h);
+  const char* phase = "descent direction";
+  auto X = to_exec_space<RESIDENT>(memspc, X_h, phase, transfers, mirrors);
+  auto en = counted_mirror(memspc, en_h, phase, transfers);
+  auto fn = counted_mirror(memspc, fn_h, phase, transfers);
+  auto HX = counted_mirror(memspc, hx_h, phase, transfers);
 
   auto res = this->exec_spc(X, en, fn, HX, S, P, wk);
 
@@ -268,12 +414,16 @@ descent_direction_impl<memspc_t, smearing_t>::operator()(
   auto delta_x = std::get<1>(res);
   auto delta_eta = std::get<2>(res);
 
-  // copy Δ to host
-  auto delta_x_h = create_mirror_view_and_copy(Kokkos::HostSpace(), delta_x);
-  auto delta_eta_h = create_mirror_view_and_copy(Kokkos::HostSpace(), delta_eta);
+  // copy Δ to host (unless resident)
+  auto delta_x_h = from_exec_space<RESIDENT>(delta_x, phase, transfers);
+  auto delta_eta_h = from_exec_space<RESIDENT>(delta_eta, phase, transfers);
+  auto g_x_h = this->gradient_from_exec_space(std::get<3>(res), phase);
+  auto g_eta_h = this->gradient_from_exec_space(std::get<4>(res), phase);
+  double fr_eta = std::get<5>(res);
+  double fr_mu = std::get<6>(res);
+  auto g_eta_mu_h = this->gradient_from_exec_space(std::get<7>(res), phase);
 
-  /// return slopes and Δ, Z (host memeory)
-  return std::make_tuple(fr, delta_x_h, delta_eta_h);
+  return std::make_tuple(fr, delta_x_h, delta_eta_h, g_x_h, g_eta_h, fr_eta, fr_mu, g_eta_mu_h);
 }
 
 }  // namespace nlcglib
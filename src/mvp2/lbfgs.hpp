@@ -0,0 +1,406 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <iomanip>
+#include <tuple>
+#include <vector>
+#include "la/lapack.hpp"
+#include "la/mvector.hpp"
+#include "la/utils.hpp"
+#include "mpi/communicator.hpp"
+#include "mvp2.hpp"
+#include "utils/logger.hpp"
+#include "utils/profiler.hpp"
+
+namespace nlcglib {
+
+/**
+ * Inner products of the L-BFGS history, pairs k = 0 (oldest) ... n-1 (newest), with the
+ * gradient g and Δ = -P g. All of them are reduced with a single allreduce.
+ */
+struct lbfgs_gram
+{
+  explicit lbfgs_gram(int n)
+      : n(n)
+      , values(2 * n * n + 3 * n, 0)
+  {
+  }
+
+  /// <s_k, y_l>
+  double& sy(int k, int l) { return values[k * n + l]; }
+  /// <y_k, P y_l>
+  double& ypy(int k, int l) { return values[n * n + k * n + l]; }
+  /// <s_k, g>
+  double& sg(int k) { return values[2 * n * n + k]; }
+  /// <y_k, Δ>
+  double& yd(int k) { return values[2 * n * n + n + k]; }
+  /// <g, P y_k>
+  double& gpy(int k) { return values[2 * n * n + 2 * n + k]; }
+
+  int n;
+  std::vector<double> values;
+};
+
+/// d = gamma * Δ + sum_k (a_k * P y_k + b_k * s_k), slope = <g, d>
+struct lbfgs_coefficients
+{
+  double gamma{1};
+  std::vector<double> a;
+  std::vector<double> b;
+  double slope{0};
+};
+
+/**
+ * Two-loop recursion in terms of the inner products, H0 = gamma * P with
+ * gamma = <s, y> / <y, P y> of the newest pair. fr = <g, Δ>.
+ * Pairs with <s_k, y_k> <= 0 (after transport) do not contribute.
+ */
+inline lbfgs_coefficients
+lbfgs_two_loop(lbfgs_gram& gram, double fr)
+{
+  int n = gram.n;
+  lbfgs_coefficients c;
+  c.a.resize(n, 0);
+  c.b.resize(n, 0);
+  std::vector<double> rho(n, 0);
+  std::vector<double> alpha(n, 0);
+  for (int k = 0; k < n; ++k) {
+    if (gram.sy(k, k) > 0) rho[k] = 1 / gram.sy(k, k);
+  }
+
+  // q_k = g - sum_{l > k} alpha_l y_l, alpha_k = rho_k <s_k, q_k>
+  for (int k = n - 1; k >= 0; --k) {
+    double sq = gram.sg(k);
+    for (int l = k + 1; l < n; ++l) sq -= alpha[l] * gram.sy(k, l);
+    alpha[k] = rho[k] * sq;
+  }
+  if (n > 0 && gram.sy(n - 1, n - 1) > 0 && gram.ypy(n - 1, n - 1) > 0) {
+    c.gamma = gram.sy(n - 1, n - 1) / gram.ypy(n - 1, n - 1);
+  }
+
+  // r_k = -gamma (Δ + sum_l alpha_l P y_l) + sum_{l < k} (alpha_l - beta_l) s_l,
+  // beta_k = rho_k <y_k, r_k>, d = -r_n
+  for (int k = 0; k < n; ++k) {
+    double yr = -gram.yd(k);
+    for (int l = 0; l < n; ++l) yr -= alpha[l] * gram.ypy(k, l);
+    yr *= c.gamma;
+    for (int l = 0; l < k; ++l) yr -= c.b[l] * gram.sy(l, k);
+    c.b[k] = rho[k] * yr - alpha[k];
+  }
+
+  c.slope = c.gamma * fr;
+  for (int k = 0; k < n; ++k) {
+    c.a[k] = c.gamma * alpha[k];
+    c.slope += c.a[k] * gram.gpy(k) + c.b[k] * gram.sg(k);
+  }
+  return c;
+}
+
+/**
+ * Limited-memory BFGS directions on the (X, eta) manifold.
+ *
+ * Tangent vectors v = (v_X, v_eta) and the inner product of the CG slope,
+ *   <a, b> = sum_k 2 Re tr(a_X^H b_X) + Re tr(a_eta^H b_eta).
+ * The initial inverse Hessian is the preconditioner, P g = -Δ. P is only known through Δ, hence
+ * P y = Δ(n-1) - Δ(n) is formed from the preconditioned gradients of consecutive iterates.
+ *
+ * After a step, the pairs (s, y, P y) and the last direction and gradients are transported to
+ * the new iterate like the CG direction: rotated by the eigenvectors ul of eta and
+ * S-orthogonalized to X.
+ *
+ * Each k-point keeps its own buffers: the X and eta parts of the m slots and of (d, g, Δ) of the
+ * last iterate. Buffers are reused, y and P y are formed in place from the transported g, Δ.
+ */
+template <class vector_t>
+class lbfgs_direction
+{
+public:
+  using z_t = mvector<vector_t>;
+
+  /// m: number of stored pairs
+  explicit lbfgs_direction(int m)
+      : m_(std::max(m, 1))
+      , step_(m_, 0)
+  {
+  }
+
+  /// search direction at the current iterate, returns (<g, d>, d_X, d_eta)
+  std::tuple<double, z_t, z_t> direction(double fr,
+                                         const z_t& g_x,
+                                         const z_t& g_eta,
+                                         const z_t& delta_x,
+                                         const z_t& delta_eta);
+
+  /// transport the history to X(t), ul: eigenvectors of eta(t)
+  template <class x_t, class ul_t, class op_t>
+  void transport(const mvector<x_t>& X, const mvector<ul_t>& ul, op_t&& S);
+
+  /// add the pair of the last step, t: accepted step length, g, Δ: at the new iterate
+  /// returns false if the pair was dropped (<s, y> <= 0)
+  bool update(double t,
+              const z_t& g_x,
+              const z_t& g_eta,
+              const z_t& delta_x,
+              const z_t& delta_eta);
+
+  /// drop all pairs, the next direction is steepest descent
+  void clear();
+
+  int capacity() const { return m_; }
+  int size() const { return static_cast<int>(order_.size()); }
+
+  /// pairs dropped by the curvature condition / histories dropped for an ascent direction
+  int num_skipped() const { return num_skipped_; }
+  int num_resets() const { return num_resets_; }
+
+private:
+  struct buffers
+  {
+    std::vector<vector_t> x;
+    std::vector<vector_t> eta;
+  };
+
+  /// position of s, y, P y of slot j and of the last d, g, Δ in buffers
+  static int s_pos(int j) { return 3 * j; }
+  static int y_pos(int j) { return 3 * j + 1; }
+  static int py_pos(int j) { return 3 * j + 2; }
+  int d_pos() const { return 3 * m_; }
+  int g_pos() const { return 3 * m_ + 1; }
+  int delta_pos() const { return 3 * m_ + 2; }
+
+  /// positions of the transported vectors
+  std::vector<int> active() const;
+
+  static double inner(const vector_t& a_x,
+                      const vector_t& a_eta,
+                      const vector_t& b_x,
+                      const vector_t& b_eta)
+  {
+    return 2 * innerh_tr()(a_x, b_x).real() + innerh_tr()(a_eta, b_eta).real();
+  }
+
+  int m_;
+  /// slots ordered oldest to newest
+  std::deque<int> order_;
+  /// s = step * d
+  std::vector<double> step_;
+  bool has_last_{false};
+  int num_skipped_{0};
+  int num_resets_{0};
+  mvector<buffers> buffers_;
+};
+
+template <class vector_t>
+std::vector<int>
+lbfgs_direction<vector_t>::active() const
+{
+  std::vector<int> pos;
+  for (int j : order_) {
+    pos.push_back(s_pos(j));
+    pos.push_back(y_pos(j));
+    pos.push_back(py_pos(j));
+  }
+  if (has_last_) {
+    pos.push_back(d_pos());
+    pos.push_back(g_pos());
+    pos.push_back(delta_pos());
+  }
+  return pos;
+}
+
+template <class vector_t>
+void
+lbfgs_direction<vector_t>::clear()
+{
+  order_.clear();
+  has_last_ = false;
+  for (auto& elem : buffers_) {
+    // release the memory
+    std::fill(elem.second.x.begin(), elem.second.x.end(), vector_t());
+    std::fill(elem.second.eta.begin(), elem.second.eta.end(), vector_t());
+  }
+}
+
+template <class vector_t>
+std::tuple<double, typename lbfgs_direction<vector_t>::z_t, typename lbfgs_direction<vector_t>::z_t>
+lbfgs_direction<vector_t>::direction(double fr,
+                                     const z_t& g_x,
+                                     const z_t& g_eta,
+                                     const z_t& delta_x,
+                                     const z_t& delta_eta)
+{
+  NLCGLIB_PROFILE_REGION("lbfgs direction");
+  if (buffers_.size() != g_x.size()) {
+    buffers_ = mvector<buffers>(g_x.commk(), g_x.index());
+    for (auto& elem : buffers_) {
+      elem.second.x.resize(3 * m_ + 3);
+      elem.second.eta.resize(3 * m_ + 3);
+    }
+    order_.clear();
+    has_last_ = false;
+  }
+
+  int n = this->size();
+  lbfgs_coefficients c;
+  c.slope = fr;
+  if (n > 0) {
+    std::vector<int> order(order_.begin(), order_.end());
+    std::vector<double> step = step_;
+    auto gram_k = eval_threaded(tapply_async(
+        [n, order, step](buffers b, auto gx, auto geta, auto dx, auto deta) {
+          lbfgs_gram gram(n);
+          for (int k = 0; k < n; ++k) {
+            int jk = order[k];
+            const auto& s_x = b.x[s_pos(jk)];
+            const auto& s_eta = b.eta[s_pos(jk)];
+            const auto& y_x = b.x[y_pos(jk)];
+            const auto& y_eta = b.eta[y_pos(jk)];
+            for (int l = 0; l < n; ++l) {
+              int jl = order[l];
+              gram.sy(k, l) = step[jk] * inner(s_x, s_eta, b.x[y_pos(jl)], b.eta[y_pos(jl)]);
+              gram.ypy(k, l) = inner(y_x, y_eta, b.x[py_pos(jl)], b.eta[py_pos(jl)]);
+            }
+            gram.sg(k) = step[jk] * inner(s_x, s_eta, gx, geta);
+            gram.yd(k) = inner(y_x, y_eta, dx, deta);
+            gram.gpy(k) = inner(gx, geta, b.x[py_pos(jk)], b.eta[py_pos(jk)]);
+          }
+          return gram.values;
+        },
+        buffers_, g_x, g_eta, delta_x, delta_eta));
+
+    lbfgs_gram gram(n);
+    for (auto& elem : gram_k) {
+      for (std::size_t i = 0; i < gram.values.size(); ++i) gram.values[i] += elem.second[i];
+    }
+    g_x.commk().allreduce(gram.values.data(), gram.values.size(), mpi_op::sum);
+    c = lbfgs_two_loop(gram, fr);
+
+    if (!(c.slope < 0)) {
+      // not a descent direction (e.g. the pairs no longer fit after a large step)
+      NLCGLIB_LOG_INFO << "L-BFGS: <g, d> = " << std::scientific << std::setprecision(3) << c.slope
+                       << " >= 0, history dropped\n";
+      num_resets_++;
+      this->clear();
+      n = 0;
+      c = lbfgs_coefficients();
+      c.slope = fr;
+    }
+  }
+
+  // d = gamma * Δ + sum_k (a_k * P y_k + b_k * step_k * s_k)
+  std::vector<int> order(order_.begin(), order_.end());
+  std::vector<double> step = step_;
+  auto d = eval_threaded(tapply_async(
+      [n, order, step, c](buffers b, auto dx, auto deta) {
+        auto d_x = copy(dx);
+        auto d_eta = copy(deta);
+        if (c.gamma != 1) {
+          add(d_x, dx, c.gamma - 1);
+          add(d_eta, deta, c.gamma - 1);
+        }
+        for (int k = 0; k < n; ++k) {
+          int j = order[k];
+          add(d_x, b.x[py_pos(j)], c.a[k]);
+          add(d_eta, b.eta[py_pos(j)], c.a[k]);
+          add(d_x, b.x[s_pos(j)], c.b[k] * step[j]);
+          add(d_eta, b.eta[s_pos(j)], c.b[k] * step[j]);
+        }
+        return std::make_tuple(vector_t(d_x), vector_t(d_eta));
+      },
+      buffers_, delta_x, delta_eta));
+  auto ud = unzip(d);
+  z_t d_x = std::get<0>(ud);
+  z_t d_eta = std::get<1>(ud);
+
+  // d, g, Δ of this iterate form the next pair
+  for (std::size_t i = 0; i < buffers_.size(); ++i) {
+    auto key = buffers_.key(i);
+    auto& b = buffers_.value(i);
+    b.x[d_pos()] = d_x.at(key);
+    b.eta[d_pos()] = d_eta.at(key);
+    b.x[g_pos()] = g_x.at(key);
+    b.eta[g_pos()] = g_eta.at(key);
+    b.x[delta_pos()] = delta_x.at(key);
+    b.eta[delta_pos()] = delta_eta.at(key);
+  }
+  has_last_ = true;
+
+  return std::make_tuple(c.slope, d_x, d_eta);
+}
+
+template <class vector_t>
+template <class x_t, class ul_t, class op_t>
+void
+lbfgs_direction<vector_t>::transport(const mvector<x_t>& X, const mvector<ul_t>& ul, op_t&& S)
+{
+  NLCGLIB_PROFILE_REGION("lbfgs transport");
+  auto pos = this->active();
+  if (pos.empty()) return;
+  buffers_ = eval_threaded(tapply_async(
+      [pos](buffers b, auto x, auto u, auto s) {
+        // S X is shared by all vectors of the k-point
+        auto sx = s(x);
+        for (int p : pos) {
+          auto zx = local::rotatex()(b.x[p], u);
+          b.x[p] = local::conjugatex()(zx, x, sx);
+          b.eta[p] = local::rotateeta()(b.eta[p], u);
+        }
+        return b;
+      },
+      buffers_, X, ul, S));
+}
+
+template <class vector_t>
+bool
+lbfgs_direction<vector_t>::update(
+    double t, const z_t& g_x, const z_t& g_eta, const z_t& delta_x, const z_t& delta_eta)
+{
+  if (!has_last_) return false;
+  has_last_ = false;
+
+  // y = g - G(n-1), P y = Δ(n-1) - Δ, in place in the (transported) buffers of G(n-1), Δ(n-1)
+  int d = d_pos();
+  int g = g_pos();
+  int delta = delta_pos();
+  auto sy_k = eval_threaded(tapply_async(
+      [t, d, g, delta](buffers b, auto gx, auto geta, auto dx, auto deta) {
+        add(b.x[g], gx, 1.0, -1.0);
+        add(b.eta[g], geta, 1.0, -1.0);
+        add(b.x[delta], dx, -1.0);
+        add(b.eta[delta], deta, -1.0);
+        return t * inner(b.x[d], b.eta[d], b.x[g], b.eta[g]);
+      },
+      buffers_, g_x, g_eta, delta_x, delta_eta));
+  double sy = sum(sy_k, g_x.commk());
+
+  // curvature condition, the line search does not enforce it
+  bool accept = t > 0 && sy > 0;
+  int j = order_.empty() ? 0 : (order_.back() + 1) % m_;
+  if (accept) {
+    if (this->size() == m_) order_.pop_front();
+    order_.push_back(j);
+    step_[j] = t;
+  } else {
+    num_skipped_++;
+    NLCGLIB_LOG_DEBUG << "L-BFGS: <s, y> = " << std::scientific << std::setprecision(3) << sy
+                      << ", pair skipped\n";
+  }
+
+  for (auto& elem : buffers_) {
+    auto& b = elem.second;
+    if (accept) {
+      b.x[s_pos(j)] = b.x[d];
+      b.eta[s_pos(j)] = b.eta[d];
+      b.x[y_pos(j)] = b.x[g];
+      b.eta[y_pos(j)] = b.eta[g];
+      b.x[py_pos(j)] = b.x[delta];
+      b.eta[py_pos(j)] = b.eta[delta];
+    }
+    b.x[d] = b.x[g] = b.x[delta] = vector_t();
+    b.eta[d] = b.eta[g] = b.eta[delta] = vector_t();
+  }
+  return accept;
+}
+
+}  // namespace nlcglib
@@ -1,31 +1,38 @@
 #pragma once
 
 #include <Kokkos_Complex.hpp>
+#include "la/expr.hpp"
 #include "la/lapack.hpp"
 #include "la/utils.hpp"
 #include "mpi/communicator.hpp"
+#include "mpi/reduction_batch.hpp"
 
 namespace nlcglib {
 
 namespace local {
 
-struct lmult
+/**
+ * Lagrange multipliers for the ultrasoft case.
+ *
+ * Returns (SX Λ, Λ, P SX, P HX), the preconditioned products are kept so that
+ * the descent direction can be formed without applying P a second time.
+ */
+struct lmult_us
 {
-  template<class x_t, class sx_t, class hx_t, class prec_t>
-  to_layout_left_t<std::remove_reference_t<x_t>>
-  operator()(x_t&& x, sx_t&& sx, hx_t&& hx, prec_t&& prec)
+  template <class sx_t, class hx_t, class prec_t>
+  auto operator()(sx_t&& sx, hx_t&& hx, prec_t&& prec)
   {
-    // TODO x is not used
-    // Lagrange multipliers
-    // compute ll = (xkx)^{-1} @ xKhx
-    auto xkx = inner_()(sx, prec(sx));
-    auto xkhx = inner_()(sx, prec(hx));
-    // auto khx = prec(hx);
-    solve_sym(xkx, xkhx);
-    auto ll = xkhx;
-    // X @ ll
+    // single (batched) preconditioner call for both blocks
+    auto psx_phx = prec(sx, hx);
+    auto psx = std::get<0>(psx_phx);
+    auto phx = std::get<1>(psx_phx);
+    // Λ = (SX^H P SX)^{-1} SX^H P HX
+    auto xkx = inner_()(sx, psx);
+    auto ll = inner_()(sx, phx);
+    solve_sym(xkx, ll, sx.map().comm());
+    // SX @ Λ
     auto xll = transform_alloc(sx, ll);
-    return xll;
+    return std::make_tuple(xll, ll, psx, phx);
   }
 };
 
@@ -36,8 +43,9 @@ struct gradx
   operator()(x_t&& x, hx_t&& hx, fn_t&& fn, ll_t&& xll, wk_t&& wk)
   {
     auto g_x = empty_like()(x);
-    scale(g_x, hx, fn, wk);
-    add(g_x, eval(xll), -wk);
+    double alpha = wk;
+    // g_x <- wk * HX diag(fn) - wk * X Λ, single pass
+    assign(g_x, alpha * expr::col_scale(expr::ref(hx), fn) - alpha * expr::ref(eval(xll)));
     return g_x;
   }
 };
@@ -49,11 +57,9 @@ struct precondgx
   to_layout_left_t<std::remove_reference_t<x_t>>
   operator()(x_t&& x, hx_t&& hx, prec_t&& prec, ll_t&& xll)
   {
-    auto delta_x = zeros_like()(x);
-    // delta_x <- -hx
-    add(delta_x, hx, -1.0, 0);
-    // delta_x <- += X @ ll
-    add(delta_x, eval(xll), 1.0);
+    auto delta_x = empty_like()(x);
+    // delta_x <- X @ ll - hx
+    assign(delta_x, expr::ref(eval(xll)) - expr::ref(hx));
     prec.apply_in_place(delta_x);
     return delta_x;
   }
@@ -61,19 +67,19 @@ struct precondgx
 
 struct precondgx_us
 {
-  // TODO: unused variable x!
-  template <class x_t, class hx_t, class prec_t, class ll_t>
-  to_layout_left_t<std::remove_reference_t<x_t>> operator()(x_t&& x,
-                                                            hx_t&& hx,
-                                                            prec_t&& prec,
-                                                            ll_t&& xll)
+  /**
+   * Uses linearity of P: P(-HX + SX Λ) = -P HX + (P SX) Λ.
+   * phx and psx are not modified (they may be cached results of P).
+   */
+  template <class phx_t, class psx_t, class ll_t>
+  to_layout_left_t<std::remove_reference_t<phx_t>> operator()(phx_t&& phx,
+                                                              psx_t&& psx,
+                                                              ll_t&& ll)
   {
-    auto delta_x = zeros_like()(x);
-    // delta_x <- -hx
-    add(delta_x, hx, -1.0, 0);
-    // delta_x <- += X @ ll
-    add(delta_x, eval(xll), 1.0);
-    return prec(delta_x);
+    // delta_x <- P SX @ Λ - P HX
+    to_layout_left_t<std::remove_reference_t<phx_t>> delta_x = transform_alloc(psx, eval(ll));
+    add(delta_x, phx, -1.0);
+    return delta_x;
   }
 };
 
@@ -160,7 +166,7 @@ public:
     auto sx_zxp = inner_()(sx, zxp);
     // ll = (SX⊹ SX)⁻¹ (SX ⊹ ZXP)
     auto sx2 = inner_()(sx, sx);
-    solve_sym(sx2, sx_zxp);
+    solve_sym(sx2, sx_zxp, sx.map().comm());
     auto ll = sx_zxp;
     // corr = SX ll
     auto corr = transform_alloc(sx, ll);
@@ -194,14 +200,6 @@ struct conjugateeta
 
 }  // local
 
-/// Lagrange multipliers
-template <class X_t, class SX_t, class Hx_t, class Prec_t>
-auto
-lagrange_multipliers(const X_t& X, const SX_t& SX, const Hx_t& Hx, const Prec_t& Prec)
-{
-  return tapply_async(local::lmult(), X, SX, Hx, Prec);
-}
-
 /// gradient
 template <class X_t, class Hx_t, class fn_t, class ll_t, class wk_t>
 auto gradX(const X_t& X, const Hx_t& Hx, const fn_t& fn, const ll_t& Xll, const wk_t& wk)
@@ -216,14 +214,6 @@ auto precondGradX(const X_t& X, const Hx_t& Hx, const Prec_t& Prec, const ll_t&
   return tapply_async(local::precondgx(), X, Hx, Prec, Xll);
 }
 
-template <class SX_t, class Hx_t, class Prec_t, class ll_t>
-auto
-precondGradX_us(const SX_t& SX, const Hx_t& Hx, const Prec_t& Prec, const ll_t& Xll)
-{
-  // TODO: precondgx only differs in signature of the preconditioner application
-  return tapply_async(local::precondgx_us(), SX, Hx, Prec, Xll);
-}
-
 
 /// apply subspace rotation on X
 template<class X_t, class U_t>
@@ -243,8 +233,12 @@ template <class gx_t, class zx_t, class ge_t, class ze_t>
 std::tuple<double, double>
 compute_slope(const gx_t& gx, const zx_t& zx, const ge_t& geta, ze_t& zeta, const Communicator& commk)
 {
-  double slope_x = sum(eval_threaded(tapply(local::slope_x(), gx, zx)), commk) .real();
-  double slope_eta = sum(eval_threaded(tapply(local::slope_eta(), geta, zeta)), commk).real();
+  reduction_batch batch(commk);
+  batch.add("slope_x", local_sum(eval_threaded(tapply(local::slope_x(), gx, zx))));
+  batch.add("slope_eta", local_sum(eval_threaded(tapply(local::slope_eta(), geta, zeta))));
+  batch.flush();
+  double slope_x = batch.get_complex("slope_x").real();
+  double slope_eta = batch.get_complex("slope_eta").real();
   return std::make_tuple(slope_x, slope_eta);
 }
 
@@ -253,8 +247,8 @@ double
 compute_slope_single(
     const gx_t& gx, const zx_t& zx, const ge_t& geta, ze_t& zeta, const Communicator& commk)
 {
-  double slope_x = sum(eval_threaded(tapply(local::slope_x(), gx, zx)), commk).real();
-  double slope_eta = sum(eval_threaded(tapply(local::slope_eta(), geta, zeta)), commk).real();
+  double slope_x, slope_eta;
+  std::tie(slope_x, slope_eta) = compute_slope(gx, zx, geta, zeta, commk);
   return slope_x + slope_eta;
 }
 
@@ -4,6 +4,7 @@
 #include <iomanip>
 #include <ios>
 #include <iostream>
+#include <mutex>
 #include <nlcglib.hpp>
 #include <set>
 #include "exec_space.hpp"
@@ -18,31 +19,56 @@
 #include "linesearch/linesearch.hpp"
 #include "overlap.hpp"
 #include "preconditioner.hpp"
+#include "session.hpp"
 #include "pseudo_hamiltonian/grad_eta.hpp"
 #include "smearing.hpp"
 #include "traits.hpp"
 #include "ultrasoft_precond.hpp"
 #include "utils/format.hpp"
 #include "utils/logger.hpp"
+#include "utils/numa.hpp"
+#include "utils/profiler.hpp"
+#include "utils/async_writer.hpp"
+#include "utils/env.hpp"
 #include "utils/step_logger.hpp"
 #include "utils/timer.hpp"
+#include "utils/thread_budget.hpp"
+#include "utils/transfer_stats.hpp"
 #include "mvp2/descent_direction.hpp"
+#include "mvp2/lbfgs.hpp"
+#include "pseudo_hamiltonian/adaptive_kappa.hpp"
 #include <cstdio>
 
 typedef std::complex<double> complex_double;
 
 namespace nlcglib {
 
+namespace {
+
+/// initialize() calls without a matching finalize(), owns_kokkos: Kokkos was initialized by us
+std::mutex init_mutex;
+int init_count{0};
+bool owns_kokkos{false};
+
+}  // namespace
+
 void initialize()
 {
+  std::lock_guard<std::mutex> lock(init_mutex);
+  if (init_count++ > 0) return;
+  if (Kokkos::is_initialized()) return;
   Kokkos::InitArguments args;
   args.num_threads = omp_get_max_threads();
   Kokkos::initialize(args);
+  owns_kokkos = true;
 }
 
 void finalize()
 {
-  Kokkos::finalize();
+  std::lock_guard<std::mutex> lock(init_mutex);
+  if (init_count == 0 || --init_count > 0) return;
+  if (owns_kokkos) Kokkos::finalize();
+  owns_kokkos = false;
 }
 
 auto
@@ -80,40 +106,31 @@ cg_write_step_json(double free_energy,
                    double slope_x,
                    double slope_eta,
                    double efermi,
+                   double kappa,
                    T1&& ek,
                    T2&& fn,
                    std::map<std::string, double> energy_components,
                    Communicator& commk,
-                   int step)
+                   async_record_writer* writer,
+                   int step,
+                   int run = 0)
 {
-  StepLogger logger(step, "nlcg.json", commk.rank() == 0);
+  // writer is only set on rank 0 of commk
+  StepLogger logger(step, writer);
+  logger.log("run", run);
   logger.log("F", free_energy);
   logger.log("EKS", ks_energy);
   logger.log("entropy", entropy);
   logger.log("slope_x", slope_x);
   logger.log("slope_eta", slope_eta);
   logger.log("fermi_energy", efermi);
+  logger.log("kappa", kappa);
   logger.log("ks_energy_comps", energy_components);
 
   if (step % 10 == 0) {
-    auto ek_host =
-        eval_threaded(tapply(
-                          [](auto&& x) {
-                            return Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace(), x);
-                          },
-                          ek))
-            .allgather(commk);
-
-    auto fn_host =
-        eval_threaded(tapply(
-                          [](auto&& x) {
-                            return Kokkos::create_mirror_view_and_copy(Kokkos::HostSpace(), x);
-                          },
-                          fn))
-            .allgather(commk);
-
-    logger.log("eta", ek_host);
-    logger.log("fn", fn_host);
+    // gathered to the writing rank only
+    logger.log("eta", ek, commk);
+    logger.log("fn", fn, commk);
   }
 }
 
@@ -188,28 +205,175 @@ struct minus
 };
 
 
+/// k-point tasks and threads per task for the wave-functions X (see partition_threads)
+template <class xspace, class X_t>
+thread_partition
+make_thread_partition(const mvector<X_t>& X, const nlcg_options& options)
+{
+  int total = available_threads();
+  // device kernels: k-points are evaluated one after the other
+  if (!std::is_same<xspace, Kokkos::HostSpace>::value || X.size() == 0) {
+    return thread_partition{1, total, false};
+  }
+  std::size_t n{0}, nb{0};
+  bool distributed{false};
+  for (std::size_t i = 0; i < X.size(); ++i) {
+    auto& x = X.value(i);
+    n = std::max<std::size_t>(n, x.array().extent(0));
+    nb = std::max<std::size_t>(nb, x.array().extent(1));
+    // per k-point collectives must not interleave
+    distributed = distributed || x.map().comm().size() > 1;
+  }
+  thread_partition overrides{options.kpoint_tasks, options.threads_per_task, options.numa};
+  return partition_threads(total, X.size(), n, nb, !distributed, overrides);
+}
+
+/**
+ * A k-point may be distributed over the ranks of its own communicator (the entry's map comm),
+ * commk must then hold each k-point exactly once (one rank per k-point communicator), such that
+ * reductions over commk count every k-point once.
+ */
+template <class X_t>
+void
+check_kpoint_distribution(const mvector<X_t>& X, const Communicator& commk)
+{
+  std::vector<int> keys;
+  for (std::size_t i = 0; i < X.size(); ++i) {
+    keys.push_back(X.key(i).first);
+    keys.push_back(X.key(i).second);
+  }
+  std::set<std::pair<int, int>> seen;
+  for (auto& rank_keys : commk.allgather(keys)) {
+    for (std::size_t i = 0; i + 1 < rank_keys.size(); i += 2) {
+      if (!seen.emplace(rank_keys[i], rank_keys[i + 1]).second) {
+        throw std::runtime_error("nlcg: k-point (" + std::to_string(rank_keys[i]) + ", " +
+                                 std::to_string(rank_keys[i + 1]) +
+                                 ") appears on more than one rank of the k-point communicator");
+      }
+    }
+  }
+}
+
+/// writes log, json and profile output: rank 0 of commk and of its first k-point communicator
+template <class X_t>
+bool
+is_output_rank(const mvector<X_t>& X, const Communicator& commk)
+{
+  if (commk.rank() != 0) return false;
+  return X.size() == 0 || X.value(0).map().comm().rank() == 0;
+}
+
+/// CG update formula from its name, e.g. NLCGLIB_CG_UPDATE (empty: Fletcher-Reeves)
+cg_update
+parse_cg_update(const std::string& name)
+{
+  if (name.empty() || name == "fr") return cg_update::FLETCHER_REEVES;
+  if (name == "pr+") return cg_update::POLAK_RIBIERE_PLUS;
+  if (name == "hs") return cg_update::HESTENES_STIEFEL;
+  throw std::invalid_argument("NLCGLIB_CG_UPDATE: expected fr, pr+ or hs, got " + name);
+}
+
+nlcg_options::nlcg_options()
+    : skip_newton_efermi(env::get_skip_newton_efermi())
+    , cg(parse_cg_update(env::get_cg_update()))
+    , powell_restart(env::get_powell_restart())
+    , kpoint_tasks(env::get_kpoint_tasks())
+    , threads_per_task(env::get_threads_per_task())
+    , numa(env::get_numa())
+{
+}
+
+nlcg_session::nlcg_session(const nlcg_options& options)
+    : state_(std::make_unique<state>())
+{
+  state_->options = options;
+}
+
+nlcg_session::~nlcg_session() = default;
+
+void
+nlcg_session::reset()
+{
+  state_->clear();
+}
+
+int
+nlcg_session::num_runs() const
+{
+  return state_->runs;
+}
+
+const nlcg_options&
+nlcg_session::options() const
+{
+  return state_->options;
+}
+
+/// calls f when the scope is left, by a return or an exception
+template <class F>
+class scope_exit
+{
+public:
+  explicit scope_exit(F f)
+      : f_(f)
+  {
+  }
+  ~scope_exit() { f_(); }
+  scope_exit(const scope_exit&) = delete;
+  scope_exit& operator=(const scope_exit&) = delete;
+
+private:
+  F f_;
+};
+
+/// true if x and y have the same keys and matrices of the same size
+template <class X, class Y>
+bool
+same_shape(const mvector<X>& x, const mvector<Y>& y)
+{
+  if (x.size() != y.size()) return false;
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    if (x.key(i) != y.key(i)) return false;
+    const auto& a = x.value(i).array();
+    const auto& b = y.value(i).array();
+    if (a.extent(0) != b.extent(0) || a.extent(1) != b.extent(1)) return false;
+  }
+  return true;
+}
+
 /// xspace -> memory space where nlcg is executed
-template <class xspace, enum smearing_type smearing_t>
+/// RESIDENT -> X, eta and the search directions are kept in xspace between iterations
+/// numeric_t -> Kokkos::complex<double>, or double for a Gamma-point only k-set
+/// history -> number of L-BFGS pairs, 0: nonlinear CG
+template <class xspace, enum smearing_type smearing_t, bool RESIDENT, class numeric_t>
 nlcg_info
-nlcg_us(EnergyBase& energy_base,
-        UltrasoftPrecondBase& us_precond_base,
-        OverlapBase& overlap_base,
-        double T,
-        int maxiter,
-        double tol,
-        double kappa,
-        double tau,
-        int restart)
+nlcg_us_impl(EnergyBase& energy_base,
+             UltrasoftPrecondBase& us_precond_base,
+             OverlapBase& overlap_base,
+             double T,
+             int maxiter,
+             double tol,
+             double kappa,
+             double tau,
+             int restart,
+             int history,
+             nlcg_session::state& session)
 {
   // std::feclearexcept(FE_ALL_EXCEPT);
   // feenableexcept(FE_ALL_EXCEPT & ~FE_INEXACT &
   //                ~FE_UNDERFLOW);  // Enable all floating point exceptions but FE_INEXACT
   nlcg_info info;
 
-  auto S = Overlap(overlap_base);
-  auto P = USPreconditioner(us_precond_base);
+  // cache S, P applications (e.g. reused when CG restarts within the same iteration), the
+  // non-reentrant ones are called by one k-point task at a time
+  auto callback_lock = std::make_shared<std::mutex>();
+  auto S = Overlap(overlap_base, 2, callback_lock);
+  auto P = USPreconditioner(us_precond_base, 2, callback_lock);
 
-    Timer timer;
+  Timer timer;
+  Timer timer_total;
+  timer_total.start();
+  nlcg_stats stats;
   FreeEnergy free_energy(T, energy_base, smearing_t);
   std::map<smearing_type, std::string> smear_name{
       {smearing_type::FERMI_DIRAC, "Fermi-Dirac"},
@@ -218,11 +382,20 @@ nlcg_us(EnergyBase& energy_base,
       {smearing_type::METHFESSEL_PAXTON, "Methfessel-Paxton"},
       {smearing_type::GAUSSIAN_SPLINE, "Gaussian-spline"}};
 
-  auto& logger = Logger::GetInstance();
-
-  logger.detach_stdout();
-  logger.attach_file_master("nlcg.out");
-  remove("nlcg.json");
+  auto X0 = free_energy.get_X<numeric_t>();
+  Communicator commk(energy_base.get_kpoint_weights()->mpicomm());
+  check_kpoint_distribution(X0, commk);
+  const bool output_rank = is_output_rank(X0, commk);
+
+  // log of the session, written by the output rank; the log file of the previous call of the
+  // session is continued
+  if (!session.logger) {
+    session.logger = std::make_unique<Logger>(commk.raw(), output_rank);
+    session.logger->detach_stdout();
+    session.logger->attach_file_master(session.options.log_file);
+  }
+  logger_scope log_scope(session.logger.get());
+  auto& logger = *session.logger;
 
   free_energy.compute();
 
@@ -238,9 +411,15 @@ nlcg_us(EnergyBase& energy_base,
          << std::setw(10) << "kappa"
          << ": " << kappa << "\n"
          << std::setw(10) << "tau"
-         << ": " << tau << "\n"
-         << std::setw(10) << "restart"
-         << ": " << restart << "\n";
+         << ": " << tau << "\n";
+  const bool lbfgs = history > 0;
+  if (lbfgs) {
+    logger << std::setw(10) << "L-BFGS "
+           << ": " << history << " pairs\n";
+  } else {
+    logger << std::setw(10) << "restart"
+           << ": " << restart << "\n";
+  }
 
   int Ne = energy_base.nelectrons();
   logger << "num electrons: " << Ne << "\n";
@@ -248,60 +427,268 @@ nlcg_us(EnergyBase& energy_base,
 
   auto ek = free_energy.get_ek();
   auto wk = free_energy.get_wk();
-  auto commk = wk.commk();
+  // per-step records are written by a background thread on the output rank, the file is
+  // truncated by the first call of the session
+  if (output_rank && !session.step_writer && !session.options.json_file.empty()) {
+    session.step_writer = std::make_unique<async_record_writer>(session.options.json_file);
+  }
+  async_record_writer* step_writer = session.step_writer.get();
+  // write trace and flat profile on exit (if NLCGLIB_PROFILE is set)
+  profile_output_guard profile_output(commk.raw(), output_rank);
+  NLCGLIB_PROFILE_REGION("nlcg");
   Smearing smearing = free_energy.get_smearing();
+  smearing.set_skip_newton(session.options.skip_newton_efermi);
+  // the chemical potential search starts at the last mu, within the run and from the previous
+  // call, only for the caller's sessions (not the temporary ones of the overloads without)
+  smearing.set_warm_start(session.warm_start);
+  if (session.warm_start && session.has_mu) smearing.set_mu_guess(session.mu);
 
   auto mu_fn = smearing.fn(ek);
   double mu = std::get<0>(mu_fn);
   auto fn = std::get<1>(mu_fn);
-  auto X0 = free_energy.get_X();
   free_energy.compute(X0, fn, ek, mu);
 
-  auto Hx = copy(free_energy.get_HX());
-  auto X = copy(free_energy.get_X());
+  // host <-> xspace copies, recorded only where the state is moved to/from xspace
+  transfer_stats transfers;
+  transfer_stats* state_transfers = RESIDENT ? &transfers : nullptr;
+  using state_space = std::conditional_t<RESIDENT, xspace, Kokkos::HostSpace>;
+  // eta = diag(ek) in the state space
+  auto make_eta = [&](auto&& ek) {
+    return eval_threaded(tapply(
+        [&](auto eki) {
+          return make_diag()(counted_mirror(state_space(), eki, "eta", state_transfers));
+        },
+        ek));
+  };
+
+  auto Hx = copy(free_energy.get_HX<numeric_t>());
+  auto X = eval_threaded(tapply(
+      [&](auto x) { return counted_mirror(state_space(), x, "initial", state_transfers); },
+      copy(free_energy.get_X<numeric_t>())));
+
+  // k-point concurrency, BLAS threads and NUMA placement of this run (session options)
+  auto partition = make_thread_partition<xspace>(X, session.options);
+  thread_partition_guard partition_guard(partition);
+  blas_process_threads_scope blas_threads(partition.threads_per_task);
+  logger << "k-point tasks: " << partition.tasks
+         << ", threads per task: " << partition.threads_per_task << "\n";
+  // X, Hx were copied by the master thread, move them to the home domains of the k-point tasks
+  if (numa_enabled() && kpoint_tasks_concurrent()) {
+    numa_place(X);
+    numa_place(Hx);
+    logger << "NUMA-aware placement: " << numa::num_domains() << " domains\n";
+  } else if (numa_enabled()) {
+    logger << "NUMA-aware placement skipped: the k-points are evaluated sequentially\n";
+  } else if (session.options.numa) {
+    logger << "NUMA-aware placement is ignored: built without libnuma or a single NUMA domain\n";
+  }
+  auto numa_tasks0 = numa::get_task_counts();
+  constexpr bool gamma_only = std::is_floating_point<numeric_t>::value;
+  if (gamma_only) logger << "Gamma-point only: real wave-functions\n";
 
   // double fr = compute_slope_single(g_X, delta_x, g_eta, delta_eta, commk);
   line_search ls;
   ls.t_trial = 0.2;
+  // warm start: first trial step from the last accepted step of the previous call
+  if (session.warm_start && session.t_last > 0) ls.t_trial = std::min(std::max(session.t_last, 1e-2), 1.0);
+  const double t_trial0 = ls.t_trial;
   ls.tau = tau;
+  // L-BFGS directions are scaled, the unit step is accepted if it decreases F enough
+  if (lbfgs) ls.armijo = 1e-4;
   logger << std::setw(15) << std::left << "Iteration" << std::setw(15) << std::left << "Free energy"
          << "\t" << std::setw(15) << std::left << "Residual"
          << "\n";
 
   // auto HX_c = copy(Hx);
-  descent_direction<smearing_t> dd(T, kappa);
+  // non-resident runs: the execution space copy of X is shared by the descent direction and the
+  // line search of an iteration (S X is applied once), dropped with the operator caches
+  exec_space_mirrors mirrors;
+  descent_direction<smearing_t, RESIDENT> dd(T, kappa, &transfers, RESIDENT ? nullptr : &mirrors);
+  std::map<cg_update, std::string> cg_name{{cg_update::FLETCHER_REEVES, "fr"},
+                                           {cg_update::POLAK_RIBIERE_PLUS, "pr+"},
+                                           {cg_update::HESTENES_STIEFEL, "hs"}};
+  dd.set_update(session.options.cg, session.options.powell_restart);
+  if (!lbfgs) {
+    logger << "CG update: " << cg_name.at(session.options.cg)
+           << ", Powell restart: " << session.options.powell_restart << "\n";
+  }
+  // kappa adapted to the X and eta contributions of the slope (CG only)
+  adaptive_kappa akappa(
+      kappa, lbfgs ? 0 : session.options.kappa_min, session.options.kappa_max);
+  if (akappa.enabled()) {
+    dd.set_kappa(akappa.kappa());
+    logger << "adaptive kappa: [" << session.options.kappa_min << ", "
+           << session.options.kappa_max << "], initial " << akappa.kappa() << "\n";
+  } else if (lbfgs && session.options.kappa_min > 0) {
+    logger << "adaptive kappa is ignored for L-BFGS\n";
+  }
 
-  auto eta = eval_threaded(tapply(make_diag(), ek));
-  auto slope_zx_zeta = dd.restarted(xspace(), X, ek, fn, Hx, wk, mu, S, P, free_energy);
-  double slope = std::get<0>(slope_zx_zeta);
-  auto z_x = std::get<1>(slope_zx_zeta);
-  auto z_eta = std::get<2>(slope_zx_zeta);
+  auto eta = make_eta(ek);
+  using direction_t =
+      std::decay_t<decltype(dd.restarted(xspace(), X, ek, fn, Hx, wk, mu, S, P, free_energy))>;
+  using z_t = std::tuple_element_t<1, direction_t>;
+  // (X, Z_X, Z_eta) of the last direction of the previous call, if the shapes still match
+  using session_direction_t = std::tuple<decltype(X), z_t, z_t>;
+  const auto* z_prev =
+      session.warm_start ? session.get_direction<session_direction_t>() : nullptr;
+  if (z_prev && !same_shape(std::get<0>(*z_prev), X)) z_prev = nullptr;
+  // the previous direction was preconditioned with a different kappa
+  if (z_prev && session.kappa() != dd.get_kappa()) z_prev = nullptr;
+  lbfgs_direction<typename z_t::value_type> lbfgs_dir(history);
+  // (fr, slope, Z_X, Z_eta) of the L-BFGS direction at the current iterate
+  auto lbfgs_step = [&](double mu) {
+    auto fr_delta_g = dd.gradient(xspace(), X, ek, fn, Hx, wk, mu, S, P, free_energy);
+    double fr = std::get<0>(fr_delta_g);
+    if (lbfgs_dir.update(ls.t_last,
+                         std::get<3>(fr_delta_g),
+                         std::get<4>(fr_delta_g),
+                         std::get<1>(fr_delta_g),
+                         std::get<2>(fr_delta_g))) {
+      NLCGLIB_LOG_DEBUG << "L-BFGS pairs: " << lbfgs_dir.size() << "\n";
+    }
+    return std::tuple_cat(std::make_tuple(fr),
+                          lbfgs_dir.direction(fr,
+                                              std::get<3>(fr_delta_g),
+                                              std::get<4>(fr_delta_g),
+                                              std::get<1>(fr_delta_g),
+                                              std::get<2>(fr_delta_g)));
+  };
+
+  double slope{0};
+  double fr{0};  // Fletcher-Reeves numerator
+  z_t z_x, z_eta;
+
+  // keep mu, the last step and direction for the next call of the session, on every exit path
+  // (also if an exception is thrown, e.g. by the host code)
+  auto save_session = [&]() {
+    try {
+      session.runs++;
+      session.has_mu = true;
+      session.mu = free_energy.get_chemical_potential();
+      if (ls.num_searches > 0) session.t_last = ls.t_last;
+      if (z_x.size() > 0) {
+        session.set_direction(session_direction_t(X, z_x, z_eta), fr, dd.get_kappa());
+      }
+      if (step_writer) step_writer->flush();
+    } catch (std::exception& e) {
+      logger << "WARNING: the session state was not saved: " << e.what() << "\n";
+    }
+  };
+  scope_exit<decltype(save_session)&> save_on_exit(save_session);
+
+  if (lbfgs) {
+    std::tie(fr, slope, z_x, z_eta) = lbfgs_step(mu);
+  } else if (z_prev) {
+    // warm start: conjugate to the previous direction. The eta basis (eigenvectors of ek) and
+    // X have changed since (e.g. an ionic step), the previous direction is rotated by
+    // ul0 = X_prev^H S X, like the rotation ul of the geodesic (X_new = X(t) ul).
+    auto ul0 = eval_threaded(tapply(
+        [](auto&& x_prev, auto&& x, auto&& s) { return inner_()(x_prev, s(x)); },
+        std::get<0>(*z_prev),
+        X,
+        S));
+    dd.set_warm_start();
+    auto fr_slope_z_x_z_eta = dd.conjugated(xspace(), session.fr(), X, ek, fn, Hx,
+                                            std::get<1>(*z_prev), std::get<2>(*z_prev), ul0, wk,
+                                            mu, S, P, free_energy);
+    fr = std::get<0>(fr_slope_z_x_z_eta);
+    slope = std::get<1>(fr_slope_z_x_z_eta);
+    z_x = std::get<2>(fr_slope_z_x_z_eta);
+    z_eta = std::get<3>(fr_slope_z_x_z_eta);
+    // Powell-type test: the previous direction (scaled to the size of Δ) is dropped if it is far
+    // from orthogonal to the new gradient, e.g. after a large ionic step
+    bool accept = slope < 0 && std::abs(dd.last_beta() * dd.slope_zp()) < 0.2 * std::abs(fr);
+    logger << "warm start from the previous direction: " << (accept ? "accepted" : "rejected")
+           << "\n";
+    if (!accept) z_prev = nullptr;
+  }
+  if (!z_prev && !lbfgs) {
+    auto slope_zx_zeta = dd.restarted(xspace(), X, ek, fn, Hx, wk, mu, S, P, free_energy);
+    slope = std::get<0>(slope_zx_zeta);
+    fr = slope;
+    z_x = std::get<1>(slope_zx_zeta);
+    z_eta = std::get<2>(slope_zx_zeta);
+  }
+  akappa.set_direction(slope, dd.slope_eta());
   // allocate rotation matrices
   auto ul = eval_threaded(tapply([](auto&& z) { return empty_like()(z); }, z_eta));
 
-  // CG related variables
-  double fr = slope;  // Fletcher-Reeves numerator
   bool force_restart{false};
 
+  // curvature of the last step from the slopes of the transported direction. A new kappa applies
+  // to the current direction right away: its eta part is rescaled, i.e. Δ_eta and Z(n-1)_eta
+  // are taken with the new kappa, and the next conjugated step stays consistent.
+  auto update_kappa = [&]() {
+    if (!akappa.enabled()) return;
+    double kappa_old = dd.get_kappa();
+    dd.set_kappa(akappa.update(ls.t_last, dd.slope_zp(), dd.slope_zp_eta()));
+    if (dd.get_kappa() != kappa_old) dd.scale_eta(dd.get_kappa() / kappa_old, z_eta, fr, slope);
+  };
+
+  auto collect_stats = [&]() {
+    stats.energy_evaluations = free_energy.num_evaluations();
+    stats.time_energy = free_energy.time_compute();
+    stats.line_searches = ls.num_searches;
+    stats.bt_search_fallbacks = ls.num_bt_search;
+    stats.operator_applies = S.stats().calls() + P.stats().calls();
+    stats.time_apply = S.stats().seconds() + P.stats().seconds();
+    stats.time_total = timer_total.stop();
+    stats.gradient_norm_k.clear();
+    for (auto& elem : dd.fr_k().allgather(commk)) {
+      stats.gradient_norm_k[elem.first] = elem.second;
+    }
+    stats.cg_update = cg_name.at(dd.update());
+    stats.powell_restarts = dd.num_powell_restarts();
+    stats.beta_resets = dd.num_beta_resets();
+    stats.kappa = akappa.kappa();
+    stats.kappa_updates = akappa.num_updates();
+    if (lbfgs) {
+      stats.lbfgs_history = history;
+      stats.lbfgs_skipped_pairs = lbfgs_dir.num_skipped();
+      stats.lbfgs_resets = lbfgs_dir.num_resets();
+    }
+    stats.transfers.clear();
+    for (auto& elem : transfers.counts()) {
+      stats.transfers[elem.first] = std::make_pair(elem.second.calls, elem.second.bytes);
+    }
+    if (numa_enabled() && kpoint_tasks_concurrent()) {
+      auto numa_tasks = numa::get_task_counts();
+      stats.numa_domains = numa::num_domains();
+      stats.numa_local_tasks = numa_tasks.local - numa_tasks0.local;
+      stats.numa_remote_tasks = numa_tasks.remote - numa_tasks0.remote;
+      stats.numa_sampled_pages = 0;
+      stats.numa_remote_pages = 0;
+      numa_count_remote_pages(X, stats.numa_sampled_pages, stats.numa_remote_pages);
+      logger << "NUMA: k-point tasks local/remote " << stats.numa_local_tasks << "/"
+             << stats.numa_remote_tasks << ", remote pages of X " << stats.numa_remote_pages
+             << "/" << stats.numa_sampled_pages << " (sampled)\n";
+    }
+    return stats;
+  };
+
   for (int cg_iter = 0; cg_iter < maxiter; ++cg_iter) {
-    if (std::abs(slope) < tol) {
+    // the L-BFGS direction is scaled, its residual is <g, P g>
+    double residual = lbfgs ? fr : slope;
+    if (std::abs(residual) < tol) {
       info = print_info(free_energy.get_F(),
                         free_energy.ks_energy(),
                         free_energy.get_entropy(),
-                        slope,
+                        residual,
                         -1,
                         free_energy.get_chemical_potential(),
                         cg_iter);
       cg_write_step_json(free_energy.get_F(),
                          free_energy.ks_energy(),
                          free_energy.get_entropy(),
-                         slope,
+                         residual,
                          -1,
                          free_energy.get_chemical_potential(),
+                         akappa.kappa(),
                          ek,
                          fn,
                          free_energy.ks_energy_components(),
                          commk,
+                         step_writer,
                          cg_iter);
 
       free_energy.ehandle().print_info();  // print magnetization
@@ -313,6 +700,7 @@ nlcg_us(EnergyBase& energy_base,
              << "NLCG SUCCESS\n";
       logger.flush();
 
+      info.stats = collect_stats();
       return info;
     }
     try {
@@ -320,11 +708,16 @@ nlcg_us(EnergyBase& energy_base,
 
       // TODO: capture variables explicitly here
       auto g = [&](double t) {
-        auto ek_ul_xnext = geodesic(xspace(), X, eta, z_x, z_eta, S, t);
+        auto ek_ul_xnext = geodesic<RESIDENT>(
+            xspace(), X, eta, z_x, z_eta, S, t, &transfers, RESIDENT ? nullptr : &mirrors);
         auto ek = std::get<0>(ek_ul_xnext);
         auto Xn = std::get<2>(ek_ul_xnext);
         auto mu_fn = smearing.fn(ek);
         double mu = std::get<0>(mu_fn);
+        // FreeEnergy::compute copies X to the EnergyBase host buffer
+        if (RESIDENT) {
+          for (auto& x : Xn) transfers.record("energy handoff", num_bytes(x.second));
+        }
 
         free_energy.compute(Xn, std::get<1>(mu_fn), ek, mu);
 
@@ -334,13 +727,15 @@ nlcg_us(EnergyBase& energy_base,
       cg_write_step_json(free_energy.get_F(),
                          free_energy.ks_energy(),
                          free_energy.get_entropy(),
-                         slope,
+                         residual,
                          -1,
                          free_energy.get_chemical_potential(),
+                         akappa.kappa(),
                          ek,
                          fn,
                          free_energy.ks_energy_components(),
                          commk,
+                         step_writer,
                          cg_iter);
 
       timer.start();
@@ -348,14 +743,23 @@ nlcg_us(EnergyBase& energy_base,
       info = print_info(free_energy.get_F(),
                         free_energy.ks_energy(),
                         free_energy.get_entropy(),
-                        slope /* slope in X and eta, temporarily */,
+                        residual /* slope in X and eta, temporarily */,
                         -1 /* need to separate the two slopes first */,
                         free_energy.get_chemical_potential(),
                         cg_iter);
       free_energy.ehandle().print_info();  // print magnetization
+      if (akappa.enabled()) {
+        logger << "\t kappa        : " << std::scientific << std::setprecision(3) << akappa.kappa()
+               << " (t_eta / t_x = " << akappa.ratio() << ")\n";
+      }
 
-      auto ek_ul_x_mu = ls(g, free_energy, slope, force_restart);
+      if (lbfgs) ls.t_trial = lbfgs_dir.size() > 0 ? 1.0 : t_trial0;
+      auto ek_ul_x_mu = [&]() {
+        NLCGLIB_PROFILE_REGION("line search");
+        return ls(g, free_energy, slope, force_restart);
+      }();
       auto tlap = timer.stop();
+      stats.time_line_search += tlap;
       logger << "line search took: " << tlap << " seconds\n";
 
       // update (X, fn(ek), ul, Hx) after line-search
@@ -363,21 +767,59 @@ nlcg_us(EnergyBase& energy_base,
       ul = std::get<1>(ek_ul_x_mu);
       X = std::get<2>(ek_ul_x_mu);
       double mu = std::get<3>(ek_ul_x_mu);
-      eta = eval_threaded(tapply(make_diag(), ek));
+      // results for the previous iterate and direction won't be used again, the cache is kept
+      // within an iteration (line search trials share S X, S Z; restarts and the L-BFGS
+      // transport/gradient share S X, P S X and P H X)
+      S.invalidate_cache();
+      P.invalidate_cache();
+      mirrors.clear();
+      eta = make_eta(ek);
       fn = free_energy.get_fn();
-      Hx = copy(free_energy.get_HX());
+      Hx = copy(free_energy.get_HX<numeric_t>());
+
+      if (lbfgs) {
+        timer.start();
+        // the line search fell back to the starting point
+        if (force_restart) {
+          lbfgs_dir.clear();
+          stats.forced_restarts++;
+        }
+        lbfgs_dir.transport(X, ul, S);
+        std::tie(fr, slope, z_x, z_eta) = lbfgs_step(mu);
 
-      if ((cg_iter % restart == 0) || force_restart) {
+        auto tlap = timer.stop();
+        stats.time_descent_direction += tlap;
+        logger << "L-BFGS direction took: " << tlap << " seconds\n";
+      } else if (!force_restart && cg_iter % restart == 0 && akappa.enabled()) {
+        /* steepest descent, Z(n-1) is transported for the kappa update */
+        timer.start();
+
+        auto fr_slope_z_x_z_eta = dd.conjugated(
+            xspace(), fr, X, ek, fn, Hx, z_x, z_eta, ul, wk, mu, S, P, free_energy, true);
+        fr = std::get<0>(fr_slope_z_x_z_eta);
+        slope = std::get<1>(fr_slope_z_x_z_eta);
+        z_x = std::get<2>(fr_slope_z_x_z_eta);
+        z_eta = std::get<3>(fr_slope_z_x_z_eta);
+        update_kappa();
+        akappa.set_direction(slope, dd.slope_eta());
+
+        auto tlap = timer.stop();
+        stats.time_descent_direction += tlap;
+        logger << "steepest descent took: " << tlap << " seconds\n";
+      } else if ((cg_iter % restart == 0) || force_restart) {
         /* compute directions for steepest descent */
         timer.start();
+        if (force_restart && cg_iter % restart != 0) stats.forced_restarts++;
 
         auto slope_zx_zeta = dd.restarted(xspace(), X, ek, fn, Hx, wk, mu, S, P, free_energy);
         slope = std::get<0>(slope_zx_zeta); // no need to catch slope > 0 -> linesearch will throw
         fr = slope;
         z_x = std::get<1>(slope_zx_zeta);
         z_eta = std::get<2>(slope_zx_zeta);
+        akappa.set_direction(slope, dd.slope_eta());
 
         auto tlap = timer.stop();
+        stats.time_descent_direction += tlap;
         logger << "steepest descent took: " << tlap << " seconds\n";
       } else {
         /* compute directions for cg */
@@ -389,6 +831,7 @@ nlcg_us(EnergyBase& energy_base,
         slope = std::get<1>(fr_slope_z_x_z_eta);
         z_x = std::get<2>(fr_slope_z_x_z_eta);
         z_eta = std::get<3>(fr_slope_z_x_z_eta);
+        update_kappa();
 
         if (slope > 0) {
           // force restart
@@ -400,65 +843,184 @@ nlcg_us(EnergyBase& energy_base,
           z_eta = std::get<2>(slope_zx_zeta);
 
           force_restart = true;
+          stats.forced_restarts++;
         }
+        akappa.set_direction(slope, dd.slope_eta());
 
         auto tlap = timer.stop();
+        stats.time_descent_direction += tlap;
         logger << "conjugated descent took: " << tlap << " seconds\n";
       }
       logger.flush();
     } catch (DescentError&) {
       // CG failed abort
       logger << "WARNING: No descent direction found, nlcg didn't reach final tolerance\n";
+      info.stats = collect_stats();
       return info;
     }
   }
+  info.stats = collect_stats();
   return info;
 }
 
+/// host runs: host and execution space coincide, only the resident variant is instantiated
+template <class xspace, enum smearing_type smearing_t, class numeric_t>
+nlcg_info
+nlcg_us_resident(EnergyBase& energy_base,
+                 UltrasoftPrecondBase& us_precond_base,
+                 OverlapBase& overlap_base,
+                 double T,
+                 int maxiter,
+                 double tol,
+                 double kappa,
+                 double tau,
+                 int restart,
+                 int history,
+                 nlcg_session::state& session,
+                 std::true_type /* host */)
+{
+  return nlcg_us_impl<xspace, smearing_t, true, numeric_t>(energy_base, us_precond_base,
+                                                          overlap_base, T, maxiter, tol, kappa,
+                                                          tau, restart, history, session);
+}
 
+/// device runs: state kept on the device if NLCGLIB_RESIDENT=1
+template <class xspace, enum smearing_type smearing_t, class numeric_t>
 nlcg_info
-nlcg_us_cpu(EnergyBase& energy_base,
-            UltrasoftPrecondBase& us_precond_base,
-            OverlapBase& overlap_base,
-            smearing_type smearing,
-            double temp,
-            double tol,
-            double kappa,
-            double tau,
-            int maxiter,
-            int restart)
+nlcg_us_resident(EnergyBase& energy_base,
+                 UltrasoftPrecondBase& us_precond_base,
+                 OverlapBase& overlap_base,
+                 double T,
+                 int maxiter,
+                 double tol,
+                 double kappa,
+                 double tau,
+                 int restart,
+                 int history,
+                 nlcg_session::state& session,
+                 std::false_type /* host */)
+{
+  if (env::get_resident_state()) {
+    return nlcg_us_impl<xspace, smearing_t, true, numeric_t>(energy_base, us_precond_base,
+                                                            overlap_base, T, maxiter, tol, kappa,
+                                                            tau, restart, history, session);
+  }
+  return nlcg_us_impl<xspace, smearing_t, false, numeric_t>(energy_base, us_precond_base,
+                                                           overlap_base, T, maxiter, tol, kappa,
+                                                           tau, restart, history, session);
+}
+
+template <class xspace, enum smearing_type smearing_t>
+nlcg_info
+nlcg_us(EnergyBase& energy_base,
+        UltrasoftPrecondBase& us_precond_base,
+        OverlapBase& overlap_base,
+        double T,
+        int maxiter,
+        double tol,
+        double kappa,
+        double tau,
+        int restart,
+        int history,
+        nlcg_session::state& session)
+{
+  using complex_t = Kokkos::complex<double>;
+  using host_t = std::is_same<xspace, Kokkos::HostSpace>;
+  if (energy_base.gamma_only()) {
+    return nlcg_us_resident<xspace, smearing_t, double>(energy_base, us_precond_base,
+                                                        overlap_base, T, maxiter, tol, kappa, tau,
+                                                        restart, history, session, host_t{});
+  }
+  return nlcg_us_resident<xspace, smearing_t, complex_t>(energy_base, us_precond_base,
+                                                         overlap_base, T, maxiter, tol, kappa, tau,
+                                                         restart, history, session, host_t{});
+}
+
+/// dispatch on the smearing type, history > 0: L-BFGS instead of CG
+template <class xspace>
+nlcg_info
+nlcg_us_smearing(EnergyBase& energy_base,
+                 UltrasoftPrecondBase& us_precond_base,
+                 OverlapBase& overlap_base,
+                 smearing_type smearing,
+                 double temp,
+                 int maxiter,
+                 double tol,
+                 double kappa,
+                 double tau,
+                 int restart,
+                 int history,
+                 nlcg_session::state& session)
 {
   switch (smearing) {
     case smearing_type::FERMI_DIRAC: {
-      auto info = nlcg_us<Kokkos::HostSpace, smearing_type::FERMI_DIRAC>(
-          energy_base, us_precond_base, overlap_base, temp, maxiter, tol, kappa, tau, restart);
-      return info;
+      return nlcg_us<xspace, smearing_type::FERMI_DIRAC>(energy_base, us_precond_base,
+                                                         overlap_base, temp, maxiter, tol, kappa,
+                                                         tau, restart, history, session);
     }
     case smearing_type::GAUSSIAN_SPLINE: {
-      auto info = nlcg_us<Kokkos::HostSpace, smearing_type::GAUSSIAN_SPLINE>(
-          energy_base, us_precond_base, overlap_base, temp, maxiter, tol, kappa, tau, restart);
-      return info;
+      return nlcg_us<xspace, smearing_type::GAUSSIAN_SPLINE>(energy_base, us_precond_base,
+                                                             overlap_base, temp, maxiter, tol,
+                                                             kappa, tau, restart, history, session);
     }
     case smearing_type::GAUSS: {
-      auto info = nlcg_us<Kokkos::HostSpace, smearing_type::GAUSS>(
-          energy_base, us_precond_base, overlap_base, temp, maxiter, tol, kappa, tau, restart);
-      return info;
+      return nlcg_us<xspace, smearing_type::GAUSS>(energy_base, us_precond_base, overlap_base,
+                                                   temp, maxiter, tol, kappa, tau, restart,
+                                                   history, session);
     }
     case smearing_type::METHFESSEL_PAXTON: {
-      auto info = nlcg_us<Kokkos::HostSpace, smearing_type::METHFESSEL_PAXTON>(
-          energy_base, us_precond_base, overlap_base, temp, maxiter, tol, kappa, tau, restart);
-      return info;
+      return nlcg_us<xspace, smearing_type::METHFESSEL_PAXTON>(energy_base, us_precond_base,
+                                                               overlap_base, temp, maxiter, tol,
+                                                               kappa, tau, restart, history,
+                                                               session);
     }
     case smearing_type::COLD: {
-      auto info = nlcg_us<Kokkos::HostSpace, smearing_type::COLD>(
-          energy_base, us_precond_base, overlap_base, temp, maxiter, tol, kappa, tau, restart);
-      return info;
+      return nlcg_us<xspace, smearing_type::COLD>(energy_base, us_precond_base, overlap_base,
+                                                  temp, maxiter, tol, kappa, tau, restart,
+                                                  history, session);
     }
     default:
       throw std::runtime_error("invalid smearing type given");
   }
 }
 
+
+nlcg_info
+nlcg_us_cpu(EnergyBase& energy_base,
+            UltrasoftPrecondBase& us_precond_base,
+            OverlapBase& overlap_base,
+            smearing_type smearing,
+            double temp,
+            double tol,
+            double kappa,
+            double tau,
+            int maxiter,
+            int restart)
+{
+  nlcg_session session;
+  session.get().warm_start = false;
+  return nlcg_us_cpu(energy_base, us_precond_base, overlap_base, smearing, temp, tol, kappa, tau,
+                     maxiter, restart, session);
+}
+
+nlcg_info
+nlcg_us_cpu(EnergyBase& energy_base,
+            UltrasoftPrecondBase& us_precond_base,
+            OverlapBase& overlap_base,
+            smearing_type smearing,
+            double temp,
+            double tol,
+            double kappa,
+            double tau,
+            int maxiter,
+            int restart,
+            nlcg_session& session)
+{
+  return nlcg_us_smearing<Kokkos::HostSpace>(energy_base, us_precond_base, overlap_base, smearing,
+                                             temp, maxiter, tol, kappa, tau, restart, 0,
+                                             session.get());
+}
+
 nlcg_info
 nlcg_us_device(EnergyBase& energy_base,
                UltrasoftPrecondBase& us_precond_base,
@@ -470,38 +1032,109 @@ nlcg_us_device(EnergyBase& energy_base,
                double tau,
                int maxiter,
                int restart)
+{
+  nlcg_session session;
+  session.get().warm_start = false;
+  return nlcg_us_device(energy_base, us_precond_base, overlap_base, smearing, temp, tol, kappa, tau,
+                        maxiter, restart, session);
+}
+
+nlcg_info
+nlcg_us_device(EnergyBase& energy_base,
+               UltrasoftPrecondBase& us_precond_base,
+               OverlapBase& overlap_base,
+               smearing_type smearing,
+               double temp,
+               double tol,
+               double kappa,
+               double tau,
+               int maxiter,
+               int restart,
+               nlcg_session& session)
 {
 #ifdef __NLCGLIB__CUDA
-  switch (smearing) {
-    case smearing_type::FERMI_DIRAC: {
-      auto info = nlcg_us<Kokkos::CudaSpace, smearing_type::FERMI_DIRAC>(
-          energy_base, us_precond_base, overlap_base, temp, maxiter, tol, kappa, tau, restart);
-      return info;
-    }
-    case smearing_type::GAUSSIAN_SPLINE: {
-      auto info = nlcg_us<Kokkos::CudaSpace, smearing_type::GAUSSIAN_SPLINE>(
-          energy_base, us_precond_base, overlap_base, temp, maxiter, tol, kappa, tau, restart);
-      return info;
-    }
-    case smearing_type::GAUSS: {
-      auto info = nlcg_us<Kokkos::CudaSpace, smearing_type::GAUSS>(
-          energy_base, us_precond_base, overlap_base, temp, maxiter, tol, kappa, tau, restart);
-      return info;
-    }
-    case smearing_type::METHFESSEL_PAXTON: {
-      auto info = nlcg_us<Kokkos::CudaSpace, smearing_type::METHFESSEL_PAXTON>(
-          energy_base, us_precond_base, overlap_base, temp, maxiter, tol, kappa, tau, restart);
-      return info;
-    }
-    case smearing_type::COLD: {
-      auto info = nlcg_us<Kokkos::CudaSpace, smearing_type::COLD>(
-          energy_base, us_precond_base, overlap_base, temp, maxiter, tol, kappa, tau, restart);
-      return info;
-    }
+  return nlcg_us_smearing<Kokkos::CudaSpace>(energy_base, us_precond_base, overlap_base, smearing,
+                                             temp, maxiter, tol, kappa, tau, restart, 0,
+                                             session.get());
+#else
+  throw std::runtime_error("recompile nlcglib with CUDA.");
+#endif
+}
 
-    default:
-      throw std::runtime_error("invalid smearing type given");
-  }
+nlcg_info
+nlcg_lbfgs_us_cpu(EnergyBase& energy_base,
+                  UltrasoftPrecondBase& us_precond_base,
+                  OverlapBase& overlap_base,
+                  smearing_type smearing,
+                  double temp,
+                  double tol,
+                  double kappa,
+                  double tau,
+                  int maxiter,
+                  int history)
+{
+  nlcg_session session;
+  session.get().warm_start = false;
+  return nlcg_lbfgs_us_cpu(energy_base, us_precond_base, overlap_base, smearing, temp, tol, kappa,
+                           tau, maxiter, history, session);
+}
+
+nlcg_info
+nlcg_lbfgs_us_cpu(EnergyBase& energy_base,
+                  UltrasoftPrecondBase& us_precond_base,
+                  OverlapBase& overlap_base,
+                  smearing_type smearing,
+                  double temp,
+                  double tol,
+                  double kappa,
+                  double tau,
+                  int maxiter,
+                  int history,
+                  nlcg_session& session)
+{
+  if (history < 1) throw std::runtime_error("L-BFGS history must be positive");
+  // no periodic restarts, L-BFGS falls back to steepest descent for ascent directions only
+  return nlcg_us_smearing<Kokkos::HostSpace>(energy_base, us_precond_base, overlap_base, smearing,
+                                             temp, maxiter, tol, kappa, tau, 0, history,
+                                             session.get());
+}
+
+nlcg_info
+nlcg_lbfgs_us_device(EnergyBase& energy_base,
+                     UltrasoftPrecondBase& us_precond_base,
+                     OverlapBase& overlap_base,
+                     smearing_type smearing,
+                     double temp,
+                     double tol,
+                     double kappa,
+                     double tau,
+                     int maxiter,
+                     int history)
+{
+  nlcg_session session;
+  session.get().warm_start = false;
+  return nlcg_lbfgs_us_device(energy_base, us_precond_base, overlap_base, smearing, temp, tol,
+                              kappa, tau, maxiter, history, session);
+}
+
+nlcg_info
+nlcg_lbfgs_us_device(EnergyBase& energy_base,
+                     UltrasoftPrecondBase& us_precond_base,
+                     OverlapBase& overlap_base,
+                     smearing_type smearing,
+                     double temp,
+                     double tol,
+                     double kappa,
+                     double tau,
+                     int maxiter,
+                     int history,
+                     nlcg_session& session)
+{
+  if (history < 1) throw std::runtime_error("L-BFGS history must be positive");
+#ifdef __NLCGLIB__CUDA
+  return nlcg_us_smearing<Kokkos::CudaSpace>(energy_base, us_precond_base, overlap_base, smearing,
+                                             temp, maxiter, tol, kappa, tau, 0, history,
+                                             session.get());
 #else
   throw std::runtime_error("recompile nlcglib with CUDA.");
 #endif
@@ -579,6 +1212,23 @@ nlcg_us_device_cpu(EnergyBase& energy_base,
       energy_base, us_precond_base, overlap_base, smear, T, tol, kappa, tau, maxiter, restart);
 }
 
+nlcg_info
+nlcg_us_device_cpu(EnergyBase& energy_base,
+                   UltrasoftPrecondBase& us_precond_base,
+                   OverlapBase& overlap_base,
+                   smearing_type smear,
+                   double T,
+                   double tol,
+                   double kappa,
+                   double tau,
+                   int maxiter,
+                   int restart,
+                   nlcg_session& session)
+{
+  return nlcg_us_cpu(energy_base, us_precond_base, overlap_base, smear, T, tol, kappa, tau,
+                     maxiter, restart, session);
+}
+
 nlcg_info
 nlcg_us_cpu_device(EnergyBase& energy_base,
                    UltrasoftPrecondBase& us_precond_base,
@@ -597,4 +1247,21 @@ nlcg_us_cpu_device(EnergyBase& energy_base,
       energy_base, us_precond_base, overlap_base, smear, T, tol, kappa, tau, maxiter, restart);
 }
 
+nlcg_info
+nlcg_us_cpu_device(EnergyBase& energy_base,
+                   UltrasoftPrecondBase& us_precond_base,
+                   OverlapBase& overlap_base,
+                   smearing_type smear,
+                   double T,
+                   double tol,
+                   double kappa,
+                   double tau,
+                   int maxiter,
+                   int restart,
+                   nlcg_session& session)
+{
+  return nlcg_us_device(energy_base, us_precond_base, overlap_base, smear, T, tol, kappa, tau,
+                        maxiter, restart, session);
+}
+
 }  // namespace nlcglib
@@ -1,7 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <typeindex>
 #include "la/mvector.hpp"
 #include "la/dvector.hpp"
+#include "utils/profiler.hpp"
 
 namespace nlcglib {
 
@@ -54,29 +62,306 @@ private:
 }  // namespace local
 
 
+/**
+ * Bounded LRU cache of operator applications.
+ *
+ * Results are keyed by (k-index, input buffer, generation). The input is kept
+ * alive while its entry is cached, so the data pointer cannot be recycled by
+ * another allocation. Buffers modified in-place must be followed by a call to
+ * `invalidate`, which bumps the generation and drops all previous entries.
+ *
+ * Results are shared, not copied: a hit returns the cached buffer itself, callers must not
+ * modify the results of a cached applicator in-place.
+ */
+class applicator_cache
+{
+public:
+  using key_t = std::pair<int, int>;
+
+public:
+  /// capacity: max. number of cached results per k-index
+  explicit applicator_cache(std::size_t capacity)
+      : capacity_(capacity)
+  {
+  }
+
+  void invalidate()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++generation_;
+    entries_.clear();
+  }
+
+  /// returns nullptr if no matching result is found
+  template <class Y_t, class buffer_t>
+  std::shared_ptr<Y_t> find(const key_t& key, const buffer_t& in);
+
+  template <class X_t, class Y_t, class buffer_t>
+  void insert(const key_t& key, const buffer_t& in, const X_t& x, const Y_t& y);
+
+  std::size_t hits() const { return hits_.load(std::memory_order_relaxed); }
+  std::size_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+  struct entry
+  {
+    key_t key;
+    const void* data;
+    std::array<std::ptrdiff_t, 2> size;
+    std::array<std::ptrdiff_t, 2> stride;
+    std::size_t generation;
+    std::type_index type;
+    // holds a reference to the input, s.t. its memory isn't reused
+    std::shared_ptr<void> input;
+    std::shared_ptr<void> output;
+  };
+
+  /// real and complex inputs at the same address are told apart by the result type
+  template <class buffer_t>
+  bool matches(const entry& e, const key_t& key, const buffer_t& in) const
+  {
+    return e.generation == generation_ && e.key == key && e.data == in.data && e.size == in.size &&
+           e.stride == in.stride;
+  }
+
+  std::size_t capacity_;
+  std::size_t generation_{0};
+  /// most recently used entries first
+  std::list<entry> entries_;
+  std::mutex mutex_;
+  std::atomic<std::size_t> hits_{0};
+  std::atomic<std::size_t> misses_{0};
+};
+
+template <class Y_t, class buffer_t>
+std::shared_ptr<Y_t>
+applicator_cache::find(const key_t& key, const buffer_t& in)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+    if (matches(*it, key, in) && it->type == std::type_index(typeid(Y_t))) {
+      // move to front
+      entries_.splice(entries_.begin(), entries_, it);
+      ++hits_;
+      return std::static_pointer_cast<Y_t>(entries_.front().output);
+    }
+  }
+  ++misses_;
+  return nullptr;
+}
+
+template <class X_t, class Y_t, class buffer_t>
+void
+applicator_cache::insert(const key_t& key, const buffer_t& in, const X_t& x, const Y_t& y)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (capacity_ == 0) return;
+
+  // evict least recently used entry of this k-index
+  std::size_t count = std::count_if(
+      entries_.begin(), entries_.end(), [&key](const entry& e) { return e.key == key; });
+  if (count >= capacity_) {
+    for (auto it = entries_.rbegin(); it != entries_.rend(); ++it) {
+      if (it->key == key) {
+        entries_.erase(std::next(it).base());
+        break;
+      }
+    }
+  }
+
+  entries_.push_front(entry{key,
+                            in.data,
+                            in.size,
+                            in.stride,
+                            generation_,
+                            std::type_index(typeid(Y_t)),
+                            std::make_shared<X_t>(x),
+                            std::make_shared<Y_t>(y)});
+  // the result shares the buffer of y (views), nothing is copied
+}
+
+
+/// Number of operator applications and time spent in them (thread-safe).
+class apply_stats
+{
+public:
+  void add(int calls, std::chrono::nanoseconds t)
+  {
+    calls_.fetch_add(calls, std::memory_order_relaxed);
+    ns_.fetch_add(t.count(), std::memory_order_relaxed);
+  }
+
+  int calls() const { return calls_.load(std::memory_order_relaxed); }
+  double seconds() const { return ns_.load(std::memory_order_relaxed) * 1e-9; }
+
+private:
+  std::atomic<int> calls_{0};
+  std::atomic<long long> ns_{0};
+};
+
+
+namespace local {
+
+/// OpBase::apply for complex, OpBase::apply_real for real (Gamma-point) buffers
+template <class op_t>
+void
+apply_op(const op_t& op,
+         const std::pair<int, int>& key,
+         buffer_protocol<std::complex<double>, 2>& out,
+         buffer_protocol<std::complex<double>, 2>& in)
+{
+  op.apply(key, out, in);
+}
+
+template <class op_t>
+void
+apply_op(const op_t& op,
+         const std::pair<int, int>& key,
+         buffer_protocol<double, 2>& out,
+         buffer_protocol<double, 2>& in)
+{
+  op.apply_real(key, out, in);
+}
+
+template <class op_t>
+void
+apply_op_batch(const op_t& op,
+               const std::pair<int, int>& key,
+               std::vector<buffer_protocol<std::complex<double>, 2>>& out,
+               std::vector<buffer_protocol<std::complex<double>, 2>>& in)
+{
+  op.apply_batch(key, out, in);
+}
+
+/// there is no batched real interface, the blocks are applied one at a time
+template <class op_t>
+void
+apply_op_batch(const op_t& op,
+               const std::pair<int, int>& key,
+               std::vector<buffer_protocol<double, 2>>& out,
+               std::vector<buffer_protocol<double, 2>>& in)
+{
+  for (std::size_t i = 0; i < in.size(); ++i) {
+    op.apply_real(key, out[i], in[i]);
+  }
+}
+
+}  // namespace local
+
+
 template <class T>
 class applicator
 {
 public:
-  applicator(const T& op, std::pair<int, int> key)
+  applicator(const T& op,
+             std::pair<int, int> key,
+             std::shared_ptr<applicator_cache> cache = nullptr,
+             std::shared_ptr<apply_stats> stats = nullptr,
+             std::shared_ptr<std::mutex> callback_lock = nullptr)
       : op(op)
       , key(key)
+      , cache(cache)
+      , stats(stats)
+      , callback_lock(callback_lock)
   {
   }
 
   template <class X_t>
   auto operator()(X_t&& X) const
   {
-    auto Y = empty_like()(X);
+    NLCGLIB_PROFILE_REGION("operator apply", key);
+    decltype(empty_like()(X)) Y;
+    if (this->lookup(X, Y)) return Y;
+    Y = empty_like()(X);
     auto vX = as_buffer_protocol(X);
     auto vY = as_buffer_protocol(Y);
-    op.apply(key, vY, vX);
+    auto t0 = std::chrono::steady_clock::now();
+    {
+      auto lock = this->lock();
+      local::apply_op(op, key, vY, vX);
+    }
+    this->account(1, t0);
+    this->store(X, Y);
     return Y;
   }
 
+  /// apply to two blocks at once, uncached blocks are passed in a single `apply_batch` call
+  template <class X1_t, class X2_t>
+  auto operator()(X1_t&& X1, X2_t&& X2) const
+  {
+    NLCGLIB_PROFILE_REGION("operator apply (batch)", key);
+    decltype(empty_like()(X1)) Y1;
+    decltype(empty_like()(X2)) Y2;
+    bool hit1 = this->lookup(X1, Y1);
+    bool hit2 = this->lookup(X2, Y2);
+    if (!hit1) Y1 = empty_like()(X1);
+    if (!hit2) Y2 = empty_like()(X2);
+
+    using buffer_t = decltype(as_buffer_protocol(X1));
+    std::vector<buffer_t> vin;
+    std::vector<buffer_t> vout;
+    if (!hit1) {
+      vin.push_back(as_buffer_protocol(X1));
+      vout.push_back(as_buffer_protocol(Y1));
+    }
+    if (!hit2) {
+      vin.push_back(as_buffer_protocol(X2));
+      vout.push_back(as_buffer_protocol(Y2));
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    {
+      auto lock = this->lock();
+      if (vin.size() == 1) {
+        local::apply_op(op, key, vout[0], vin[0]);
+      } else if (vin.size() > 1) {
+        local::apply_op_batch(op, key, vout, vin);
+      }
+    }
+    this->account(vin.size(), t0);
+
+    if (!hit1) this->store(X1, Y1);
+    if (!hit2) this->store(X2, Y2);
+    return std::make_tuple(Y1, Y2);
+  }
+
 private:
+  /// held while the host operator runs, if it is not reentrant
+  std::unique_lock<std::mutex> lock() const
+  {
+    if (!callback_lock) return std::unique_lock<std::mutex>();
+    return std::unique_lock<std::mutex>(*callback_lock);
+  }
+
+  void account(int calls, std::chrono::steady_clock::time_point t0) const
+  {
+    if (!stats || calls == 0) return;
+    stats->add(calls, std::chrono::steady_clock::now() - t0);
+  }
+
+  /// Y refers to the cached result (no copy), returns false if not found
+  template <class X_t, class Y_t>
+  bool lookup(const X_t& X, Y_t& Y) const
+  {
+    if (!cache) return false;
+    auto Yc = cache->find<Y_t>(key, as_buffer_protocol(X));
+    if (!Yc) return false;
+    Y = *Yc;
+    return true;
+  }
+
+  template <class X_t, class Y_t>
+  void store(const X_t& X, const Y_t& Y) const
+  {
+    if (!cache) return;
+    cache->insert(key, as_buffer_protocol(X), X, Y);
+  }
+
+
   const T& op;
   std::pair<int, int> key;
+  std::shared_ptr<applicator_cache> cache;
+  std::shared_ptr<apply_stats> stats;
+  std::shared_ptr<std::mutex> callback_lock;
 };
 
 
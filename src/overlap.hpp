@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include "interface.hpp"
 #include "la/mvector.hpp"
 #include "la/dvector.hpp"
@@ -19,12 +20,20 @@ public:
   using key_t = std::pair<int, int>;
 
 public:
-  Overlap(const OverlapBase& overlap_base)
+  /// cache_capacity: number of cached results per k-point (0 disables caching), callback_lock:
+  /// held during the calls of a non-reentrant operator (see OpBase::reentrant), operators
+  /// sharing it are called one at a time
+  Overlap(const OverlapBase& overlap_base, std::size_t cache_capacity = 0,
+          std::shared_ptr<std::mutex> callback_lock = nullptr)
       : overlap_base(overlap_base)
+      , callback_lock(overlap_base.reentrant() ? nullptr : callback_lock)
   {
-    /* empty */
+    if (cache_capacity > 0) cache = std::make_shared<applicator_cache>(cache_capacity);
   }
 
+  /// calls to apply and the time spent in them
+  const apply_stats& stats() const { return *stats_; }
+
   auto at(const key_t& key) const -> value_type;
 
   auto begin() { return local::op_iterator<Overlap> (overlap_base.get_keys(), *this, false); }
@@ -36,15 +45,23 @@ public:
     throw std::runtime_error("not implemented");
   }
 
+  /// drop cached results, must be called if inputs have been modified in-place
+  void invalidate_cache() const
+  {
+    if (cache) cache->invalidate();
+  }
 
 private:
   const OverlapBase& overlap_base;
+  std::shared_ptr<applicator_cache> cache;
+  std::shared_ptr<std::mutex> callback_lock;
+  std::shared_ptr<apply_stats> stats_{std::make_shared<apply_stats>()};
 };
 
 inline auto
 Overlap::at(const key_t& key) const -> value_type
 {
-  return applicator<OverlapBase>(overlap_base, key);
+  return applicator<OverlapBase>(overlap_base, key, cache, stats_, callback_lock);
 }
 
 }  // namespace nlcglib
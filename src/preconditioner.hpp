@@ -73,7 +73,35 @@ public:
 public:
   PreconditionerTeter(std::shared_ptr<VectorBaseZ> ekin)
   {
-    auto ekin_vector = make_mmvector<Kokkos::HostSpace>(ekin);
+    // host buffers are only read here, no need to copy them
+    bool on_host = true;
+    for (int i = 0; i < ekin->size(); ++i) {
+      on_host = on_host && ekin->get(i).memtype == memory_type::host;
+    }
+    if (on_host) {
+      this->init(make_mmvector_view<Kokkos::HostSpace>(ekin));
+    } else {
+      this->init(make_mmvector<Kokkos::HostSpace>(ekin));
+    }
+  }
+
+
+  template<class key_t>
+  auto operator[](const key_t& key) const
+  {
+    return diagonal_preconditioner<memspace>(kinetic_diag_precond.at(key));
+  }
+
+  template<class key_t>
+  auto at(const key_t& key) const
+  {
+    return this->operator[](key);
+  }
+
+private:
+  template <class V>
+  void init(const mvector<V>& ekin_vector)
+  {
     for (auto& elem : ekin_vector) {
       auto& key = elem.first;
       auto& ekin_loc = elem.second;
@@ -93,20 +121,6 @@ public:
     }
   }
 
-
-  template<class key_t>
-  auto operator[](const key_t& key) const
-  {
-    return diagonal_preconditioner<memspace>(kinetic_diag_precond.at(key));
-  }
-
-  template<class key_t>
-  auto at(const key_t& key) const
-  {
-    return this->operator[](key);
-  }
-
-private:
   mvector<view_t<memspace>> kinetic_diag_precond;
 };
 
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+
+namespace nlcglib {
+
+/**
+ * Adaptive preconditioner kappa of the pseudo-Hamiltonian, Δ_eta = kappa * (H_ij / w_k - diag(e)).
+ *
+ * The slope along the search direction Z is split into its X and eta contributions
+ * s = s_x + s_e. After a step t, the slopes of the (transported) direction at the new iterate
+ * give a secant curvature for each part, c = (s(t) - s(0)) / t, and the step minimizing each part
+ * alone, t_x = -s_x / c_x and t_e = -s_e / c_e. Since kappa scales the eta part of the direction,
+ * kappa is multiplied by t_e / t_x (limited to [1/2, 2] per iteration) and kept within
+ * [kappa_min, kappa_max]. Steps without positive curvature or descent in both parts leave kappa
+ * unchanged.
+ */
+class adaptive_kappa
+{
+public:
+  /// enabled if 0 < kappa_min < kappa_max, otherwise kappa stays fixed
+  adaptive_kappa(double kappa, double kappa_min, double kappa_max)
+      : kappa_min_(kappa_min)
+      , kappa_max_(kappa_max)
+      , enabled_(kappa_min > 0 && kappa_min < kappa_max)
+      , kappa_(enabled_ ? std::min(std::max(kappa, kappa_min), kappa_max) : kappa)
+  {
+  }
+
+  bool enabled() const { return enabled_; }
+  double kappa() const { return kappa_; }
+  /// t_e / t_x of the last update (0 if it was skipped)
+  double ratio() const { return ratio_; }
+  /// updates which changed kappa
+  int num_updates() const { return num_updates_; }
+
+  /// slope <g, Z> of the new search direction and its eta contribution
+  void set_direction(double slope, double slope_eta)
+  {
+    slope_x_ = slope - slope_eta;
+    slope_eta_ = slope_eta;
+    has_direction_ = true;
+  }
+
+  /**
+   * Step t along the last direction was accepted, slope_zp and slope_zp_eta are the slope of the
+   * transported direction at the new iterate and its eta contribution. Returns the new kappa.
+   */
+  double update(double t, double slope_zp, double slope_zp_eta)
+  {
+    ratio_ = 0;
+    if (!enabled_ || !has_direction_ || !(t > 0)) return kappa_;
+    has_direction_ = false;
+
+    double c_x = (slope_zp - slope_zp_eta - slope_x_) / t;
+    double c_eta = (slope_zp_eta - slope_eta_) / t;
+    if (!(slope_x_ < 0 && slope_eta_ < 0 && c_x > 0 && c_eta > 0)) return kappa_;
+
+    double t_x = -slope_x_ / c_x;
+    double t_eta = -slope_eta_ / c_eta;
+    ratio_ = t_eta / t_x;
+    double factor = std::min(std::max(ratio_, 0.5), 2.0);
+    double kappa = std::min(std::max(kappa_ * factor, kappa_min_), kappa_max_);
+    if (kappa != kappa_) num_updates_++;
+    kappa_ = kappa;
+    return kappa_;
+  }
+
+private:
+  double kappa_min_;
+  double kappa_max_;
+  bool enabled_;
+  double kappa_;
+  double slope_x_{0};
+  double slope_eta_{0};
+  bool has_direction_{false};
+  double ratio_{0};
+  int num_updates_{0};
+};
+
+}  // namespace nlcglib
@@ -20,11 +20,24 @@ struct GradEtaHelper
                       double mu,
                       double T,
                       double mo)
+  {
+    auto commk = wk.commk();
+    return commk.allreduce(dFdmu_local(Hii, en, fn, wk, mu, T, mo), mpi_op::sum);
+  }
+
+  /// contribution of the local k-points to dFdmu (not reduced)
+  template <class array1_t, class array2_t, class array3_t, class array4_t>
+  static double dFdmu_local(const mvector<array1_t>& Hii,
+                      const mvector<array2_t>& en,
+                      const mvector<array3_t>& fn,
+                      const mvector<array4_t>& wk,
+                      double mu,
+                      double T,
+                      double mo)
   {
     static_assert(
         is_on_host<array1_t>::value && is_on_host<array2_t>::value && is_on_host<array3_t>::value,
         "GradEtaHelper::dFdmu expects host memory input");
-    auto commk = wk.commk();
     double dFdmu_loc{0};
     for (auto& elem : Hii) {
       auto hii = elem.second;
@@ -45,8 +58,7 @@ struct GradEtaHelper
           v);
       dFdmu_loc += v.real() * wk[key];  // note that hii is real-valued
     }
-    auto dFdmu = commk.allreduce(dFdmu_loc, mpi_op::sum);
-    return dFdmu;
+    return dFdmu_loc;
   }
 
   /** w_k * fn (1-fn) summed over all k-points
@@ -59,9 +71,16 @@ struct GradEtaHelper
   static double dmu_deta(
       const mvector<array1_t>& en, const mvector<double>& wk, double mu, double T, double mo)
   {
-    static_assert(is_on_host<array1_t>::value, "GradEtaHelper::dmu_deta expects host memory input");
-
     auto commk = wk.commk();
+    return commk.allreduce(dmu_deta_local(en, wk, mu, T, mo), mpi_op::sum);
+  }
+
+  /// contribution of the local k-points to dmu_deta (not reduced)
+  template <class array1_t>
+  static double dmu_deta_local(
+      const mvector<array1_t>& en, const mvector<double>& wk, double mu, double T, double mo)
+  {
+    static_assert(is_on_host<array1_t>::value, "GradEtaHelper::dmu_deta expects host memory input");
 
     double kT = physical_constants::kb * T;
 
@@ -77,7 +96,7 @@ struct GradEtaHelper
       }
     }
 
-    return commk.allreduce(v, mpi_op::sum);
+    return v;
   }
 };
 
@@ -187,6 +206,37 @@ public:
   }
 
 
+  /**
+   * Derivative of g_eta with respect to c = dFdmu / dmu_deta: diag(wk * delta_i / kT).
+   *
+   * g_eta(c) = g_eta(0) + c * g_eta_mu, i.e. g_eta can be evaluated before the reduction of
+   * dFdmu and dmu_deta has completed and corrected afterwards.
+   */
+  template <class matrix_t, class array1_t>
+  to_layout_left_t<matrix_t> g_eta_mu(
+      const matrix_t& Hij, double mu, double wk, const array1_t& ek, double mo)
+  {
+    auto gETA = zeros_like()(Hij);
+
+    using SPACE = typename matrix_t::storage_t::memory_space;
+    using exec_space = exec_t<SPACE>;
+    auto mgETA = gETA.array();
+    int nbands = Hij.array().extent(0);
+    double kT_loc = kT;
+    Kokkos::parallel_for(
+        "gEta (mu)", Kokkos::RangePolicy<exec_space>(0, nbands), KOKKOS_LAMBDA(int i) {
+          double delta = smearing<smearing_t>::delta((ek(i) - mu) / kT_loc, mo);
+          mgETA(i, i) = wk * delta / kT_loc;
+        });
+    return gETA;
+  }
+
+  /// c = dFdmu / dmu_deta, see g_eta_mu
+  static double mu_coefficient(double dmu_deta, double dFdmu)
+  {
+    return std::abs(dmu_deta) < 1e-12 ? 0 : dFdmu / dmu_deta;
+  }
+
   /**
    * Preconditioned gradient of η
    */
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <memory>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include "nlcglib.hpp"
+#include "utils/async_writer.hpp"
+#include "utils/logger.hpp"
+
+namespace nlcglib {
+
+/// options, log sinks and warm-start data of a nlcg_session, see nlcg_us_impl
+struct nlcg_session::state
+{
+  nlcg_options options;
+
+  /// log of the session's runs (options.log_file), created by the first run
+  std::unique_ptr<Logger> logger;
+
+  /// number of completed solver calls
+  int runs{0};
+
+  /// use the warm-start data, false for the temporary session of the calls without a session
+  /// (each call starts from scratch, also the mu searches within the call)
+  bool warm_start{true};
+
+  bool has_mu{false};
+  /// chemical potential of the last call
+  double mu{0};
+  /// last accepted line search step (0: none)
+  double t_last{0};
+
+  /// options.json_file writer (rank 0), kept open across calls
+  std::unique_ptr<async_record_writer> step_writer;
+
+  /// last search direction, its type depends on the memory space and numeric type of the run
+  template <class T>
+  void set_direction(T&& direction, double fr, double kappa)
+  {
+    using direction_t = std::decay_t<T>;
+    direction_ = std::make_shared<direction_t>(std::forward<T>(direction));
+    direction_type_ = typeid(direction_t);
+    fr_ = fr;
+    kappa_ = kappa;
+  }
+
+  void drop_direction()
+  {
+    direction_.reset();
+    direction_type_ = typeid(void);
+    fr_ = 0;
+    kappa_ = 0;
+  }
+
+  /// nullptr if there is none or it was stored by a run of a different type
+  template <class T>
+  const T* get_direction() const
+  {
+    if (!direction_ || direction_type_ != std::type_index(typeid(T))) return nullptr;
+    return static_cast<const T*>(direction_.get());
+  }
+
+  /// Fletcher-Reeves numerator of the last direction
+  double fr() const { return fr_; }
+  /// kappa the eta part of the last direction was preconditioned with
+  double kappa() const { return kappa_; }
+
+  /// drop the warm-start data (options and log sinks are kept)
+  void clear()
+  {
+    has_mu = false;
+    mu = 0;
+    t_last = 0;
+    drop_direction();
+  }
+
+private:
+  std::shared_ptr<void> direction_;
+  std::type_index direction_type_{typeid(void)};
+  double fr_{0};
+  double kappa_{0};
+};
+
+}  // namespace nlcglib
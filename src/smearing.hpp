@@ -11,6 +11,7 @@
 #include "la/utils.hpp"
 #include "utils/env.hpp"
 #include "utils/logger.hpp"
+#include "utils/profiler.hpp"
 #include "utils/timer.hpp"
 
 namespace nlcglib {
@@ -350,7 +351,8 @@ occupation_from_mvector(double T,
                         double occ,
                         int Ne,
                         const scalar_vec_t& wk,
-                        double tol)
+                        double tol,
+                        double mu0 = 0)
 {
   auto x_host = eval_threaded(tapply(
       [](auto x) {
@@ -373,7 +375,7 @@ occupation_from_mvector(double T,
         }
         return Ne - sum;
       },
-      0, /* mu0 */
+      mu0,
       tol /* tolerance */);
 
   // // TODO: start Newton minimization for cold and m-p smearing.
@@ -448,7 +450,8 @@ occupation_from_mvector_newton(double T,
                                double occ,
                                int Ne,
                                const scalar_vec_t& wk,
-                               double tol)
+                               double tol,
+                               double mu0 = 0)
 {
   auto x_host = eval_threaded(tapply(
       [](auto x) {
@@ -461,7 +464,7 @@ occupation_from_mvector_newton(double T,
   auto wk_all = wk.allgather();
 
   // find initial value for the Newton minimization using Gauss smearing
-  double mu0 = find_chemical_potential(
+  double mu_gauss = find_chemical_potential(
       [&x = x_all, &wk = wk_all, &Ne = Ne, T = T, occ = occ](double mu) {
         double sum = 0;
         for (auto& wki : wk) {
@@ -472,7 +475,7 @@ occupation_from_mvector_newton(double T,
         }
         return Ne - sum;
       },
-      0, /* mu0 */
+      mu0,
       tol /* tolerance */);
 
   auto N = [&x = x_all, &wk = wk_all, occ = occ, T = T](double mu) {
@@ -503,10 +506,10 @@ occupation_from_mvector_newton(double T,
   // // Newton minimization using mu as initial value
   double mu;
   try {
-    mu = newton_minimization_chemical_potential(N, dN, ddN, mu0, Ne, tol);
+    mu = newton_minimization_chemical_potential(N, dN, ddN, mu_gauss, Ne, tol);
   } catch (failed_to_converge) {
-    Logger::GetInstance()
-        << "Warning: newton minimization for Fermi energy failed, fallback to bisection search.\n";
+    NLCGLIB_LOG_WARNING
+        << "newton minimization for Fermi energy failed, fallback to bisection search.\n";
     // TODO print a warning that fallback to bisection search was used
     mu = find_chemical_potential(
         [&x = x_all, &wk = wk_all, &Ne = Ne, T = T, occ = occ](double mu) {
@@ -519,7 +522,7 @@ occupation_from_mvector_newton(double T,
           }
           return Ne - sum;
         },
-        0, /* mu0 */
+        mu0,
         tol /* tolerance */);
   }
 
@@ -557,20 +560,24 @@ occupation_from_mvector_newton(double T,
 
 template <class smearing_t, class X, class scalar_vec_t>
 auto
-occupation_from_mvector1(
-    double T, const mvector<X>& x, double occ, int Ne, const scalar_vec_t& wk, double tol)
+occupation_from_mvector1(double T,
+                         const mvector<X>& x,
+                         double occ,
+                         int Ne,
+                         const scalar_vec_t& wk,
+                         double tol,
+                         double mu0 = 0,
+                         bool skip_newton = env::get_skip_newton_efermi())
 {
-  bool skip_newton = env::get_skip_newton_efermi();
-
   // std::cout << " non-monotonous smearing? " << std::is_base_of<non_monotonous, smearing_t>::value
   // << "\n";
 
   // check if newton should be ignored of env.
   double kT = physical_constants::kb * T;
   if (!skip_newton && std::is_base_of<non_monotonous, smearing_t>::value) {
-    return occupation_from_mvector_newton<smearing_t>(T, x, kT, occ, Ne, wk, tol);
+    return occupation_from_mvector_newton<smearing_t>(T, x, kT, occ, Ne, wk, tol, mu0);
   } else {
-    return occupation_from_mvector<smearing_t>(T, x, kT, occ, Ne, wk, tol);
+    return occupation_from_mvector<smearing_t>(T, x, kT, occ, Ne, wk, tol, mu0);
   }
 }
 
@@ -606,6 +613,15 @@ public:
   template <class X, class Y>
   double entropy(const mvector<X>& fn, const mvector<Y>& en, double mu);
 
+  /// starting point of the chemical potential search in fn(), e.g. mu of the previous ionic step
+  void set_mu_guess(double mu) { mu_guess = mu; }
+  double get_mu_guess() const { return mu_guess; }
+  /// keep the result of every fn() call as the next guess (otherwise the guess is not updated)
+  void set_warm_start(bool warm_start) { this->warm_start = warm_start; }
+
+  /// bisection instead of Newton for non-monotonous smearings (NLCGLIB_DISABLE_NEWTON_EFERMI)
+  void set_skip_newton(bool skip) { skip_newton = skip; }
+
 
 protected:
   /// Temperature in Kelvin
@@ -621,36 +637,50 @@ protected:
 
   mvector<double> wk;
   smearing_type smearing_t;
+  double mu_guess{0};
+  bool warm_start{false};
+  bool skip_newton{env::get_skip_newton_efermi()};
 };
 
 template <class X>
 auto
 Smearing::fn(const mvector<X>& x)
 {
+  NLCGLIB_PROFILE_REGION("mu search");
   switch (smearing_t) {
     case smearing_type::FERMI_DIRAC: {
       auto mu_fn = occupation_from_mvector1<fermi_dirac>(
-          this->T, x, this->occ, this->Ne, this->wk, this->tol);
+          this->T, x, this->occ, this->Ne, this->wk, this->tol, this->mu_guess,
+          this->skip_newton);
+      if (warm_start) mu_guess = std::get<0>(mu_fn);
       return mu_fn;
     }
     case smearing_type::GAUSSIAN_SPLINE: {
       auto mu_fn = occupation_from_mvector1<gaussian_spline>(
-          this->T, x, this->occ, this->Ne, this->wk, this->tol);
+          this->T, x, this->occ, this->Ne, this->wk, this->tol, this->mu_guess,
+          this->skip_newton);
+      if (warm_start) mu_guess = std::get<0>(mu_fn);
       return mu_fn;
     }
     case smearing_type::GAUSS: {
       auto mu_fn = occupation_from_mvector1<gauss_smearing>(
-          this->T, x, this->occ, this->Ne, this->wk, this->tol);
+          this->T, x, this->occ, this->Ne, this->wk, this->tol, this->mu_guess,
+          this->skip_newton);
+      if (warm_start) mu_guess = std::get<0>(mu_fn);
       return mu_fn;
     }
     case smearing_type::METHFESSEL_PAXTON: {
       auto mu_fn = occupation_from_mvector1<methfessel_paxton_smearing>(
-          this->T, x, this->occ, this->Ne, this->wk, this->tol);
+          this->T, x, this->occ, this->Ne, this->wk, this->tol, this->mu_guess,
+          this->skip_newton);
+      if (warm_start) mu_guess = std::get<0>(mu_fn);
       return mu_fn;
     }
     case smearing_type::COLD: {
       auto mu_fn = occupation_from_mvector1<cold_smearing>(
-          this->T, x, this->occ, this->Ne, this->wk, this->tol);
+          this->T, x, this->occ, this->Ne, this->wk, this->tol, this->mu_guess,
+          this->skip_newton);
+      if (warm_start) mu_guess = std::get<0>(mu_fn);
       return mu_fn;
     }
     default:
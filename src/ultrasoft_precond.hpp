@@ -1,5 +1,7 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
 #include "interface.hpp"
 #include "la/dvector.hpp"
 #include "la/mvector.hpp"
@@ -17,12 +19,20 @@ public:
   using value_type = applicator<UltrasoftPrecondBase>;
 
 public:
-  USPreconditioner(const UltrasoftPrecondBase& us_precond_base)
+  /// cache_capacity: number of cached results per k-point (0 disables caching), callback_lock:
+  /// held during the calls of a non-reentrant operator (see OpBase::reentrant), operators
+  /// sharing it are called one at a time
+  USPreconditioner(const UltrasoftPrecondBase& us_precond_base, std::size_t cache_capacity = 0,
+                   std::shared_ptr<std::mutex> callback_lock = nullptr)
       : us_precond_base(us_precond_base)
+      , callback_lock(us_precond_base.reentrant() ? nullptr : callback_lock)
   {
-    /* empty */
+    if (cache_capacity > 0) cache = std::make_shared<applicator_cache>(cache_capacity);
   }
 
+  /// calls to apply and the time spent in them
+  const apply_stats& stats() const { return *stats_; }
+
   auto at(const key_t& key) const;
 
   auto begin() { return local::op_iterator<USPreconditioner> (us_precond_base.get_keys(), *this, false); }
@@ -30,14 +40,23 @@ public:
   auto begin() const { return local::op_iterator<const USPreconditioner>(us_precond_base.get_keys(), *this, false); }
   auto end() const { return local::op_iterator<const USPreconditioner>(us_precond_base.get_keys(), *this, true); }
 
+  /// drop cached results, must be called if inputs have been modified in-place
+  void invalidate_cache() const
+  {
+    if (cache) cache->invalidate();
+  }
+
 private:
   const UltrasoftPrecondBase& us_precond_base;
+  std::shared_ptr<applicator_cache> cache;
+  std::shared_ptr<std::mutex> callback_lock;
+  std::shared_ptr<apply_stats> stats_{std::make_shared<apply_stats>()};
 };
 
 inline auto
 USPreconditioner::at(const key_t& key) const
 {
-  return applicator<UltrasoftPrecondBase>(us_precond_base, key);
+  return applicator<UltrasoftPrecondBase>(us_precond_base, key, cache, stats_, callback_lock);
 }
 
 
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace nlcglib {
+
+/**
+ * Writes records to a file from a background thread.
+ *
+ * push() hands a serialized record over to the writer thread and returns
+ * immediately, unless `capacity` records are already queued, in which case it
+ * blocks until the writer has caught up. Records are written in push order,
+ * the destructor drains the queue.
+ */
+class async_record_writer
+{
+public:
+  /// truncate: start a new file, otherwise append
+  explicit async_record_writer(const std::string& fname, std::size_t capacity = 64, bool truncate = true)
+      : out_(fname, truncate ? std::ios_base::trunc : std::ios_base::app)
+      , capacity_(capacity)
+  {
+    if (!out_) throw std::runtime_error("async_record_writer: cannot open " + fname);
+    thread_ = std::thread([this]() { this->run(); });
+  }
+
+  async_record_writer(const async_record_writer&) = delete;
+  async_record_writer& operator=(const async_record_writer&) = delete;
+
+  ~async_record_writer()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+    }
+    cv_pop_.notify_one();
+    thread_.join();
+  }
+
+  void push(std::string record)
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_push_.wait(lock, [this]() { return queue_.size() < capacity_; });
+    queue_.push_back(std::move(record));
+    lock.unlock();
+    cv_pop_.notify_one();
+  }
+
+  /// block until all queued records are written and flushed
+  void flush()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    flush_requested_ = true;
+    cv_pop_.notify_one();
+    cv_push_.wait(lock, [this]() { return queue_.empty() && !busy_ && !flush_requested_; });
+  }
+
+private:
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_pop_.wait(lock, [this]() { return !queue_.empty() || done_ || flush_requested_; });
+      if (queue_.empty()) {
+        out_.flush();
+        flush_requested_ = false;
+        cv_push_.notify_all();
+        if (done_) return;
+        continue;
+      }
+      std::string record = std::move(queue_.front());
+      queue_.pop_front();
+      busy_ = true;
+      lock.unlock();
+      cv_push_.notify_all();
+      // I/O outside of the lock
+      out_ << record;
+      lock.lock();
+      busy_ = false;
+    }
+  }
+
+  std::ofstream out_;
+  std::size_t capacity_;
+  std::deque<std::string> queue_;
+  std::mutex mutex_;
+  std::condition_variable cv_push_;
+  std::condition_variable cv_pop_;
+  bool done_{false};
+  bool busy_{false};
+  bool flush_requested_{false};
+  std::thread thread_;
+};
+
+}  // namespace nlcglib
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace nlcglib {
+
+/**
+ * Narrow a size or index to the integer type of a library interface (BLAS, LAPACK, MPI, cuBLAS).
+ *
+ * Sizes are std::ptrdiff_t internally, the conversion to 32-bit library integers happens only
+ * at the call boundary and throws instead of silently wrapping around.
+ */
+template <class To, class From>
+inline To
+checked_cast(From n, const char* where)
+{
+  static_assert(std::is_integral<To>::value && std::is_integral<From>::value,
+                "checked_cast: integral types only");
+  using wide_t = std::conditional_t<std::is_signed<From>::value, long long, unsigned long long>;
+  bool fits = std::is_signed<From>::value
+                  ? static_cast<long long>(n) >= static_cast<long long>(std::numeric_limits<To>::min()) &&
+                        static_cast<long long>(n) <= static_cast<long long>(std::numeric_limits<To>::max())
+                  : static_cast<unsigned long long>(n) <=
+                        static_cast<unsigned long long>(std::numeric_limits<To>::max());
+  if (!fits) {
+    throw std::runtime_error(std::string(where) + ": " + std::to_string(static_cast<wide_t>(n)) +
+                             " exceeds the range of the " + std::to_string(8 * sizeof(To)) +
+                             "-bit integer interface");
+  }
+  return static_cast<To>(n);
+}
+
+}  // namespace nlcglib
@@ -3,11 +3,13 @@
 #include <atomic>
 #include <cstdlib>
 #include <cstring>
+#include <stdexcept>
+#include <string>
 
 namespace nlcglib {
 namespace env {
 /// Check if environment variable NLCG_DISABLE_NEWTON_EFERMI is set (using a singleton).
-bool
+inline bool
 get_skip_newton_efermi()
 {
   static std::atomic<int> skip_newton{-1};
@@ -29,5 +31,105 @@ get_skip_newton_efermi()
   return skip_newton.load(std::memory_order_relaxed) == 1;
 }
 
+/// Smallest matrix size for which the distributed dense solver is used
+/// (NLCGLIB_SCALAPACK_MIN_N, default 4096).
+inline int
+get_scalapack_min_n()
+{
+  static const int min_n = [] {
+    char* val = std::getenv("NLCGLIB_SCALAPACK_MIN_N");
+    return val == nullptr ? 4096 : std::atoi(val);
+  }();
+  return min_n;
+}
+
+/// Block size of the 2D block-cyclic distribution (NLCGLIB_SCALAPACK_NB, default 64).
+inline int
+get_scalapack_block_size()
+{
+  static const int nb = [] {
+    char* val = std::getenv("NLCGLIB_SCALAPACK_NB");
+    int nb = val == nullptr ? 64 : std::atoi(val);
+    return nb > 0 ? nb : 64;
+  }();
+  return nb;
+}
+
+/// Keep the CG state (X, eta, search directions) in the device memory between iterations
+/// (NLCGLIB_RESIDENT=1, default 0: off). Otherwise the state lives on the host and is copied to
+/// the device in every descent direction and geodesic evaluation. Without effect for host runs.
+inline bool
+get_resident_state()
+{
+  static const bool resident = [] {
+    char* val = std::getenv("NLCGLIB_RESIDENT");
+    return val != nullptr && std::strcmp("0", val) != 0;
+  }();
+  return resident;
+}
+
+/// Number of k-points evaluated concurrently (NLCGLIB_KPOINT_TASKS, default 0: chosen from the
+/// matrix sizes).
+inline int
+get_kpoint_tasks()
+{
+  static const int tasks = [] {
+    char* val = std::getenv("NLCGLIB_KPOINT_TASKS");
+    int tasks = val == nullptr ? 0 : std::atoi(val);
+    return tasks > 0 ? tasks : 0;
+  }();
+  return tasks;
+}
+
+/// BLAS/Kokkos threads per k-point task (NLCGLIB_THREADS_PER_TASK, default 0: chosen from the
+/// matrix sizes).
+inline int
+get_threads_per_task()
+{
+  static const int threads = [] {
+    char* val = std::getenv("NLCGLIB_THREADS_PER_TASK");
+    int threads = val == nullptr ? 0 : std::atoi(val);
+    return threads > 0 ? threads : 0;
+  }();
+  return threads;
+}
+
+/// NUMA-aware placement of the k-point data and pinning of the k-point tasks (NLCGLIB_NUMA,
+/// default 0), see numa.hpp.
+inline bool
+get_numa()
+{
+  static const bool numa = [] {
+    char* val = std::getenv("NLCGLIB_NUMA");
+    return val != nullptr && std::strcmp("0", val) != 0;
+  }();
+  return numa;
+}
+
+/// CG update formula (NLCGLIB_CG_UPDATE): "fr" (Fletcher-Reeves), "pr+" (Polak-Ribiere+) or
+/// "hs" (Hestenes-Stiefel), empty if not set. The value is checked by nlcg_options.
+inline const std::string&
+get_cg_update()
+{
+  static const std::string update = [] {
+    char* val = std::getenv("NLCGLIB_CG_UPDATE");
+    return val == nullptr ? std::string() : std::string(val);
+  }();
+  return update;
+}
+
+/// Powell restart threshold (NLCGLIB_POWELL_RESTART, default 0: off), the CG step restarts
+/// when |<g, P g_prev>| >= threshold * <g, P g>; 0.2 is the usual choice.
+inline double
+get_powell_restart()
+{
+  static const double threshold = [] {
+    char* val = std::getenv("NLCGLIB_POWELL_RESTART");
+    double threshold = val == nullptr ? 0 : std::atof(val);
+    return threshold > 0 ? threshold : 0;
+  }();
+  return threshold;
+}
+
 }  // namespace env
 }  // namespace nlcglib
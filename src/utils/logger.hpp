@@ -1,98 +1,218 @@
 #pragma once
 
 #include <mpi.h>
+#include <atomic>
 #include <fstream>
-#include <iostream>
 #include <iomanip>
+#include <iostream>
 #include <list>
 #include <memory>
 #include <mutex>
+#include <sstream>
 #include <string>
+#include <vector>
 
-#include "csingleton.hpp"
+/// Compile-time log threshold: 0 debug, 1 info, 2 warning, 3 error. Statements
+/// below the threshold are compiled out (NLCGLIB_LOG_DEBUG etc.).
+#ifndef NLCGLIB_LOG_LEVEL
+#ifdef NDEBUG
+#define NLCGLIB_LOG_LEVEL 1
+#else
+#define NLCGLIB_LOG_LEVEL 0
+#endif
+#endif
 
 namespace nlcglib {
 
 const static struct to_stdout_trigger {} TO_STDOUT;
 
-class Logger : public CSingleton<Logger>
+enum class log_level : int
+{
+  debug = 0,
+  info = 1,
+  warning = 2,
+  error = 3
+};
+
+class Logger;
+
+/**
+ * A single log statement.
+ *
+ * Formats into a buffer taken from a pool of the calling thread and hands the complete
+ * message to the Logger when it goes out of scope (end of the full expression),
+ * so that concurrent statements are never interleaved. Records may be destroyed in any order.
+ */
+class log_record
 {
 public:
-  Logger() {
-    MPI_Comm_rank(MPI_COMM_WORLD, &pid_);
+  /// logger == nullptr: inactive record, discards all input
+  log_record(Logger* logger, log_level level, bool to_stdout);
+
+  log_record(const log_record&) = delete;
+  log_record& operator=(const log_record&) = delete;
+
+  log_record(log_record&& other)
+      : logger_(other.logger_)
+      , level_(other.level_)
+      , to_stdout_(other.to_stdout_)
+      , buf_(std::move(other.buf_))
+  {
+    other.logger_ = nullptr;
+  }
+
+  ~log_record();
+
+  template <typename T>
+  log_record& operator<<(const T& output)
+  {
+    if (buf_) *buf_ << output;
+    return *this;
+  }
+
+  /// std::endl and friends
+  log_record& operator<<(std::ostream& (*manip)(std::ostream&))
+  {
+    if (buf_) *buf_ << manip;
+    return *this;
+  }
+
+  log_record& operator<<(const to_stdout_trigger&)
+  {
+    to_stdout_ = true;
+    return *this;
+  }
+
+private:
+  /// unused buffers of this thread, a record may be created while formatting another one
+  static std::vector<std::unique_ptr<std::ostringstream>>& buffers()
+  {
+    static thread_local std::vector<std::unique_ptr<std::ostringstream>> buffers_;
+    return buffers_;
+  }
+
+  Logger* logger_;
+  log_level level_;
+  bool to_stdout_;
+  std::unique_ptr<std::ostringstream> buf_;
+};
+
+/**
+ * Log sink of a solver run.
+ *
+ * Each solver context (nlcg_session) owns a Logger whose master rank is rank 0 of the solver's
+ * communicator. GetInstance() returns the logger installed on the calling thread by a
+ * logger_scope, s.t. code below the solver entry point logs to the sinks of its own run;
+ * outside of a solver run a process-wide default logger (MPI_COMM_WORLD) is used.
+ *
+ * Records are formatted without locking, the sinks are written under a mutex (one short critical
+ * section per statement).
+ */
+class Logger
+{
+public:
+  explicit Logger(MPI_Comm comm = MPI_COMM_WORLD)
+  {
+    MPI_Comm_rank(comm, &pid_);
+    master_ = pid_ == 0;
+  }
+
+  /// master: this rank writes the file and stdout output (instead of rank 0 of comm)
+  Logger(MPI_Comm comm, bool master)
+      : Logger(comm)
+  {
+    master_ = master;
   }
 
-  Logger(Logger&&) = default;
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+
+  /// logger of the calling thread (see logger_scope)
+  static Logger& GetInstance()
+  {
+    Logger* logger = current();
+    if (logger) return *logger;
+    static Logger default_logger;
+    return default_logger;
+  }
+
+  /// logger installed on the calling thread, nullptr if none
+  static Logger*& current()
+  {
+    static thread_local Logger* current_{nullptr};
+    return current_;
+  }
 
   void attach_file(const std::string& prefix = "out", const std::string& suffix = ".log")
   {
-    MPI_Comm_rank(MPI_COMM_WORLD, &pid_);
+    std::lock_guard<std::mutex> lock(mutex_);
     stream_ptr_ = std::make_shared<std::ofstream>(prefix + std::to_string(pid_) + suffix);
   }
 
-  /// only master rank writes
+  /// only master rank writes, an empty fname detaches the file
   void attach_file_master(const std::string& fname = "nlcg.out")
   {
-    MPI_Comm_rank(MPI_COMM_WORLD, &pid_);
-    if (pid_ == 0)
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fname.empty())
+      stream_ptr_.reset();
+    else if (master_)
       stream_ptr_ = std::make_shared<std::ofstream>(fname);
   }
 
+  /// start a record at the given level, e.g. `logger.record(log_level::warning) << ...`
+  log_record record(log_level level, bool to_stdout = false)
+  {
+    return log_record(this->enabled(level) ? this : nullptr, level, to_stdout);
+  }
+
+  /// info level
   template <typename T>
-  Logger& operator<<(const T& output)
-  {
-    std::lock_guard<std::mutex> lock(std::mutex);
-    sbuf_.str("");
-
-    for (auto& v : prefixes_) {
-      sbuf_ << v << "::";
-    }
-    sbuf_ << output;
-    // output to console & file
-    if ((bool)stream_ptr_) {
-      auto& out = *(stream_ptr_.get());
-      out << sbuf_.str();
-    }
-    if (!detach_stdout_ && pid_ == 0) std::cout << sbuf_.str();
+  log_record operator<<(const T& output)
+  {
+    auto r = this->record(log_level::info);
+    r << output;
+    return r;
+  }
 
-    return *this;
+  /// info level, printed to stdout even if stdout is detached
+  log_record operator<<(const to_stdout_trigger&)
+  {
+    return this->record(log_level::info, true);
   }
 
-  Logger operator<<(const to_stdout_trigger&)
+  /// runtime threshold (on top of NLCGLIB_LOG_LEVEL)
+  void set_level(log_level level) { level_.store(static_cast<int>(level), std::memory_order_relaxed); }
+
+  bool enabled(log_level level) const
   {
-    Logger log;
-    log.prefixes_ = prefixes_;
-    log.stream_ptr_ = stream_ptr_;
-    log.detach_stdout_ = false;
-    return log;
+    return static_cast<int>(level) >= level_.load(std::memory_order_relaxed);
   }
 
   void push_prefix(const std::string& tag)
   {
-    std::lock_guard<std::mutex> lock(std::mutex);
+    std::lock_guard<std::mutex> lock(mutex_);
     prefixes_.push_back(tag);
+    this->update_prefix();
   }
 
   void pop_prefix()
   {
-    std::lock_guard<std::mutex> lock(std::mutex);
+    std::lock_guard<std::mutex> lock(mutex_);
     prefixes_.pop_back();
+    this->update_prefix();
   }
 
   void clear_prefix()
   {
-    std::lock_guard<std::mutex> lock(std::mutex);
+    std::lock_guard<std::mutex> lock(mutex_);
     prefixes_.clear();
+    this->update_prefix();
   }
 
   void flush()
   {
-    if(stream_ptr_) {
-      std::mutex mutex;
-      std::lock_guard<std::mutex> lock(mutex);
-      auto& out = *(stream_ptr_.get());
-      out.flush();
-    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stream_ptr_) stream_ptr_->flush();
   }
 
   void detach_stdout() { detach_stdout_ = true; }
@@ -101,12 +221,93 @@ public:
 
   bool is_detached() { return detach_stdout_ == true; }
 
+  /// called by log_record, msg is a complete statement
+  void write(const std::string& msg, log_level level, bool to_stdout)
+  {
+    const char* tag = level == log_level::warning ? "WARNING: "
+                      : level == log_level::error ? "ERROR: "
+                                                  : "";
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stream_ptr_) *stream_ptr_ << prefix_ << tag << msg;
+    if ((!detach_stdout_ || to_stdout) && master_) std::cout << prefix_ << tag << msg;
+  }
+
 private:
+  void update_prefix()
+  {
+    prefix_.clear();
+    for (auto& v : prefixes_) prefix_ += v + "::";
+  }
+
+  std::mutex mutex_;
   std::list<std::string> prefixes_;
+  std::string prefix_;
   std::shared_ptr<std::ostream> stream_ptr_;
-  std::stringstream sbuf_;
-  bool detach_stdout_ = false;
+  std::atomic<bool> detach_stdout_{false};
+  std::atomic<int> level_{NLCGLIB_LOG_LEVEL};
   int pid_ = 0;
+  bool master_{true};
+};
+
+/// installs `logger` as the logger of the calling thread for the lifetime of the scope
+class logger_scope
+{
+public:
+  explicit logger_scope(Logger* logger)
+      : prev_(Logger::current())
+  {
+    Logger::current() = logger;
+  }
+
+  ~logger_scope() { Logger::current() = prev_; }
+
+  logger_scope(const logger_scope&) = delete;
+  logger_scope& operator=(const logger_scope&) = delete;
+
+private:
+  Logger* prev_;
 };
 
+inline log_record::log_record(Logger* logger, log_level level, bool to_stdout)
+    : logger_(logger)
+    , level_(level)
+    , to_stdout_(to_stdout)
+{
+  if (!logger_) return;
+  auto& pool = buffers();
+  if (pool.empty()) {
+    buf_ = std::make_unique<std::ostringstream>();
+  } else {
+    buf_ = std::move(pool.back());
+    pool.pop_back();
+  }
+  // reset contents and formatting left behind by the previous record
+  buf_->str("");
+  buf_->clear();
+  buf_->flags(std::ios_base::fmtflags{std::ios_base::skipws | std::ios_base::dec});
+  buf_->precision(6);
+  buf_->width(0);
+  buf_->fill(' ');
+}
+
+inline log_record::~log_record()
+{
+  if (!buf_) return;
+  logger_->write(buf_->str(), level_, to_stdout_);
+  // back to the pool of the destroying thread
+  buffers().push_back(std::move(buf_));
+}
+
 }  // namespace nlcglib
+
+/// Leveled log statements, compiled out below NLCGLIB_LOG_LEVEL:
+///   NLCGLIB_LOG_DEBUG << "t_min = " << t_min << "\n";
+#define NLCGLIB_LOG_AT_(level_value, level)      \
+  if (NLCGLIB_LOG_LEVEL > (level_value)) {       \
+  } else                                         \
+    ::nlcglib::Logger::GetInstance().record(level)
+
+#define NLCGLIB_LOG_DEBUG NLCGLIB_LOG_AT_(0, ::nlcglib::log_level::debug)
+#define NLCGLIB_LOG_INFO NLCGLIB_LOG_AT_(1, ::nlcglib::log_level::info)
+#define NLCGLIB_LOG_WARNING NLCGLIB_LOG_AT_(2, ::nlcglib::log_level::warning)
+#define NLCGLIB_LOG_ERROR NLCGLIB_LOG_AT_(3, ::nlcglib::log_level::error)
@@ -0,0 +1,218 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#ifdef __NLCGLIB__NUMA
+#include <numa.h>
+#include <numaif.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace nlcglib {
+namespace numa {
+
+/**
+ * NUMA-aware placement of the per k-point data (nlcg_options::numa, requires libnuma).
+ *
+ * The i-th local k-point (position in the sorted key index of an mvector) has the home domain
+ * i % num_domains(). for_each_kpoint pins each k-point task to the cores of a domain and hands
+ * it the k-points of that domain first, s.t. the temporaries allocated by the task are first
+ * touched on the home domain. Buffers filled on the master thread (copies from the host code)
+ * are migrated with place(). Whether a solver run uses it is decided by the caller (see
+ * numa_enabled in thread_budget.hpp). Without libnuma, or on a single domain, all functions are
+ * no-ops.
+ */
+
+/// NUMA support compiled in and more than one memory domain
+inline bool
+available()
+{
+#ifdef __NLCGLIB__NUMA
+  static const bool avail = numa_available() >= 0 && numa_num_configured_nodes() > 1;
+  return avail;
+#else
+  return false;
+#endif
+}
+
+inline int
+num_domains()
+{
+#ifdef __NLCGLIB__NUMA
+  if (available()) return numa_num_configured_nodes();
+#endif
+  return 1;
+}
+
+/// home domain of the i-th local k-point
+inline int
+home_domain(std::size_t i)
+{
+  return static_cast<int>(i % num_domains());
+}
+
+/// domain of the core the calling thread currently runs on
+inline int
+current_domain()
+{
+#ifdef __NLCGLIB__NUMA
+  if (available()) {
+    int cpu = sched_getcpu();
+    int node = cpu < 0 ? -1 : numa_node_of_cpu(cpu);
+    return node < 0 ? 0 : node;
+  }
+#endif
+  return 0;
+}
+
+/// restrict the calling thread to the cores of `domain`, -1 allows all cores again
+inline void
+run_on_domain(int domain)
+{
+#ifdef __NLCGLIB__NUMA
+  if (available()) numa_run_on_node(domain);
+#else
+  (void)domain;
+#endif
+}
+
+/// migrate the pages of [ptr, ptr + bytes) to `domain` (and prefer it for pages not touched yet)
+inline void
+place(const void* ptr, std::size_t bytes, int domain)
+{
+#ifdef __NLCGLIB__NUMA
+  if (!available() || ptr == nullptr || bytes == 0) return;
+  std::uintptr_t page = sysconf(_SC_PAGESIZE);
+  std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(ptr) & ~(page - 1);
+  std::uintptr_t end = reinterpret_cast<std::uintptr_t>(ptr) + bytes;
+  struct bitmask* mask = numa_allocate_nodemask();
+  numa_bitmask_setbit(mask, domain);
+  // best effort, pages shared with other mappings are not moved
+  mbind(reinterpret_cast<void*>(begin), end - begin, MPOL_PREFERRED, mask->maskp, mask->size + 1,
+        MPOL_MF_MOVE);
+  numa_free_nodemask(mask);
+#else
+  (void)ptr;
+  (void)bytes;
+  (void)domain;
+#endif
+}
+
+/**
+ * Count the pages of [ptr, ptr + bytes) which are not on `domain`, every `stride`-th page is
+ * sampled. Adds to `sampled` and `remote`.
+ */
+inline void
+count_remote_pages(const void* ptr,
+                   std::size_t bytes,
+                   int domain,
+                   std::size_t& sampled,
+                   std::size_t& remote,
+                   std::size_t stride = 16)
+{
+#ifdef __NLCGLIB__NUMA
+  if (!available() || ptr == nullptr || bytes == 0) return;
+  std::uintptr_t page = sysconf(_SC_PAGESIZE);
+  std::uintptr_t begin = reinterpret_cast<std::uintptr_t>(ptr) & ~(page - 1);
+  std::uintptr_t end = reinterpret_cast<std::uintptr_t>(ptr) + bytes;
+  std::vector<void*> pages;
+  for (std::uintptr_t p = begin; p < end; p += stride * page) {
+    pages.push_back(reinterpret_cast<void*>(p));
+  }
+  std::vector<int> status(pages.size(), -1);
+  // nodes == nullptr: query the current location of the pages
+  if (move_pages(0, pages.size(), pages.data(), nullptr, status.data(), 0) != 0) return;
+  for (int s : status) {
+    // negative status: page not present (never touched)
+    if (s < 0) continue;
+    sampled++;
+    if (s != domain) remote++;
+  }
+#else
+  (void)ptr;
+  (void)bytes;
+  (void)domain;
+  (void)sampled;
+  (void)remote;
+  (void)stride;
+#endif
+}
+
+/// k-points evaluated by a task on their home domain / on another domain (work stealing)
+struct task_counts
+{
+  std::size_t local{0};
+  std::size_t remote{0};
+};
+
+namespace impl {
+
+/// counts of the solver run on the calling thread, see key_queue::commit
+inline task_counts&
+counts()
+{
+  static thread_local task_counts c;
+  return c;
+}
+
+}  // namespace impl
+
+inline task_counts
+get_task_counts()
+{
+  return impl::counts();
+}
+
+/**
+ * Per-domain work queues of k-point indices [0, n).
+ *
+ * A task pinned to `domain` takes the k-points of its own domain first, then steals from the
+ * other domains; stolen k-points are counted as remote. commit() adds the counts to the task
+ * counts of the calling thread.
+ */
+class key_queue
+{
+public:
+  key_queue(std::size_t n, int ndomains)
+      : n_(n)
+      , ndomains_(ndomains > 0 ? ndomains : 1)
+      , next_(new std::atomic<std::size_t>[ndomains_])
+  {
+    for (int d = 0; d < ndomains_; ++d) next_[d].store(0, std::memory_order_relaxed);
+  }
+
+  /// returns false when all k-points have been handed out
+  bool pop(int domain, std::size_t& i)
+  {
+    for (int k = 0; k < ndomains_; ++k) {
+      int d = (domain + k) % ndomains_;
+      std::size_t j = next_[d]++;
+      i = d + j * ndomains_;
+      if (i < n_) {
+        if (ndomains_ > 1) (k == 0 ? local_ : remote_)++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void commit()
+  {
+    impl::counts().local += local_.load(std::memory_order_relaxed);
+    impl::counts().remote += remote_.load(std::memory_order_relaxed);
+  }
+
+private:
+  std::atomic<std::size_t> local_{0};
+  std::atomic<std::size_t> remote_{0};
+  std::size_t n_;
+  int ndomains_;
+  std::unique_ptr<std::atomic<std::size_t>[]> next_;
+};
+
+}  // namespace numa
+}  // namespace nlcglib
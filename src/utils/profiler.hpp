@@ -0,0 +1,338 @@
+#pragma once
+
+#include <mpi.h>
+#include <Kokkos_Core.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <nlohmann/json.hpp>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "csingleton.hpp"
+
+namespace nlcglib {
+
+/// A completed profiling region.
+struct profile_event
+{
+  std::string name;
+  /// names of the enclosing regions (same thread), separated by '/'
+  std::string path;
+  double ts_us;
+  double dur_us;
+  int tid;
+  /// k-point index (ik, ispn), (-1, -1) if the region is not k-point local
+  std::pair<int, int> key;
+};
+
+/**
+ * Collects timing regions of all threads of this rank.
+ *
+ * Enabled by setting NLCGLIB_PROFILE=<prefix> (or by enable()), write() gathers
+ * the events of all ranks and writes <prefix>.trace.json (Chrome-trace / Perfetto)
+ * and <prefix>.flat.txt (flat profile aggregated over ranks and threads).
+ * At most max_events() events are kept per rank, further events are counted as dropped.
+ */
+class Profiler : public CSingleton<Profiler>
+{
+public:
+  typedef std::chrono::steady_clock clock_t;
+
+  /// bits of state()
+  enum : int
+  {
+    /// NLCGLIB_PROFILE and the Kokkos Tools have not been checked yet
+    unknown = -1,
+    recording = 1,
+    kokkos_tools = 2
+  };
+
+  Profiler()
+      : epoch_(clock_t::now())
+  {
+    state().store(Kokkos::Profiling::profileLibraryLoaded() ? int{kokkos_tools} : 0);
+    char* prefix = std::getenv("NLCGLIB_PROFILE");
+    if (prefix != nullptr && std::string(prefix) != "0") {
+      this->enable(std::string(prefix) == "1" ? std::string("nlcg_profile") : std::string(prefix));
+    }
+  }
+
+  /**
+   * recording | kokkos_tools, read by profile_region without touching the singleton.
+   * Constant-initialized, the Profiler sets it on construction (i.e. on the first region).
+   */
+  static std::atomic<int>& state()
+  {
+    static std::atomic<int> state_{unknown};
+    return state_;
+  }
+
+  bool enabled() const { return state().load(std::memory_order_relaxed) & recording; }
+
+  void enable(const std::string& prefix = "nlcg_profile")
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    prefix_ = prefix;
+    state().fetch_or(recording, std::memory_order_relaxed);
+  }
+
+  void disable() { state().fetch_and(~recording, std::memory_order_relaxed); }
+
+  std::size_t max_events() const { return max_events_; }
+  void set_max_events(std::size_t max_events)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    max_events_ = max_events;
+  }
+
+  /// events not recorded since the last write() because of max_events()
+  std::size_t dropped() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+  }
+
+  std::size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_.size();
+  }
+
+  double now_us() const
+  {
+    return std::chrono::duration<double, std::micro>(clock_t::now() - epoch_).count();
+  }
+
+  void record(profile_event&& event, std::thread::id thread)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (events_.size() >= max_events_) {
+      dropped_++;
+      return;
+    }
+    auto it = tids_.find(thread);
+    if (it == tids_.end()) it = tids_.emplace(thread, static_cast<int>(tids_.size())).first;
+    event.tid = it->second;
+    events_.push_back(std::move(event));
+  }
+
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    events_.clear();
+    dropped_ = 0;
+  }
+
+  /// gathers the events of all ranks of comm (collective), rank 0 writes the files if `output`
+  void write(MPI_Comm comm, bool output = true);
+
+private:
+  std::string prefix_{"nlcg_profile"};
+  clock_t::time_point epoch_;
+  mutable std::mutex mutex_;
+  std::vector<profile_event> events_;
+  std::size_t max_events_{1 << 20};
+  std::size_t dropped_{0};
+  std::map<std::thread::id, int> tids_;
+};
+
+inline void
+Profiler::write(MPI_Comm comm, bool output)
+{
+  if (!this->enabled()) return;
+
+  int rank, nranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nranks);
+
+  std::string local;
+  long dropped;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    nlohmann::json jevents = nlohmann::json::array();
+    for (auto& e : events_) {
+      jevents.push_back({e.name, e.path, e.ts_us, e.dur_us, e.tid, e.key.first, e.key.second});
+    }
+    local = jevents.dump();
+    events_.clear();
+    dropped = static_cast<long>(dropped_);
+    dropped_ = 0;
+  }
+  MPI_Reduce(rank == 0 ? MPI_IN_PLACE : &dropped, &dropped, 1, MPI_LONG, MPI_SUM, 0, comm);
+
+  int len = local.size();
+  std::vector<int> lens(nranks);
+  MPI_Gather(&len, 1, MPI_INT, lens.data(), 1, MPI_INT, 0, comm);
+  std::vector<int> displs(nranks + 1, 0);
+  for (int i = 0; i < nranks; ++i) displs[i + 1] = displs[i] + lens[i];
+  std::vector<char> buffer(rank == 0 ? displs[nranks] : 0);
+  MPI_Gatherv(local.data(), len, MPI_CHAR, buffer.data(), lens.data(), displs.data(), MPI_CHAR, 0,
+              comm);
+  if (rank != 0 || !output) return;
+
+  struct flat_entry
+  {
+    int calls{0};
+    double total{0};
+    double min{std::numeric_limits<double>::max()};
+    double max{0};
+  };
+  std::map<std::string, flat_entry> flat;
+
+  nlohmann::json trace;
+  trace["displayTimeUnit"] = "ms";
+  trace["traceEvents"] = nlohmann::json::array();
+  for (int r = 0; r < nranks; ++r) {
+    auto jevents =
+        nlohmann::json::parse(buffer.begin() + displs[r], buffer.begin() + displs[r + 1]);
+    for (auto& e : jevents) {
+      nlohmann::json entry;
+      entry["name"] = e[0];
+      entry["cat"] = "nlcglib";
+      entry["ph"] = "X";
+      entry["ts"] = e[2];
+      entry["dur"] = e[3];
+      entry["pid"] = r;
+      entry["tid"] = e[4];
+      entry["args"]["path"] = e[1];
+      if (e[5].get<int>() >= 0) {
+        entry["args"]["ik"] = e[5];
+        entry["args"]["ispn"] = e[6];
+      }
+      trace["traceEvents"].push_back(entry);
+
+      auto& fe = flat[e[1].get<std::string>()];
+      double dur = e[3].get<double>() * 1e-6;
+      fe.calls++;
+      fe.total += dur;
+      fe.min = std::min(fe.min, dur);
+      fe.max = std::max(fe.max, dur);
+    }
+  }
+
+  std::ofstream ftrace(prefix_ + ".trace.json");
+  ftrace << trace;
+
+  std::vector<std::pair<std::string, flat_entry>> sorted(flat.begin(), flat.end());
+  std::sort(sorted.begin(), sorted.end(),
+            [](auto& a, auto& b) { return a.second.total > b.second.total; });
+  std::ofstream fflat(prefix_ + ".flat.txt");
+  fflat << "# flat profile over " << nranks << " rank(s), times in seconds\n";
+  if (dropped > 0) fflat << "# " << dropped << " events dropped (max_events)\n";
+  fflat
+        << std::left << std::setw(60) << "# region" << std::right << std::setw(10) << "calls"
+        << std::setw(15) << "total" << std::setw(15) << "mean" << std::setw(15) << "min"
+        << std::setw(15) << "max"
+        << "\n";
+  for (auto& entry : sorted) {
+    auto& fe = entry.second;
+    fflat << std::left << std::setw(60) << entry.first << std::right << std::setw(10) << fe.calls
+          << std::scientific << std::setprecision(4) << std::setw(15) << fe.total << std::setw(15)
+          << fe.total / fe.calls << std::setw(15) << fe.min << std::setw(15) << fe.max << "\n";
+  }
+}
+
+/**
+ * Scoped timing region.
+ *
+ * Recorded if the Profiler is enabled, forwarded to Kokkos Tools if a tool was loaded
+ * (checked once, on the first region). Otherwise the cost is a relaxed atomic load and a branch.
+ */
+class profile_region
+{
+public:
+  explicit profile_region(const char* name, std::pair<int, int> key = std::make_pair(-1, -1))
+      : name_(name)
+      , key_(key)
+  {
+    int state = Profiler::state().load(std::memory_order_relaxed);
+    if (state == 0) return;
+    if (state == Profiler::unknown) {
+      Profiler::GetInstance();
+      state = Profiler::state().load(std::memory_order_relaxed);
+    }
+    record_ = state & Profiler::recording;
+    kokkos_ = state & Profiler::kokkos_tools;
+    if (record_) {
+      stack().push_back(name_);
+      t0_ = Profiler::GetInstance().now_us();
+    }
+    if (kokkos_) Kokkos::Profiling::pushRegion(name_);
+  }
+
+  profile_region(const profile_region&) = delete;
+  profile_region& operator=(const profile_region&) = delete;
+
+  ~profile_region()
+  {
+    if (kokkos_) Kokkos::Profiling::popRegion();
+    if (record_) {
+      auto& profiler = Profiler::GetInstance();
+      double t1 = profiler.now_us();
+      auto& s = stack();
+      std::string path;
+      for (auto* n : s) {
+        if (!path.empty()) path += "/";
+        path += n;
+      }
+      s.pop_back();
+      profiler.record(profile_event{name_, path, t0_, t1 - t0_, 0, key_}, std::this_thread::get_id());
+    }
+  }
+
+private:
+  static std::vector<const char*>& stack()
+  {
+    static thread_local std::vector<const char*> stack_;
+    return stack_;
+  }
+
+  const char* name_;
+  std::pair<int, int> key_;
+  bool record_{false};
+  bool kokkos_{false};
+  double t0_{0};
+};
+
+/// Writes the profile when leaving the scope (skipped during stack unwinding).
+class profile_output_guard
+{
+public:
+  explicit profile_output_guard(MPI_Comm comm, bool output = true)
+      : comm_(comm)
+      , output_(output)
+  {
+  }
+
+  ~profile_output_guard()
+  {
+    if (!std::uncaught_exception()) Profiler::GetInstance().write(comm_, output_);
+  }
+
+private:
+  MPI_Comm comm_;
+  bool output_;
+};
+
+}  // namespace nlcglib
+
+#define NLCGLIB_PROFILE_CONCAT_(a, b) a##b
+#define NLCGLIB_PROFILE_CONCAT(a, b) NLCGLIB_PROFILE_CONCAT_(a, b)
+
+/// scoped profiling region, NLCGLIB_PROFILE_REGION("name") or NLCGLIB_PROFILE_REGION("name", key)
+#ifdef NLCGLIB_DISABLE_PROFILING
+#define NLCGLIB_PROFILE_REGION(...)
+#else
+#define NLCGLIB_PROFILE_REGION(...) \
+  ::nlcglib::profile_region NLCGLIB_PROFILE_CONCAT(nlcglib_profile_region_, __LINE__)(__VA_ARGS__)
+#endif
@@ -2,11 +2,13 @@
 
 #include <nlohmann/json.hpp>
 #include <Kokkos_Complex.hpp>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <type_traits>
-#include <type_traits>
 #include "la/mvector.hpp"
+#include "mpi/communicator.hpp"
+#include "utils/async_writer.hpp"
 
 namespace Kokkos {
 
@@ -21,7 +23,13 @@ to_json(nlohmann::json& j, const Kokkos::complex<T>& p)
 
 namespace nlcglib {
 
-/// Store CG information in json.
+/**
+ * Store CG information in json.
+ *
+ * Each step is one line (newline-delimited json). If a writer is given, the
+ * record is handed over to its background thread, otherwise it is appended to
+ * fname synchronously.
+ */
 class StepLogger
 {
 public:
@@ -32,6 +40,14 @@ public:
     dict["step"] = i;
   }
 
+  /// active iff writer is not null (i.e. on the writing rank)
+  StepLogger(int i, async_record_writer* writer)
+      : i(i), active(writer != nullptr), writer(writer)
+  {
+    dict["type"] = "cg_iteration";
+    dict["step"] = i;
+  }
+
   template<class X>
   std::enable_if_t<std::is_scalar<std::remove_reference_t<X>>::value> log(const std::string& key, X&& x);
 
@@ -41,19 +57,30 @@ public:
   template<class V>
   void log(const std::string& key, const mvector<V>& x);
 
+  /// collective on comm: gathers the entries of all ranks to rank 0 (the writing rank)
+  template <class V>
+  void log(const std::string& key, const mvector<V>& x, const Communicator& comm);
+
   ~StepLogger()
   {
-    if(active) {
-      std::ofstream fout(std::string("nlcg") + ".json", std::ios_base::app);
-      fout << dict;
-      fout.flush();
+    if(!active) return;
+    std::string record = dict.dump() + "\n";
+    if (writer) {
+      writer->push(std::move(record));
+    } else {
+      std::ofstream fout(fname, std::ios_base::app);
+      fout << record;
     }
   }
 
 private:
+  template <class V>
+  static nlohmann::json to_entries(const mvector<V>& x);
+
   int i;
   std::string fname{"nlcg.json"};
   bool active;
+  async_record_writer* writer{nullptr};
   nlohmann::json dict;
 };
 
@@ -77,6 +104,30 @@ void
 StepLogger::log(const std::string& key, const mvector<V>& x)
 {
   if(!active) return;
+  for (auto& entry : to_entries(x)) {
+    dict[key] += entry;
+  }
+}
+
+template <class V>
+void
+StepLogger::log(const std::string& key, const mvector<V>& x, const Communicator& comm)
+{
+  std::string local = to_entries(x).dump();
+  auto all = comm.gather(std::vector<char>(local.begin(), local.end()), 0);
+  if (!active) return;
+  for (auto& buf : all) {
+    for (auto& entry : nlohmann::json::parse(buf.begin(), buf.end())) {
+      dict[key] += entry;
+    }
+  }
+}
+
+template <class V>
+nlohmann::json
+StepLogger::to_entries(const mvector<V>& x)
+{
+  nlohmann::json entries = nlohmann::json::array();
   // assuming V is a 1-d kokkos array
   for (auto& elem : x) {
     auto x_key = elem.first;
@@ -88,8 +139,9 @@ StepLogger::log(const std::string& key, const mvector<V>& x)
     entry["ik"] = x_key.first;
     entry["ispn"] = x_key.second;
     entry["value"] = v;
-    dict[key] += entry;
+    entries.push_back(entry);
   }
+  return entries;
 }
 
 }  // namespace nlcglib
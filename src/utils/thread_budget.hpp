@@ -0,0 +1,359 @@
+#pragma once
+
+#include <Kokkos_Core.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <utility>
+#ifdef __USE_OPENMP
+#include <omp.h>
+#endif
+#if defined(__USE_MKL)
+#include <mkl.h>
+#elif defined(__USE_OPENBLAS)
+#include <cblas.h>
+#endif
+#include "utils/logger.hpp"
+#include "utils/numa.hpp"
+
+namespace nlcglib {
+
+/// k-points evaluated at once and BLAS threads given to each of them (Kokkos kernels of a task
+/// run serially on its thread, see for_each_kpoint)
+struct thread_partition
+{
+  int tasks{1};
+  int threads_per_task{1};
+  /// NUMA-aware placement and pinning of the tasks (nlcg_options::numa), see numa.hpp
+  bool numa{false};
+};
+
+/// threads available on this rank
+inline int
+available_threads()
+{
+#ifdef __USE_OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+/**
+ * Split `total` threads between k-points.
+ *
+ * The per k-point cost is dominated by the n x nb x nb complex GEMMs (overlaps, rotations). Each
+ * thread should get at least `min_work_per_thread` flops, remaining threads are used to run
+ * k-points concurrently. With `concurrent == false` (e.g. k-points own distributed matrices and
+ * issue collectives) the k-points are evaluated one after the other.
+ * Positive entries of `overrides` (nlcg_options::kpoint_tasks, threads_per_task) replace
+ * the choice, its numa flag is passed on.
+ */
+inline thread_partition
+partition_threads(int total,
+                  int num_kpoints,
+                  std::size_t n,
+                  std::size_t nb,
+                  bool concurrent = true,
+                  thread_partition overrides = thread_partition{0, 0})
+{
+  const double min_work_per_thread = 5e7;
+  total = std::max(total, 1);
+  int max_tasks = concurrent ? std::max(num_kpoints, 1) : 1;
+
+  double work = 8.0 * n * nb * nb;
+  int wanted = static_cast<int>(std::min<double>(std::ceil(work / min_work_per_thread), total));
+  wanted = std::max(wanted, 1);
+
+  thread_partition p;
+  p.numa = overrides.numa;
+  p.tasks = std::min(std::max(total / wanted, 1), max_tasks);
+  if (overrides.tasks > 0) p.tasks = std::min(overrides.tasks, max_tasks);
+  p.threads_per_task = std::max(total / p.tasks, 1);
+  if (p.tasks == 1) p.threads_per_task = wanted;
+  if (overrides.threads_per_task > 0) p.threads_per_task = overrides.threads_per_task;
+  return p;
+}
+
+namespace thread_budget_impl {
+
+/// the partition belongs to the thread running the solver, concurrent solver runs (threads)
+/// each have their own
+inline int&
+tasks()
+{
+  static thread_local int tasks{1};
+  return tasks;
+}
+
+inline int&
+threads_per_task()
+{
+  static thread_local int threads{0};
+  return threads;
+}
+
+inline bool&
+numa()
+{
+  static thread_local bool numa{false};
+  return numa;
+}
+
+/// true on threads which are running a k-point task
+inline bool&
+in_task()
+{
+  static thread_local bool in_task{false};
+  return in_task;
+}
+
+}  // namespace thread_budget_impl
+
+/// partition used by for_each_kpoint, threads_per_task == 0 means all threads
+inline thread_partition
+current_thread_partition()
+{
+  thread_partition p;
+  p.tasks = thread_budget_impl::tasks();
+  p.threads_per_task = thread_budget_impl::threads_per_task();
+  p.numa = thread_budget_impl::numa();
+  return p;
+}
+
+/// sets the partition for the lifetime of the guard
+class thread_partition_guard
+{
+public:
+  explicit thread_partition_guard(thread_partition p)
+      : prev_(current_thread_partition())
+  {
+    set(p);
+  }
+
+  ~thread_partition_guard() { set(prev_); }
+
+  thread_partition_guard(const thread_partition_guard&) = delete;
+  thread_partition_guard& operator=(const thread_partition_guard&) = delete;
+
+private:
+  static void set(thread_partition p)
+  {
+    thread_budget_impl::tasks() = std::max(p.tasks, 1);
+    thread_budget_impl::threads_per_task() = std::max(p.threads_per_task, 0);
+    thread_budget_impl::numa() = p.numa;
+  }
+
+  thread_partition prev_;
+};
+
+/**
+ * Number of BLAS threads of the calling thread for the lifetime of the scope.
+ *
+ * MKL only (mkl_set_num_threads_local). OpenBLAS has a process-wide setting only, see
+ * blas_process_threads_scope.
+ */
+class blas_threads_scope
+{
+public:
+  explicit blas_threads_scope(int n)
+  {
+    if (n <= 0) return;
+#if defined(__USE_MKL)
+    prev_ = mkl_set_num_threads_local(n);
+    active_ = true;
+#endif
+  }
+
+  ~blas_threads_scope()
+  {
+    if (!active_) return;
+#if defined(__USE_MKL)
+    // 0 restores the global setting
+    mkl_set_num_threads_local(prev_);
+#endif
+  }
+
+  blas_threads_scope(const blas_threads_scope&) = delete;
+  blas_threads_scope& operator=(const blas_threads_scope&) = delete;
+
+private:
+  int prev_{0};
+  bool active_{false};
+};
+
+namespace thread_budget_impl {
+
+/// OpenBLAS thread count held by the solver runs of the process
+struct blas_process_threads
+{
+  std::mutex mutex;
+  int users{0};
+  int prev{0};
+};
+
+inline blas_process_threads&
+blas_process_state()
+{
+  static blas_process_threads state;
+  return state;
+}
+
+}  // namespace thread_budget_impl
+
+/**
+ * Process-wide number of BLAS threads while a solver run is active (OpenBLAS only,
+ * openblas_set_num_threads). The first run sets the value and the last one restores the
+ * previous setting, concurrent runs share the value of the first one.
+ *
+ * OpenBLAS (OpenMP build) runs single-threaded inside the parallel region of concurrent k-point
+ * tasks, the setting applies to k-points evaluated one after the other.
+ */
+class blas_process_threads_scope
+{
+public:
+  explicit blas_process_threads_scope(int n)
+  {
+    if (n <= 0) return;
+#if defined(__USE_OPENBLAS)
+    auto& state = thread_budget_impl::blas_process_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (state.users++ == 0) {
+      state.prev = openblas_get_num_threads();
+      openblas_set_num_threads(n);
+    }
+    active_ = true;
+#endif
+  }
+
+  ~blas_process_threads_scope()
+  {
+    if (!active_) return;
+#if defined(__USE_OPENBLAS)
+    auto& state = thread_budget_impl::blas_process_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (--state.users == 0) openblas_set_num_threads(state.prev);
+#endif
+  }
+
+  blas_process_threads_scope(const blas_process_threads_scope&) = delete;
+  blas_process_threads_scope& operator=(const blas_process_threads_scope&) = delete;
+
+private:
+  bool active_{false};
+};
+
+/// true if for_each_kpoint evaluates the k-points in concurrent tasks on the calling thread
+inline bool
+kpoint_tasks_concurrent()
+{
+#ifdef __USE_OPENMP
+  auto p = current_thread_partition();
+  return p.tasks > 1 && p.threads_per_task > 0 && !thread_budget_impl::in_task();
+#else
+  return false;
+#endif
+}
+
+/// NUMA-aware mode of the solver run on the calling thread: requested and available
+inline bool
+numa_enabled()
+{
+  return thread_budget_impl::numa() && numa::available();
+}
+
+namespace thread_budget_impl {
+
+/// logs once per process that k-points are evaluated sequentially although tasks > 1 was asked for
+inline void
+warn_sequential(const char* reason)
+{
+  static std::atomic<bool> warned{false};
+  if (warned.exchange(true)) return;
+  NLCGLIB_LOG_WARNING << "for_each_kpoint: " << reason
+                      << ", the k-point tasks are evaluated sequentially\n";
+}
+
+/// pops k-points of `domain` (others when done) and calls f, the first exception is kept
+template <class F>
+void
+run_kpoint_task(int domain,
+                numa::key_queue& next,
+                F& f,
+                std::mutex& error_mutex,
+                std::exception_ptr& error)
+{
+  in_task() = true;
+  std::size_t i;
+  while (next.pop(domain, i)) {
+    try {
+      f(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(error_mutex);
+      if (!error) error = std::current_exception();
+    }
+  }
+  in_task() = false;
+}
+
+}  // namespace thread_budget_impl
+
+/**
+ * Calls f(i) for i in [0, n) using the current thread partition.
+ *
+ * The k-points are handed out to `tasks` concurrent tasks, each task picks the next index. The
+ * tasks are the threads of an OpenMP parallel region: Kokkos kernels issued by f (Kokkos::OpenMP
+ * and Serial) run serially on the task's thread, the host space kernels are not split further.
+ * BLAS calls use `threads_per_task` threads if the library supports a per-thread setting with
+ * nested parallelism (MKL), OpenBLAS runs them single-threaded. Concurrent solver runs of the
+ * process (threads) each get their own tasks.
+ * Nested calls run sequentially, builds without OpenMP log a warning and run sequentially.
+ * The first exception thrown by f is rethrown after all tasks finished.
+ * In NUMA-aware mode (numa_enabled) task j is pinned to domain j % numa::num_domains() and
+ * takes the k-points with that home domain first.
+ * The tasks log to the logger of the calling thread.
+ */
+template <class F>
+void
+for_each_kpoint(std::size_t n, F&& f)
+{
+  auto p = current_thread_partition();
+  if (n == 0) return;
+  int num_tasks = static_cast<int>(std::min<std::size_t>(p.tasks, n));
+  if (thread_budget_impl::in_task() || p.threads_per_task == 0) {
+    for (std::size_t i = 0; i < n; ++i) f(i);
+    return;
+  }
+
+  blas_threads_scope blas_threads(p.threads_per_task);
+#ifdef __USE_OPENMP
+  if (num_tasks > 1 && !omp_in_parallel()) {
+    const bool pin = numa_enabled();
+    int ndomains = pin ? numa::num_domains() : 1;
+    numa::key_queue next(n, ndomains);
+    Logger* logger = Logger::current();
+    std::mutex error_mutex;
+    std::exception_ptr error;
+#pragma omp parallel num_threads(num_tasks)
+    {
+      logger_scope log(logger);
+      blas_threads_scope local_blas_threads(p.threads_per_task);
+      int domain = omp_get_thread_num() % ndomains;
+      if (pin) numa::run_on_domain(domain);
+      thread_budget_impl::run_kpoint_task(domain, next, f, error_mutex, error);
+      if (pin) numa::run_on_domain(-1);
+    }
+    next.commit();
+    if (error) std::rethrow_exception(error);
+    return;
+  }
+#else
+  if (num_tasks > 1) thread_budget_impl::warn_sequential("built without OpenMP");
+#endif
+  for (std::size_t i = 0; i < n; ++i) f(i);
+}
+
+}  // namespace nlcglib
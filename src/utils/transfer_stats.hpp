@@ -0,0 +1,218 @@
+#pragma once
+
+#include <Kokkos_Core.hpp>
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include "la/dvector.hpp"
+
+namespace nlcglib {
+
+struct transfer_count
+{
+  std::size_t calls{0};
+  std::size_t bytes{0};
+};
+
+/**
+ * Copies of the CG state between the host and the execution space, per phase.
+ *
+ * A copy is recorded wherever the solver moves data between host and execution space,
+ * independent of whether the two coincide: on a CPU-only build the host stands in for the
+ * device and the counts are the ones a device build would see. Thread safe, records are made
+ * from the k-point threads.
+ */
+class transfer_stats
+{
+public:
+  void record(const std::string& phase, std::size_t bytes)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& c = counts_[phase];
+    c.calls++;
+    c.bytes += bytes;
+  }
+
+  std::map<std::string, transfer_count> counts() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return counts_;
+  }
+
+  transfer_count total() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    transfer_count t;
+    for (auto& c : counts_) {
+      t.calls += c.second.calls;
+      t.bytes += c.second.bytes;
+    }
+    return t;
+  }
+
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    counts_.clear();
+  }
+
+private:
+  mutable std::mutex mutex_;
+  std::map<std::string, transfer_count> counts_;
+};
+
+template <class T, class... ARGS>
+std::size_t
+num_bytes(const Kokkos::View<T, ARGS...>& x)
+{
+  return x.span() * sizeof(typename Kokkos::View<T, ARGS...>::value_type);
+}
+
+template <class T, class LAYOUT, class... ARGS>
+std::size_t
+num_bytes(const KokkosDVector<T, LAYOUT, ARGS...>& x)
+{
+  return num_bytes(x.array());
+}
+
+/// create_mirror_view_and_copy, recorded under `phase` (stats may be nullptr)
+template <class Space, class T, class LAYOUT, class... ARGS>
+auto
+counted_mirror(const Space& space,
+               const KokkosDVector<T, LAYOUT, ARGS...>& x,
+               const char* phase,
+               transfer_stats* stats)
+{
+  if (stats) stats->record(phase, num_bytes(x));
+  return create_mirror_view_and_copy(space, x);
+}
+
+template <class Space, class T, class... ARGS>
+auto
+counted_mirror(const Space& space,
+               const Kokkos::View<T, ARGS...>& x,
+               const char* phase,
+               transfer_stats* stats)
+{
+  if (stats) stats->record(phase, num_bytes(x));
+  return Kokkos::create_mirror_view_and_copy(space, x);
+}
+
+/**
+ * Copies x to the execution space unless it is resident there already.
+ *
+ * RESIDENT is a property of the caller's state, not of the types: on a CPU-only build host
+ * and execution space coincide and both variants are no-ops apart from the accounting.
+ */
+template <bool RESIDENT, class Space, class X>
+auto
+to_exec_space(const Space& space, const X& x, const char* phase, transfer_stats* stats)
+{
+  if (RESIDENT) stats = nullptr;
+  return counted_mirror(space, x, phase, stats);
+}
+
+/**
+ * Execution space copies of host buffers, shared by the descent direction and the geodesic of
+ * one iteration (non-resident runs): operator results cached for a copy (S X, see
+ * applicator_cache) are found by both, and the line search trials copy X, eta and Z once.
+ *
+ * An entry keeps its host buffer alive, s.t. the address is not reused for other data. The host
+ * buffers must not be modified in-place while they are cached, clear() when they change (next
+ * iteration). Thread safe.
+ */
+class exec_space_mirrors
+{
+public:
+  /// copy of x in `space` (counted_mirror), made on the first call for x
+  template <class Space, class X>
+  auto get(const Space& space, const X& x, const char* phase, transfer_stats* stats)
+  {
+    using mirror_t = decltype(counted_mirror(space, x, phase, stats));
+    const void* data = x.array().data();
+    std::size_t size = num_bytes(x);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& e : entries_) {
+        if (e.data == data && e.size == size && e.type == std::type_index(typeid(mirror_t))) {
+          return *static_cast<const mirror_t*>(e.mirror.get());
+        }
+      }
+    }
+    auto y = counted_mirror(space, x, phase, stats);
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.push_back(entry{data,
+                             size,
+                             std::type_index(typeid(mirror_t)),
+                             std::make_shared<X>(x),
+                             std::make_shared<mirror_t>(y)});
+    return y;
+  }
+
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+  }
+
+private:
+  struct entry
+  {
+    const void* data;
+    std::size_t size;
+    std::type_index type;
+    std::shared_ptr<void> host;
+    std::shared_ptr<void> mirror;
+  };
+
+  std::mutex mutex_;
+  std::list<entry> entries_;
+};
+
+/// to_exec_space, non-resident copies are shared through `mirrors` (may be nullptr)
+template <bool RESIDENT, class Space, class X>
+auto
+to_exec_space(const Space& space,
+              const X& x,
+              const char* phase,
+              transfer_stats* stats,
+              exec_space_mirrors* mirrors)
+{
+  if (RESIDENT || mirrors == nullptr) return to_exec_space<RESIDENT>(space, x, phase, stats);
+  return mirrors->get(space, x, phase, stats);
+}
+
+namespace transfer_impl {
+
+template <class X>
+X
+from_exec_space(const X& x, const char*, transfer_stats*, std::true_type /* resident */)
+{
+  return x;
+}
+
+template <class X>
+auto
+from_exec_space(const X& x, const char* phase, transfer_stats* stats, std::false_type /* resident */)
+{
+  return counted_mirror(Kokkos::HostSpace(), x, phase, stats);
+}
+
+}  // namespace transfer_impl
+
+/// Counterpart of to_exec_space for results: copied to the host unless RESIDENT.
+template <bool RESIDENT, class X>
+auto
+from_exec_space(const X& x, const char* phase, transfer_stats* stats)
+{
+  return transfer_impl::from_exec_space(x, phase, stats, std::integral_constant<bool, RESIDENT>{});
+}
+
+}  // namespace nlcglib
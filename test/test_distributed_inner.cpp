@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include "la/dvector.hpp"
+#include "la/lapack.hpp"
+
+#include <mpi.h>
+#include <random>
+
+using namespace nlcglib;
+
+typedef std::complex<double> complex_double;
+using matrix_t = KokkosDVector<complex_double**, SlabLayoutV, Kokkos::LayoutLeft, Kokkos::HostSpace>;
+
+/// row-distributed X over MPI_COMM_WORLD compared with the serial result of the full matrix
+class DistributedInner : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    Communicator comm(MPI_COMM_WORLD);
+    rank = comm.rank();
+    int nrows = comm.size() * nrows_loc;
+
+    // full matrix, identical on all ranks
+    X = matrix_t(Map<>(Communicator(), SlabLayoutV({{0, 0, nrows, ncols}})));
+    std::uniform_real_distribution<double> unif01(0, 1);
+    std::mt19937 gen(0);
+    for (int j = 0; j < ncols; ++j) {
+      for (int i = 0; i < nrows; ++i) {
+        X.array()(i, j) = Kokkos::complex<double>(unif01(gen), unif01(gen));
+      }
+    }
+
+    // row slab of X owned by this rank
+    X_loc = matrix_t(Map<>(comm, SlabLayoutV({{rank * nrows_loc, 0, nrows_loc, ncols}})));
+    for (int j = 0; j < ncols; ++j) {
+      for (int i = 0; i < nrows_loc; ++i) {
+        X_loc.array()(i, j) = X.array()(rank * nrows_loc + i, j);
+      }
+    }
+  }
+
+  const int ncols{20};
+  const int nrows_loc{100};
+  const double tol{1e-10};
+  int rank{0};
+  matrix_t X;
+  matrix_t X_loc;
+};
+
+TEST_F(DistributedInner, inner)
+{
+  auto H_ref = inner_()(X, X);
+  auto H = inner_()(X_loc, X_loc);
+  for (int i = 0; i < ncols; ++i) {
+    for (int j = 0; j < ncols; ++j) {
+      EXPECT_NEAR(Kokkos::abs(H.array()(i, j) - H_ref.array()(i, j)), 0, tol);
+    }
+  }
+}
+
+TEST_F(DistributedInner, inner_beta)
+{
+  // C <- alpha X^H X + beta C, beta * C must be added once, not once per rank
+  matrix_t C(Map<>(Communicator(), SlabLayoutV({{0, 0, ncols, ncols}})));
+  matrix_t C_ref(Map<>(Communicator(), SlabLayoutV({{0, 0, ncols, ncols}})));
+  for (int j = 0; j < ncols; ++j) {
+    for (int i = 0; i < ncols; ++i) {
+      C.array()(i, j) = Kokkos::complex<double>(i, j);
+      C_ref.array()(i, j) = Kokkos::complex<double>(i, j);
+    }
+  }
+  inner(C_ref, X, X, complex_double{2.0}, complex_double{0.5});
+  inner(C, X_loc, X_loc, complex_double{2.0}, complex_double{0.5});
+  for (int i = 0; i < ncols; ++i) {
+    for (int j = 0; j < ncols; ++j) {
+      EXPECT_NEAR(Kokkos::abs(C.array()(i, j) - C_ref.array()(i, j)), 0, tol);
+    }
+  }
+}
+
+TEST_F(DistributedInner, transform)
+{
+  // rotation of the distributed matrix is a local operation
+  auto H = inner_()(X, X);
+  auto XH = transform_alloc(X_loc, H);
+  auto XH_ref = transform_alloc(X, H);
+  for (int j = 0; j < ncols; ++j) {
+    for (int i = 0; i < nrows_loc; ++i) {
+      EXPECT_NEAR(Kokkos::abs(XH.array()(i, j) - XH_ref.array()(rank * nrows_loc + i, j)), 0, tol);
+    }
+  }
+}
+
+TEST_F(DistributedInner, innerh_tr)
+{
+  auto tr_ref = innerh_tr()(X, X);
+  auto tr = innerh_tr()(X_loc, X_loc);
+  EXPECT_NEAR(Kokkos::abs(tr - tr_ref) / Kokkos::abs(tr_ref), 0, tol);
+}
+
+TEST_F(DistributedInner, different_communicators)
+{
+  Communicator comm(MPI_COMM_WORLD);
+  MPI_Comm dup;
+  MPI_Comm_dup(MPI_COMM_WORLD, &dup);
+  {
+    // same group, but a different communicator is accepted
+    matrix_t Y(Map<>(Communicator(dup), SlabLayoutV({{rank * nrows_loc, 0, nrows_loc, ncols}})));
+    EXPECT_NO_THROW(inner_()(X_loc, Y));
+  }
+  MPI_Comm_free(&dup);
+
+  if (comm.size() > 1) {
+    // X distributed over the ranks, Y local to each rank
+    matrix_t Y(Map<>(Communicator(), SlabLayoutV({{0, 0, nrows_loc, ncols}})));
+    EXPECT_THROW(inner_()(X_loc, Y), std::runtime_error);
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  Communicator::init(argc, argv);
+  Kokkos::initialize();
+  ::testing::InitGoogleTest(&argc, argv);
+
+  int result = RUN_ALL_TESTS();
+
+  Kokkos::finalize();
+  Communicator::finalize();
+  return result;
+}
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+#include "la/dvector.hpp"
+#include "la/lapack.hpp"
+
+#include <mpi.h>
+#include <cstdlib>
+#include <random>
+
+using namespace nlcglib;
+
+typedef std::complex<double> complex_double;
+using matrix_t = KokkosDVector<complex_double**, SlabLayoutV, Kokkos::LayoutLeft, Kokkos::HostSpace>;
+
+/// the dense solvers on MPI_COMM_WORLD take the ScaLAPACK path, compared with LAPACK
+class ScalapackSolver : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    // hermitian positive definite, identical on all ranks
+    S = make_matrix();
+    std::uniform_real_distribution<double> unif01(-1, 1);
+    std::mt19937 gen(0);
+    for (int j = 0; j < n; ++j) {
+      for (int i = 0; i <= j; ++i) {
+        Kokkos::complex<double> z(unif01(gen), i == j ? 0 : unif01(gen));
+        if (i == j) z += n;
+        S.array()(i, j) = z;
+        S.array()(j, i) = Kokkos::conj(z);
+      }
+    }
+  }
+
+  matrix_t make_matrix() const
+  {
+    return matrix_t(Map<>(Communicator(), SlabLayoutV({{0, 0, n, n}})));
+  }
+
+  const int n{70};
+  const double tol{1e-10};
+  Communicator comm{MPI_COMM_WORLD};
+  matrix_t S;
+};
+
+TEST_F(ScalapackSolver, backend)
+{
+  auto expected = comm.size() > 1 ? dense_backend::scalapack : dense_backend::lapack;
+  EXPECT_EQ(select_dense_backend(n, comm), expected);
+}
+
+TEST_F(ScalapackSolver, grid_is_cached)
+{
+  if (comm.size() == 1) GTEST_SKIP();
+  const auto* grids = &scalapack::get_blacs_grids(comm);
+  EXPECT_EQ(grids, &scalapack::get_blacs_grids(comm));
+  EXPECT_EQ(grids->full.nprow() * grids->full.npcol(), comm.size());
+  EXPECT_EQ(grids->root.context() >= 0, comm.rank() == 0);
+}
+
+TEST_F(ScalapackSolver, eigh)
+{
+  auto U = make_matrix();
+  auto U_ref = make_matrix();
+  Kokkos::View<double*, Kokkos::HostSpace> w("w", n);
+  Kokkos::View<double*, Kokkos::HostSpace> w_ref("w_ref", n);
+  eigh(U, w, S, comm);
+  eigh(U_ref, w_ref, S);
+
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(w(i), w_ref(i), tol * n);
+  }
+  // S U = U diag(w), the eigenvectors are unique up to a phase only
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < n; ++i) {
+      Kokkos::complex<double> r = -w(j) * U.array()(i, j);
+      for (int k = 0; k < n; ++k) r += S.array()(i, k) * U.array()(k, j);
+      EXPECT_NEAR(Kokkos::abs(r), 0, tol * n);
+    }
+  }
+}
+
+TEST_F(ScalapackSolver, solve_sym)
+{
+  auto A = make_matrix();
+  auto A_ref = make_matrix();
+  auto B = make_matrix();
+  auto B_ref = make_matrix();
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < n; ++i) {
+      A.array()(i, j) = S.array()(i, j);
+      A_ref.array()(i, j) = S.array()(i, j);
+      B.array()(i, j) = Kokkos::complex<double>(i, j);
+      B_ref.array()(i, j) = Kokkos::complex<double>(i, j);
+    }
+  }
+  solve_sym(A, B, comm);
+  solve_sym(A_ref, B_ref);
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < n; ++i) {
+      EXPECT_NEAR(Kokkos::abs(B.array()(i, j) - B_ref.array()(i, j)), 0, tol);
+    }
+  }
+}
+
+
+int main(int argc, char *argv[])
+{
+  // small problems take the distributed path
+  setenv("NLCGLIB_SCALAPACK_MIN_N", "1", 1);
+  Communicator::init(argc, argv);
+  Kokkos::initialize();
+  ::testing::InitGoogleTest(&argc, argv);
+
+  int result = RUN_ALL_TESTS();
+
+  Kokkos::finalize();
+  Communicator::finalize();
+  return result;
+}
@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include <mpi.h>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "nlcglib.hpp"
+#include "toy_energy.hpp"
+
+using namespace nlcglib;
+
+/// nlcg_session: the state saved by a call is restored by the next call of the session
+class Session : public ::testing::Test
+{
+protected:
+  static int count(const std::string& text, const std::string& pattern)
+  {
+    int n = 0;
+    for (auto pos = text.find(pattern); pos != std::string::npos;
+         pos = text.find(pattern, pos + 1)) {
+      ++n;
+    }
+    return n;
+  }
+
+  static std::string read(const std::string& fname)
+  {
+    std::ifstream fin(fname);
+    std::stringstream buffer;
+    buffer << fin.rdbuf();
+    return buffer.str();
+  }
+
+  nlcg_info run(toy::energy& energy)
+  {
+    toy::preconditioner P(nk);
+    toy::overlap S(nk);
+    return nlcg_us_cpu(energy, P, S, smearing_type::FERMI_DIRAC, T, tol, kappa, tau, maxiter,
+                       restart);
+  }
+
+  nlcg_info run(toy::energy& energy, nlcg_session& session)
+  {
+    toy::preconditioner P(nk);
+    toy::overlap S(nk);
+    return nlcg_us_cpu(energy, P, S, smearing_type::FERMI_DIRAC, T, tol, kappa, tau, maxiter,
+                       restart, session);
+  }
+
+  static nlcg_options options(const std::string& log_file)
+  {
+    nlcg_options opt;
+    opt.log_file = log_file;
+    opt.json_file = "";
+    return opt;
+  }
+
+  const int nk{2};
+  const int n{12};
+  const int nb{4};
+  const int ne{4};
+  const double T{3000};
+  const double tol{1e-9};
+  const double kappa{0.3};
+  const double tau{0.1};
+  const int maxiter{200};
+  const int restart{10};
+};
+
+TEST_F(Session, save_restore_resume)
+{
+  toy::energy energy(nk, n, nb, ne);
+  const std::string log_file = "test_session_resume.out";
+  {
+    nlcg_session session(options(log_file));
+
+    auto info1 = run(energy, session);
+    EXPECT_LT(std::abs(info1.tolerance), tol);
+    EXPECT_EQ(session.num_runs(), 1);
+
+    // next "ionic step": the warm-started run and a run from scratch reach the same minimum
+    energy.set_hamiltonian(0.01);
+    toy::energy cold = energy;
+    auto info2 = run(energy, session);
+    auto info_cold = run(cold);
+    EXPECT_EQ(session.num_runs(), 2);
+    EXPECT_LT(std::abs(info2.tolerance), tol);
+    EXPECT_LT(std::abs(info_cold.tolerance), tol);
+    EXPECT_NEAR(info2.F, info_cold.F, 1e-7);
+    // the state of the previous call saves iterations
+    EXPECT_LT(info2.iter, info_cold.iter);
+
+    // no warm start after reset
+    session.reset();
+    energy.set_hamiltonian(0.02);
+    auto info3 = run(energy, session);
+    EXPECT_LT(std::abs(info3.tolerance), tol);
+    EXPECT_EQ(session.num_runs(), 3);
+  }
+
+  // the log of the session is continued, only the second call was warm-started
+  auto log = read(log_file);
+  EXPECT_EQ(count(log, "NLCG SUCCESS"), 3);
+  EXPECT_EQ(count(log, "warm start from the previous direction: accepted"), 1);
+  EXPECT_EQ(count(log, "warm start from the previous direction: rejected"), 0);
+}
+
+TEST_F(Session, state_saved_if_the_host_code_throws)
+{
+  toy::energy energy(nk, n, nb, ne);
+  const std::string log_file = "test_session_throw.out";
+  {
+    nlcg_session session(options(log_file));
+
+    energy.fail_after(5);
+    EXPECT_THROW(run(energy, session), std::runtime_error);
+    EXPECT_EQ(session.num_runs(), 1);
+
+    // resumes from the saved direction
+    energy.fail_after(-1);
+    auto info = run(energy, session);
+    EXPECT_LT(std::abs(info.tolerance), tol);
+    EXPECT_EQ(session.num_runs(), 2);
+  }
+
+  auto log = read(log_file);
+  EXPECT_EQ(count(log, "warm start from the previous direction"), 1);
+}
+
+TEST_F(Session, concurrent_sessions_log_to_their_own_files)
+{
+  int provided;
+  MPI_Query_thread(&provided);
+  if (provided < MPI_THREAD_MULTIPLE) GTEST_SKIP();
+
+  // e.g. two images of a NEB calculation, each on its own communicator
+  const std::vector<std::string> log_files{"test_session_image0.out", "test_session_image1.out"};
+  const std::vector<double> tols{1e-9, 1e-8};
+  std::vector<nlcg_info> infos(2);
+  std::vector<std::exception_ptr> errors(2);
+  auto image = [&](int i) {
+    try {
+      toy::energy energy(nk, n, nb, ne);
+      energy.set_hamiltonian(0.01 * i);
+      nlcg_session session(options(log_files[i]));
+      toy::preconditioner P(nk);
+      toy::overlap S(nk);
+      infos[i] = nlcg_us_cpu(energy, P, S, smearing_type::FERMI_DIRAC, T, tols[i], kappa, tau,
+                             maxiter, restart, session);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+  std::thread t0(image, 0);
+  std::thread t1(image, 1);
+  t0.join();
+  t1.join();
+
+  for (int i = 0; i < 2; ++i) {
+    if (errors[i]) std::rethrow_exception(errors[i]);
+    EXPECT_LT(std::abs(infos[i].tolerance), tols[i]);
+    // each log holds exactly the run of its session
+    std::stringstream tol_line;
+    tol_line << "tol = " << tols[i] << "\n";
+    std::stringstream other_tol_line;
+    other_tol_line << "tol = " << tols[1 - i] << "\n";
+    auto log = read(log_files[i]);
+    EXPECT_EQ(count(log, "NLCG SUCCESS"), 1);
+    EXPECT_EQ(count(log, tol_line.str()), 1);
+    EXPECT_EQ(count(log, other_tol_line.str()), 0);
+  }
+}
+
+int
+main(int argc, char* argv[])
+{
+  int provided;
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+  nlcglib::initialize();
+  ::testing::InitGoogleTest(&argc, argv);
+
+  int result = RUN_ALL_TESTS();
+
+  nlcglib::finalize();
+  MPI_Finalize();
+  return result;
+}
@@ -46,7 +46,7 @@ auto unmanaged_strided()
       A[j*lda + i] = i*n + j;
     }
   }
-  nlcglib::buffer_protocol<double, 2> buf{std::array<int, 2>{1, lda}, std::array<int, 2>{n, m}, A, nlcglib::memory_type::host};
+  nlcglib::buffer_protocol<double, 2> buf{std::array<std::ptrdiff_t, 2>{1, lda}, std::array<std::ptrdiff_t, 2>{n, m}, A, nlcglib::memory_type::host};
 
   nlcglib::Map<> map(nlcglib::Communicator(), nlcglib::SlabLayoutV({{0, 0, n, m}}));
       nlcglib::KokkosDVector<double**,
@@ -0,0 +1,67 @@
+#include "la/dvector.hpp"
+#include "la/lapack.hpp"
+#include "utils/transfer_stats.hpp"
+
+#include <mpi.h>
+#include <iostream>
+
+using namespace nlcglib;
+
+typedef std::complex<double> complex_double;
+
+/// copies of the CG state are accounted on a CPU-only build (host stands in for the device)
+void
+run()
+{
+  using matrix_t = KokkosDVector<complex_double**, SlabLayoutV, Kokkos::LayoutLeft, Kokkos::HostSpace>;
+  int n = 100;
+  int m = 10;
+  matrix_t X(Map<>(Communicator(), SlabLayoutV({{0, 0, n, m}})));
+  Kokkos::View<double*, Kokkos::HostSpace> ek("ek", m);
+  std::size_t nbytes = n * m * sizeof(complex_double);
+
+  transfer_stats transfers;
+  // host resident state: copied to the execution space and back
+  auto X1 = to_exec_space<false>(Kokkos::HostSpace(), X, "in", &transfers);
+  auto X1h = from_exec_space<false>(X1, "out", &transfers);
+  auto ek1 = counted_mirror(Kokkos::HostSpace(), ek, "in", &transfers);
+
+  auto counts = transfers.counts();
+  if (counts["in"].calls != 2 || counts["in"].bytes != nbytes + m * sizeof(double))
+    throw std::runtime_error("wrong count: to_exec_space");
+  if (counts["out"].calls != 1 || counts["out"].bytes != nbytes)
+    throw std::runtime_error("wrong count: from_exec_space");
+
+  // resident state: no copies
+  transfers.clear();
+  auto X2 = to_exec_space<true>(Kokkos::HostSpace(), X, "in", &transfers);
+  auto X2h = from_exec_space<true>(X2, "out", &transfers);
+  if (transfers.total().calls != 0 || transfers.total().bytes != 0)
+    throw std::runtime_error("resident state must not be copied");
+
+  // copies shared within an iteration (descent direction and geodesic): copied once
+  transfers.clear();
+  exec_space_mirrors mirrors;
+  auto X3 = to_exec_space<false>(Kokkos::HostSpace(), X, "in", &transfers, &mirrors);
+  auto X4 = to_exec_space<false>(Kokkos::HostSpace(), X, "in", &transfers, &mirrors);
+  if (transfers.total().calls != 1 || X3.array().data() != X4.array().data())
+    throw std::runtime_error("shared copy: copied more than once");
+  mirrors.clear();
+  auto X5 = to_exec_space<false>(Kokkos::HostSpace(), X, "in", &transfers, &mirrors);
+  if (transfers.total().calls != 2) throw std::runtime_error("shared copy: not dropped by clear");
+
+  std::cout << "transfer accounting OK\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+  Communicator::init(argc, argv);
+  Kokkos::initialize();
+
+  run();
+
+  Kokkos::finalize();
+  Communicator::finalize();
+  return 0;
+}
@@ -0,0 +1,275 @@
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "interface.hpp"
+
+namespace toy {
+
+using nlcglib::memory_type;
+using complex_t = std::complex<double>;
+
+/// n x nb column-major host matrices, one per k-point
+class matrix : public nlcglib::MatrixBaseZ
+{
+public:
+  matrix(std::vector<std::vector<complex_t>>& data, int n, int nb, MPI_Comm comm)
+      : data_(data)
+      , n_(n)
+      , nb_(nb)
+      , comm_(comm)
+  {
+  }
+
+  buffer_t get(int i) override
+  {
+    return buffer_t({1, n_}, {n_, nb_}, data_[i].data(), memory_type::host, MPI_COMM_SELF);
+  }
+  const buffer_t get(int i) const override
+  {
+    return buffer_t({1, n_}, {n_, nb_}, data_[i].data(), memory_type::host, MPI_COMM_SELF);
+  }
+  int size() const override { return static_cast<int>(data_.size()); }
+  MPI_Comm mpicomm(int) const override { return MPI_COMM_SELF; }
+  MPI_Comm mpicomm() const override { return comm_; }
+  kindex_t kpoint_index(int i) const override { return {i, 0}; }
+
+private:
+  std::vector<std::vector<complex_t>>& data_;
+  int n_;
+  int nb_;
+  MPI_Comm comm_;
+};
+
+class vector : public nlcglib::VectorBaseZ
+{
+public:
+  vector(std::vector<std::vector<double>>& data, MPI_Comm comm)
+      : data_(data)
+      , comm_(comm)
+  {
+  }
+
+  buffer_t get(int i) override
+  {
+    return buffer_t(data_[i].size(), data_[i].data(), memory_type::host, MPI_COMM_SELF);
+  }
+  const buffer_t get(int i) const override
+  {
+    return buffer_t(data_[i].size(), data_[i].data(), memory_type::host, MPI_COMM_SELF);
+  }
+  int size() const override { return static_cast<int>(data_.size()); }
+  MPI_Comm mpicomm(int) const override { return MPI_COMM_SELF; }
+  MPI_Comm mpicomm() const override { return comm_; }
+  kindex_t kpoint_index(int i) const override { return {i, 0}; }
+
+private:
+  std::vector<std::vector<double>>& data_;
+  MPI_Comm comm_;
+};
+
+class scalar : public nlcglib::ScalarBaseZ
+{
+public:
+  scalar(std::vector<double> data, MPI_Comm comm)
+      : data_(std::move(data))
+      , comm_(comm)
+  {
+  }
+
+  buffer_t get(int i) override { return data_[i]; }
+  const buffer_t get(int i) const override { return data_[i]; }
+  int size() const override { return static_cast<int>(data_.size()); }
+  MPI_Comm mpicomm(int) const override { return MPI_COMM_SELF; }
+  MPI_Comm mpicomm() const override { return comm_; }
+  kindex_t kpoint_index(int i) const override { return {i, 0}; }
+
+private:
+  std::vector<double> data_;
+  MPI_Comm comm_;
+};
+
+/**
+ * Non self-consistent model: a fixed Hermitian tridiagonal H_k of size n per k-point and S = 1,
+ * E = sum_k w_k sum_i f_ki <c_ki|H_k|c_ki>. All k-points are held by the calling rank.
+ */
+class energy : public nlcglib::EnergyBase
+{
+public:
+  energy(int nk, int n, int nb, int ne, MPI_Comm comm = MPI_COMM_SELF)
+      : nk_(nk)
+      , n_(n)
+      , nb_(nb)
+      , ne_(ne)
+      , comm_(comm)
+      , h_(nk, std::vector<complex_t>(n * n))
+      , c_(nk, std::vector<complex_t>(n * nb))
+      , hc_(nk, std::vector<complex_t>(n * nb))
+      , fn_(nk, std::vector<double>(nb, double(ne) / nb))
+      , ek_(nk, std::vector<double>(nb))
+      , ekin_(nk, std::vector<double>(n, 1))
+  {
+    set_hamiltonian(0);
+    // orthonormal columns (e_i + 0.3 e_{i+nb}) / |.|
+    double norm = std::sqrt(1 + 0.3 * 0.3);
+    for (int k = 0; k < nk; ++k) {
+      for (int i = 0; i < nb; ++i) {
+        c_[k][i * n + i] = 1 / norm;
+        c_[k][i * n + (i + nb) % n] += 0.3 / norm;
+      }
+    }
+    apply_h();
+  }
+
+  /// changes H_k, e.g. the next ionic step
+  void set_hamiltonian(double shift)
+  {
+    for (int k = 0; k < nk_; ++k) {
+      auto& h = h_[k];
+      std::fill(h.begin(), h.end(), complex_t{0});
+      for (int i = 0; i < n_; ++i) {
+        h[i * n_ + i] = 0.05 * i + 0.01 * k + shift * std::sin(i + 1.0);
+        if (i + 1 < n_) {
+          h[(i + 1) * n_ + i] = complex_t(0.02, 0.01);
+          h[i * n_ + i + 1] = complex_t(0.02, -0.01);
+        }
+      }
+    }
+  }
+
+  /// compute() throws from the (calls + 1)-th call on, -1: never
+  void fail_after(int calls) { fail_after_ = calls; }
+  int num_compute() const { return num_compute_; }
+
+  void compute() override
+  {
+    if (fail_after_ >= 0 && num_compute_ >= fail_after_) {
+      throw std::runtime_error("toy::energy: compute failed");
+    }
+    num_compute_++;
+    apply_h();
+  }
+
+  int nelectrons() override { return ne_; }
+  int occupancy() override { return 2; }
+  double get_total_energy() override { return etot_; }
+  std::map<std::string, double> get_energy_components() override { return {{"total", etot_}}; }
+  std::shared_ptr<nlcglib::MatrixBaseZ> get_hphi(memory_type) override
+  {
+    return std::make_shared<matrix>(hc_, n_, nb_, comm_);
+  }
+  // S = 1
+  std::shared_ptr<nlcglib::MatrixBaseZ> get_sphi(memory_type) override
+  {
+    return std::make_shared<matrix>(c_, n_, nb_, comm_);
+  }
+  std::shared_ptr<nlcglib::MatrixBaseZ> get_C(memory_type) override
+  {
+    return std::make_shared<matrix>(c_, n_, nb_, comm_);
+  }
+  std::shared_ptr<nlcglib::VectorBaseZ> get_fn() override
+  {
+    return std::make_shared<vector>(fn_, comm_);
+  }
+  void set_fn(const std::vector<std::pair<int, int>>& keys,
+              const std::vector<std::vector<double>>& fn) override
+  {
+    for (std::size_t i = 0; i < keys.size(); ++i) fn_[keys[i].first] = fn[i];
+  }
+  std::shared_ptr<nlcglib::VectorBaseZ> get_ek() override
+  {
+    return std::make_shared<vector>(ek_, comm_);
+  }
+  std::shared_ptr<nlcglib::VectorBaseZ> get_gkvec_ekin() override
+  {
+    return std::make_shared<vector>(ekin_, comm_);
+  }
+  std::shared_ptr<nlcglib::ScalarBaseZ> get_kpoint_weights() override
+  {
+    return std::make_shared<scalar>(std::vector<double>(nk_, 1.0 / nk_), comm_);
+  }
+  void set_chemical_potential(double mu) override { mu_ = mu; }
+  double get_chemical_potential() override { return mu_; }
+  void print_info() const override {}
+
+  int num_kpoints() const { return nk_; }
+
+private:
+  /// HC = H C, ek = diag(C^H H C) and the energy
+  void apply_h()
+  {
+    etot_ = 0;
+    for (int k = 0; k < nk_; ++k) {
+      for (int j = 0; j < nb_; ++j) {
+        complex_t e{0};
+        for (int i = 0; i < n_; ++i) {
+          complex_t hc{0};
+          for (int l = 0; l < n_; ++l) hc += h_[k][l * n_ + i] * c_[k][j * n_ + l];
+          hc_[k][j * n_ + i] = hc;
+          e += std::conj(c_[k][j * n_ + i]) * hc;
+        }
+        ek_[k][j] = e.real();
+        etot_ += fn_[k][j] * e.real() / nk_;
+      }
+    }
+  }
+
+  int nk_;
+  int n_;
+  int nb_;
+  int ne_;
+  MPI_Comm comm_;
+  std::vector<std::vector<complex_t>> h_;
+  std::vector<std::vector<complex_t>> c_;
+  std::vector<std::vector<complex_t>> hc_;
+  std::vector<std::vector<double>> fn_;
+  std::vector<std::vector<double>> ek_;
+  std::vector<std::vector<double>> ekin_;
+  double mu_{0};
+  double etot_{0};
+  int num_compute_{0};
+  int fail_after_{-1};
+};
+
+/// S = 1 and P = 1
+template <class base_t>
+class identity : public base_t
+{
+public:
+  explicit identity(int nk)
+      : nk_(nk)
+  {
+  }
+
+  void apply(const nlcglib::OpBase::key_t&,
+             nlcglib::MatrixBaseZ::buffer_t& out,
+             nlcglib::MatrixBaseZ::buffer_t& in) const override
+  {
+    for (std::ptrdiff_t j = 0; j < in.size[1]; ++j) {
+      for (std::ptrdiff_t i = 0; i < in.size[0]; ++i) {
+        out.data[i * out.stride[0] + j * out.stride[1]] =
+            in.data[i * in.stride[0] + j * in.stride[1]];
+      }
+    }
+  }
+
+  std::vector<nlcglib::OpBase::key_t> get_keys() const override
+  {
+    std::vector<nlcglib::OpBase::key_t> keys;
+    for (int k = 0; k < nk_; ++k) keys.emplace_back(k, 0);
+    return keys;
+  }
+
+private:
+  int nk_;
+};
+
+using overlap = identity<nlcglib::OverlapBase>;
+using preconditioner = identity<nlcglib::UltrasoftPrecondBase>;
+
+}  // namespace toy
@@ -0,0 +1,38 @@
+#include <gtest/gtest.h>
+#include "pseudo_hamiltonian/adaptive_kappa.hpp"
+
+using namespace nlcglib;
+
+/// separable quadratic: the eta part wants a twice longer step than the X part
+TEST(adaptive_kappa, balances_x_and_eta_steps)
+{
+  adaptive_kappa akappa(1.0, 0.1, 10);
+  ASSERT_TRUE(akappa.enabled());
+
+  // s_x = s_eta = -1, c_x = 1, c_eta = 0.5, step t = 0.5
+  akappa.set_direction(-2, -1);
+  double kappa = akappa.update(0.5, -0.5 - 0.75, -0.75);
+  EXPECT_NEAR(akappa.ratio(), 2, 1e-12);
+  EXPECT_NEAR(kappa, 2, 1e-12);
+  EXPECT_EQ(akappa.num_updates(), 1);
+
+  // no direction set since the last update
+  EXPECT_EQ(akappa.update(0.5, -1.25, -0.75), kappa);
+}
+
+TEST(adaptive_kappa, bounds)
+{
+  adaptive_kappa akappa(1.0, 0.8, 1.5);
+  // t_eta / t_x = 1/8, limited to a factor 1/2 and then to kappa_min
+  akappa.set_direction(-2, -1);
+  EXPECT_NEAR(akappa.update(0.5, -0.5 + 3, 3), 0.8, 1e-12);
+  // negative curvature of the eta part: unchanged
+  akappa.set_direction(-2, -1);
+  EXPECT_NEAR(akappa.update(0.5, -0.5 - 1.5, -1.5), 0.8, 1e-12);
+
+  // fixed kappa
+  adaptive_kappa fixed(3.0, 0, 0);
+  EXPECT_FALSE(fixed.enabled());
+  fixed.set_direction(-2, -1);
+  EXPECT_EQ(fixed.update(0.5, -1.25, -0.75), 3.0);
+}
@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include "mvp2/cg_beta.hpp"
+
+using namespace nlcglib;
+
+// fr = <g, Δ> < 0 with Δ = -P g
+
+TEST(cg_beta, fletcher_reeves)
+{
+  auto res = cg_beta(cg_update::FLETCHER_REEVES, 0, -2, -4, 0.3, 0.1, 0.2, true);
+  EXPECT_DOUBLE_EQ(res.beta, 0.5);
+  EXPECT_FALSE(res.powell_restart);
+  EXPECT_FALSE(res.reset);
+  // PR+ and HS without a previous gradient
+  EXPECT_DOUBLE_EQ(cg_beta(cg_update::POLAK_RIBIERE_PLUS, 0, -2, -4, 0, 0, 0, false).beta, 0.5);
+  EXPECT_DOUBLE_EQ(cg_beta(cg_update::HESTENES_STIEFEL, 0, -2, -4, 0, 0, 0, false).beta, 0.5);
+}
+
+TEST(cg_beta, polak_ribiere_plus)
+{
+  // (fr - gp_delta) / fr_old
+  auto res = cg_beta(cg_update::POLAK_RIBIERE_PLUS, 0, -2, -3, 0.3, -0.5, 0.2, true);
+  EXPECT_DOUBLE_EQ(res.beta, 0.5);
+  EXPECT_FALSE(res.reset);
+  // beta < 0: steepest descent
+  res = cg_beta(cg_update::POLAK_RIBIERE_PLUS, 0, -2, -3, 0.3, -3, 0.2, true);
+  EXPECT_EQ(res.beta, 0);
+  EXPECT_TRUE(res.reset);
+}
+
+TEST(cg_beta, hestenes_stiefel)
+{
+  // -(fr - gp_delta) / (slope_zp - gp_zp)
+  auto res = cg_beta(cg_update::HESTENES_STIEFEL, 0, -2, -3, 1, -0.5, -2, true);
+  EXPECT_DOUBLE_EQ(res.beta, 0.5);
+  EXPECT_FALSE(res.reset);
+  // does not depend on fr_old
+  EXPECT_DOUBLE_EQ(cg_beta(cg_update::HESTENES_STIEFEL, 0, -2, -7, 1, -0.5, -2, true).beta, 0.5);
+  // beta < 0 and a vanishing denominator: steepest descent
+  res = cg_beta(cg_update::HESTENES_STIEFEL, 0, -2, -3, -1, -0.5, 2, true);
+  EXPECT_EQ(res.beta, 0);
+  EXPECT_TRUE(res.reset);
+  res = cg_beta(cg_update::HESTENES_STIEFEL, 0, -2, -3, 1, -0.5, 1, true);
+  EXPECT_EQ(res.beta, 0);
+  EXPECT_TRUE(res.reset);
+}
+
+TEST(cg_beta, powell_restart)
+{
+  // |gp_delta| >= 0.2 * |fr|
+  auto res = cg_beta(cg_update::POLAK_RIBIERE_PLUS, 0.2, -2, -3, 0.3, 0.5, 0.2, true);
+  EXPECT_EQ(res.beta, 0);
+  EXPECT_TRUE(res.powell_restart);
+  EXPECT_FALSE(res.reset);
+  res = cg_beta(cg_update::FLETCHER_REEVES, 0.2, -2, -4, 0.3, -0.4, 0.2, true);
+  EXPECT_EQ(res.beta, 0);
+  EXPECT_TRUE(res.powell_restart);
+  // below the threshold the update formula applies
+  res = cg_beta(cg_update::POLAK_RIBIERE_PLUS, 0.2, -2, -3, 0.3, 0.1, 0.2, true);
+  EXPECT_FALSE(res.powell_restart);
+  EXPECT_DOUBLE_EQ(res.beta, 0.7);
+  // no test without a previous gradient
+  res = cg_beta(cg_update::FLETCHER_REEVES, 0.2, -2, -4, 0, 0, 0, false);
+  EXPECT_FALSE(res.powell_restart);
+  EXPECT_DOUBLE_EQ(res.beta, 0.5);
+}
@@ -110,6 +110,40 @@ TEST_F(CPUKokkosVectors, TransformCPU)
   std::cout << "\n";
 }
 
+TEST_F(CPUKokkosVectors, InnerhTrRealCPU)
+{
+  // real matrices (Gamma-point), the result is returned as a complex number
+  auto z = innerh_tr()(a_, b_);
+  static_assert(std::is_same<decltype(z), Kokkos::complex<double>>::value, "expected complex<double>");
+  double ref = 0;
+  for (int i = 0; i < 5; ++i) ref += cRef_.array()(i, i);
+  EXPECT_DOUBLE_EQ(z.real(), ref);
+  EXPECT_DOUBLE_EQ(z.imag(), 0);
+}
+
+TEST(EigenValues, EigSymmetricCPU)
+{
+  // Poisson matrix: n = 5, ones on diagonal, -2 on first off-diagonals (dsyevd)
+  typedef KokkosDVector<double **, SlabLayoutV, Kokkos::LayoutLeft, Kokkos::HostSpace> vector_t;
+  const std::vector<double> eigs = {-2.46410162, -1., 1., 3., 4.46410162};
+  int n = eigs.size();
+
+  vector_t A(Map<>(Communicator(), SlabLayoutV({{0, 0, n, n}})));
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      A.array()(i, j) = i == j ? 1 : (std::abs(i - j) == 1 ? -2 : 0);
+    }
+  }
+
+  vector_t V(Map<>(Communicator(), SlabLayoutV({{0, 0, n, n}})));
+  Kokkos::View<double *, Kokkos::HostSpace> w("w", n);
+  eigh(V, w, A);
+
+  for (int i = 0; i < n; ++i) {
+    EXPECT_NEAR(w(i), eigs[i], 1e-8);
+  }
+}
+
 
 class GPUKokkosVectors : public ::testing::Test
 {
@@ -269,6 +303,19 @@ TEST(EigenValues, EigHermitian)
   }
 }
 
+TEST(BlasInt, OverflowCheck)
+{
+  std::ptrdiff_t n = 3000000;
+  // 3e6 x 3e6 elements, the leading dimension still fits but the element count does not
+  EXPECT_EQ(cblas::to_blas_int(n), n);
+  if (sizeof(cblas::blas_int) == 4) {
+    EXPECT_THROW(cblas::to_blas_int(n * n), std::runtime_error);
+  } else {
+    EXPECT_EQ(cblas::to_blas_int(n * n), n * n);
+  }
+  EXPECT_THROW(checked_cast<int>(std::size_t{1} << 40, "MPI"), std::runtime_error);
+}
+
 
 int
 main(int argc, char *argv[])
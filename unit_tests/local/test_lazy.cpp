@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "la/dvector.hpp"
+#include "la/expr.hpp"
+#include "la/lazy.hpp"
+
+using namespace nlcglib;
+
+TEST(lazy_node, memoized)
+{
+  int calls{0};
+  auto node = make_lazy(
+      [&calls](int a, int b) {
+        calls++;
+        return a + b;
+      },
+      1,
+      2);
+  EXPECT_FALSE(node.ready());
+  EXPECT_EQ(calls, 0);
+  EXPECT_EQ(node(), 3);
+  EXPECT_TRUE(node.ready());
+  EXPECT_EQ(node(), 3);
+  EXPECT_EQ(calls, 1);
+
+  // copies share the result
+  auto copy = node;
+  EXPECT_TRUE(copy.ready());
+  EXPECT_EQ(copy(), 3);
+  EXPECT_EQ(calls, 1);
+}
+
+TEST(lazy_node, lazy_arguments)
+{
+  int calls{0};
+  auto a = make_lazy(
+      [&calls](int x) {
+        calls++;
+        return 2 * x;
+      },
+      5);
+  auto b = make_lazy([](int x, int y) { return x + y; }, a, 1);
+  EXPECT_FALSE(a.ready());
+  EXPECT_EQ(b(), 11);
+  // evaluated on first use, the argument keeps its own result
+  EXPECT_TRUE(a.ready());
+  EXPECT_EQ(a(), 10);
+  EXPECT_EQ(calls, 1);
+}
+
+TEST(lazy_node, concurrent_calls_compute_once)
+{
+  std::atomic<int> calls{0};
+  auto node = make_lazy(
+      [&calls](int x) {
+        calls++;
+        return std::vector<int>(1000, x);
+      },
+      7);
+  std::vector<std::thread> threads;
+  std::atomic<int> sum{0};
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&node, &sum]() {
+      const auto& v = node();
+      sum += v.front() + v.back();
+    });
+  }
+  for (auto& t : threads) t.join();
+  EXPECT_EQ(calls.load(), 1);
+  EXPECT_EQ(sum.load(), 8 * 14);
+}
+
+TEST(expr, assign)
+{
+  using matrix_t = KokkosDVector<double**, SlabLayoutV, Kokkos::LayoutLeft, Kokkos::HostSpace>;
+  int m = 7;
+  int n = 3;
+  matrix_t hx(Map<>(Communicator(), SlabLayoutV({{0, 0, m, n}})));
+  matrix_t xll(Map<>(Communicator(), SlabLayoutV({{0, 0, m, n}})));
+  matrix_t dst(Map<>(Communicator(), SlabLayoutV({{0, 0, m, n}})));
+  Kokkos::View<double*, Kokkos::HostSpace> fn("fn", n);
+  for (int j = 0; j < n; ++j) {
+    fn(j) = 1.0 / (j + 1);
+    for (int i = 0; i < m; ++i) {
+      hx.array()(i, j) = i + 10 * j;
+      xll.array()(i, j) = i * j;
+    }
+  }
+  double wk = 0.5;
+  assign(dst, wk * expr::col_scale(expr::ref(hx), fn) - wk * expr::ref(xll));
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < m; ++i) {
+      EXPECT_DOUBLE_EQ(dst.array()(i, j), wk * hx.array()(i, j) * fn(j) - wk * xll.array()(i, j));
+    }
+  }
+
+  assign(dst, -expr::ref(hx) + expr::ref(xll));
+  for (int j = 0; j < n; ++j) {
+    for (int i = 0; i < m; ++i) {
+      EXPECT_DOUBLE_EQ(dst.array()(i, j), xll.array()(i, j) - hx.array()(i, j));
+    }
+  }
+}
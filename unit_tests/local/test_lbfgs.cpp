@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+#include "mvp2/lbfgs.hpp"
+
+using namespace nlcglib;
+
+namespace {
+
+using vec = std::vector<double>;
+
+double
+dot(const vec& a, const vec& b)
+{
+  double s = 0;
+  for (std::size_t i = 0; i < a.size(); ++i) s += a[i] * b[i];
+  return s;
+}
+
+}  // namespace
+
+/// lbfgs_two_loop reproduces the two-loop recursion with H0 = gamma * P (P diagonal)
+TEST(lbfgs, two_loop_from_inner_products)
+{
+  const int N = 12;
+  const int n = 4;
+  std::mt19937 gen(0);
+  std::normal_distribution<double> normal;
+
+  vec p(N);
+  for (auto& pi : p) pi = 0.5 + std::abs(normal(gen));
+  auto P = [&](const vec& v) {
+    vec r(N);
+    for (int i = 0; i < N; ++i) r[i] = p[i] * v[i];
+    return r;
+  };
+  std::vector<vec> s(n, vec(N)), y(n, vec(N)), py(n);
+  for (int k = 0; k < n; ++k) {
+    for (int i = 0; i < N; ++i) {
+      s[k][i] = normal(gen);
+      y[k][i] = (1 + p[i]) * s[k][i] + 0.1 * normal(gen);
+    }
+    py[k] = P(y[k]);
+  }
+  vec g(N);
+  for (auto& gi : g) gi = normal(gen);
+  vec delta = P(g);
+  for (auto& di : delta) di = -di;
+
+  // reference: r = H g
+  vec q = g;
+  vec alpha(n), rho(n);
+  for (int k = 0; k < n; ++k) rho[k] = 1 / dot(s[k], y[k]);
+  for (int k = n - 1; k >= 0; --k) {
+    alpha[k] = rho[k] * dot(s[k], q);
+    for (int i = 0; i < N; ++i) q[i] -= alpha[k] * y[k][i];
+  }
+  double gamma = dot(s[n - 1], y[n - 1]) / dot(y[n - 1], py[n - 1]);
+  vec r = P(q);
+  for (auto& ri : r) ri *= gamma;
+  for (int k = 0; k < n; ++k) {
+    double beta = rho[k] * dot(y[k], r);
+    for (int i = 0; i < N; ++i) r[i] += (alpha[k] - beta) * s[k][i];
+  }
+
+  lbfgs_gram gram(n);
+  for (int k = 0; k < n; ++k) {
+    for (int l = 0; l < n; ++l) {
+      gram.sy(k, l) = dot(s[k], y[l]);
+      gram.ypy(k, l) = dot(y[k], py[l]);
+    }
+    gram.sg(k) = dot(s[k], g);
+    gram.yd(k) = dot(y[k], delta);
+    gram.gpy(k) = dot(g, py[k]);
+  }
+  auto c = lbfgs_two_loop(gram, dot(g, delta));
+
+  EXPECT_NEAR(c.gamma, gamma, 1e-12);
+  vec d(N);
+  for (int i = 0; i < N; ++i) {
+    d[i] = c.gamma * delta[i];
+    for (int k = 0; k < n; ++k) d[i] += c.a[k] * py[k][i] + c.b[k] * s[k][i];
+    EXPECT_NEAR(d[i], -r[i], 1e-12);
+  }
+  EXPECT_NEAR(c.slope, dot(g, d), 1e-12);
+  EXPECT_LT(c.slope, 0);
+}
+
+/// without pairs the direction is Δ
+TEST(lbfgs, empty_history_is_steepest_descent)
+{
+  lbfgs_gram gram(0);
+  auto c = lbfgs_two_loop(gram, -2.0);
+  EXPECT_EQ(c.gamma, 1);
+  EXPECT_EQ(c.slope, -2.0);
+  EXPECT_TRUE(c.a.empty());
+}
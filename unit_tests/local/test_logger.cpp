@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "utils/logger.hpp"
+
+using namespace nlcglib;
+
+namespace {
+
+/// logger writing to a file on every rank (master), stdout detached
+struct file_logger
+{
+  explicit file_logger(const std::string& name)
+      : fname(::testing::TempDir() + name)
+      , logger(MPI_COMM_WORLD, true)
+  {
+    logger.detach_stdout();
+    logger.attach_file_master(fname);
+  }
+
+  std::string content()
+  {
+    logger.flush();
+    std::ifstream in(fname);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  }
+
+  std::string fname;
+  Logger logger;
+};
+
+}  // namespace
+
+TEST(logger, levels)
+{
+  file_logger f("nlcglib_test_levels.log");
+  f.logger.set_level(log_level::info);
+  f.logger.record(log_level::debug) << "debug\n";
+  f.logger << "info\n";
+  f.logger.record(log_level::warning) << "warning\n";
+  EXPECT_EQ(f.content(), "info\nWARNING: warning\n");
+}
+
+TEST(logger, records_destroyed_out_of_order)
+{
+  file_logger f("nlcglib_test_order.log");
+  auto a = std::make_unique<log_record>(f.logger.record(log_level::info));
+  auto b = std::make_unique<log_record>(f.logger.record(log_level::info));
+  *a << "a\n";
+  *b << "b\n";
+  a.reset();
+  // must not reuse the buffer of b
+  f.logger << "c\n";
+  *b << "b2\n";
+  b.reset();
+  EXPECT_EQ(f.content(), "a\nc\nb\nb2\n");
+}
+
+TEST(logger, nested_records)
+{
+  file_logger f("nlcglib_test_nested.log");
+  auto inner = [&f]() {
+    f.logger << "inner\n";
+    return 1;
+  };
+  f.logger << "outer " << inner() << "\n";
+  EXPECT_EQ(f.content(), "inner\nouter 1\n");
+}
+
+TEST(logger, concurrent_statements_are_not_interleaved)
+{
+  file_logger f("nlcglib_test_threads.log");
+  int nthreads = 4;
+  int nlines = 200;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; ++t) {
+    threads.emplace_back([&f, t, nlines]() {
+      for (int i = 0; i < nlines; ++i) f.logger << "thread " << t << " line " << i << "\n";
+    });
+  }
+  for (auto& t : threads) t.join();
+
+  std::istringstream lines(f.content());
+  std::string line;
+  int count{0};
+  while (std::getline(lines, line)) {
+    int t, i;
+    ASSERT_EQ(std::sscanf(line.c_str(), "thread %d line %d", &t, &i), 2) << line;
+    count++;
+  }
+  EXPECT_EQ(count, nthreads * nlines);
+}
+
+TEST(logger, scope_routes_the_calling_thread)
+{
+  file_logger f1("nlcglib_test_scope1.log");
+  file_logger f2("nlcglib_test_scope2.log");
+  std::thread t1([&f1]() {
+    logger_scope scope(&f1.logger);
+    Logger::GetInstance() << "one\n";
+  });
+  std::thread t2([&f2]() {
+    logger_scope scope(&f2.logger);
+    Logger::GetInstance() << "two\n";
+  });
+  t1.join();
+  t2.join();
+  EXPECT_EQ(f1.content(), "one\n");
+  EXPECT_EQ(f2.content(), "two\n");
+  EXPECT_EQ(Logger::current(), nullptr);
+}
+
+TEST(logger, non_master_does_not_write_the_file)
+{
+  std::string fname = ::testing::TempDir() + "nlcglib_test_master.log";
+  std::remove(fname.c_str());
+  Logger logger(MPI_COMM_WORLD, false);
+  logger.detach_stdout();
+  logger.attach_file_master(fname);
+  logger << "x\n";
+  EXPECT_FALSE(std::ifstream(fname).good());
+}
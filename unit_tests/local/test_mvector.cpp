@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "la/mvector.hpp"
+
+using namespace nlcglib;
+
+/// one host vector per k-point, owned by the object (as the host codes do for ek, fn)
+class HostVectors : public VectorBaseZ
+{
+public:
+  HostVectors(int nk, int n, memory_type memtype = memory_type::host)
+      : data_(nk, std::vector<double>(n, 1.0))
+      , memtype_(memtype)
+  {
+  }
+
+  buffer_t get(int i) override { return buffer_t(data_[i].size(), data_[i].data(), memtype_); }
+  const buffer_t get(int i) const override
+  {
+    return buffer_t(data_[i].size(), const_cast<double*>(data_[i].data()), memtype_);
+  }
+  int size() const override { return data_.size(); }
+  MPI_Comm mpicomm(int) const override { return MPI_COMM_SELF; }
+  MPI_Comm mpicomm() const override { return MPI_COMM_SELF; }
+  kindex_t kpoint_index(int i) const override { return kindex_t(i, 0); }
+
+  std::vector<std::vector<double>> data_;
+
+private:
+  memory_type memtype_;
+};
+
+TEST(mvector, sorted_flat_storage)
+{
+  mvector<double> x;
+  x[std::make_pair(2, 0)] = 2;
+  x[std::make_pair(0, 1)] = 1;
+  x[std::make_pair(0, 0)] = 0;
+
+  ASSERT_EQ(x.size(), 3u);
+  EXPECT_EQ(x.key(0), std::make_pair(0, 0));
+  EXPECT_EQ(x.key(1), std::make_pair(0, 1));
+  EXPECT_EQ(x.key(2), std::make_pair(2, 0));
+  EXPECT_EQ(x.value(2), 2);
+  EXPECT_EQ(x.at(std::make_pair(0, 1)), 1);
+  EXPECT_THROW(x.at(std::make_pair(1, 0)), std::out_of_range);
+}
+
+TEST(mvector, shared_index)
+{
+  mvector<double> x;
+  mvector<int> y;
+  // different insertion order, same key set
+  for (int i = 0; i < 4; ++i) x[std::make_pair(i, 0)] = i;
+  for (int i = 3; i >= 0; --i) y[std::make_pair(i, 0)] = 10 * i;
+  EXPECT_TRUE(x.same_index(y));
+
+  auto z = eval_threaded(tapply([](double a, int b) { return a + b; }, x, y));
+  EXPECT_TRUE(z.same_index(x));
+  for (int i = 0; i < 4; ++i) EXPECT_EQ(z.at(std::make_pair(i, 0)), 11 * i);
+
+  auto u = unzip(eval_threaded(tapply([](double a, int b) { return std::make_tuple(b, a); }, x, y)));
+  EXPECT_TRUE(std::get<0>(u).same_index(x));
+  EXPECT_EQ(std::get<0>(u).at(std::make_pair(2, 0)), 20);
+  EXPECT_EQ(std::get<1>(u).at(std::make_pair(2, 0)), 2);
+
+  // key set differs -> lookup by key
+  mvector<int> w = y;
+  w[std::make_pair(5, 0)] = 0;
+  EXPECT_FALSE(w.same_index(x));
+  auto v = eval_threaded(tapply([](double a, int b) { return a + b; }, x, w));
+  for (int i = 0; i < 4; ++i) EXPECT_EQ(v.at(std::make_pair(i, 0)), 11 * i);
+}
+
+TEST(mvector, vector_import_without_copy)
+{
+  auto base = std::make_shared<HostVectors>(3, 5);
+  auto copied = make_mmvector<Kokkos::HostSpace>(base);
+  auto aliased = make_mmvector_view<Kokkos::HostSpace>(base);
+  ASSERT_EQ(aliased.size(), 3u);
+  for (std::size_t i = 0; i < aliased.size(); ++i) {
+    EXPECT_EQ(aliased.value(i).data(), base->data_[i].data());
+    EXPECT_NE(copied.value(i).data(), base->data_[i].data());
+    EXPECT_EQ(aliased.value(i)(4), 1.0);
+  }
+  // the import keeps the buffers alive
+  std::weak_ptr<HostVectors> alive = base;
+  base.reset();
+  EXPECT_FALSE(alive.expired());
+  aliased = decltype(aliased)();
+  EXPECT_TRUE(alive.expired());
+
+  auto device = std::make_shared<HostVectors>(1, 5, memory_type::device);
+  EXPECT_THROW(make_mmvector_view<Kokkos::HostSpace>(device), std::runtime_error);
+}
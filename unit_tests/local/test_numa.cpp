@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "utils/numa.hpp"
+
+using namespace nlcglib;
+
+TEST(key_queue, own_domain_first_then_steal)
+{
+  numa::key_queue q(7, 2);
+  std::vector<std::size_t> order;
+  std::size_t i;
+  while (q.pop(0, i)) order.push_back(i);
+  // domain 0 holds the even indices, the odd ones are stolen from domain 1
+  EXPECT_EQ(order, (std::vector<std::size_t>{0, 2, 4, 6, 1, 3, 5}));
+
+  auto before = numa::get_task_counts();
+  q.commit();
+  auto after = numa::get_task_counts();
+  EXPECT_EQ(after.local - before.local, 4u);
+  EXPECT_EQ(after.remote - before.remote, 3u);
+}
+
+TEST(key_queue, single_domain_is_not_counted)
+{
+  numa::key_queue q(3, 1);
+  std::vector<std::size_t> order;
+  std::size_t i;
+  while (q.pop(0, i)) order.push_back(i);
+  EXPECT_EQ(order, (std::vector<std::size_t>{0, 1, 2}));
+  EXPECT_FALSE(q.pop(0, i));
+
+  auto before = numa::get_task_counts();
+  q.commit();
+  auto after = numa::get_task_counts();
+  EXPECT_EQ(after.local, before.local);
+  EXPECT_EQ(after.remote, before.remote);
+}
+
+TEST(key_queue, empty_and_invalid_domain_count)
+{
+  numa::key_queue empty(0, 2);
+  std::size_t i;
+  EXPECT_FALSE(empty.pop(1, i));
+  // ndomains <= 0 is treated as a single domain
+  numa::key_queue q(2, 0);
+  EXPECT_TRUE(q.pop(0, i));
+  EXPECT_EQ(i, 0u);
+}
+
+TEST(key_queue, concurrent_pops_hand_out_each_index_once)
+{
+  const std::size_t n = 1000;
+  const int ndomains = 3;
+  numa::key_queue q(n, ndomains);
+  std::vector<std::atomic<int>> taken(n);
+  for (auto& t : taken) t = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 6; ++t) {
+    threads.emplace_back([&, t]() {
+      std::size_t i;
+      while (q.pop(t % ndomains, i)) taken[i]++;
+    });
+  }
+  for (auto& t : threads) t.join();
+  for (auto& t : taken) EXPECT_EQ(t.load(), 1);
+
+  auto before = numa::get_task_counts();
+  q.commit();
+  auto after = numa::get_task_counts();
+  EXPECT_EQ(after.local - before.local + after.remote - before.remote, n);
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "la/dvector.hpp"
+#include "operator.hpp"
+#include "overlap.hpp"
+
+using namespace nlcglib;
+
+namespace {
+
+/// minimal stand-in for buffer_protocol, only the fields used for the lookup
+struct buffer
+{
+  const void* data;
+  std::array<std::ptrdiff_t, 2> size;
+  std::array<std::ptrdiff_t, 2> stride;
+};
+
+using vec = std::vector<double>;
+
+buffer
+as_buffer(const vec& x)
+{
+  return buffer{x.data(), {static_cast<std::ptrdiff_t>(x.size()), 1}, {1, 0}};
+}
+
+/// real-valued overlap which records how many calls run at the same time
+class counting_overlap : public OverlapBase
+{
+public:
+  explicit counting_overlap(bool reentrant)
+      : reentrant_(reentrant)
+  {
+  }
+
+  void apply(const key_t&, MatrixBaseZ::buffer_t&, MatrixBaseZ::buffer_t&) const override {}
+  void apply_real(const key_t&, MatrixBaseD::buffer_t&, MatrixBaseD::buffer_t&) const override
+  {
+    int active = ++active_;
+    int prev = max_active_.load();
+    while (active > prev && !max_active_.compare_exchange_weak(prev, active)) {
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    --active_;
+  }
+  std::vector<key_t> get_keys() const override { return {{0, 0}}; }
+  bool reentrant() const override { return reentrant_; }
+
+  int max_active() const { return max_active_.load(); }
+
+private:
+  bool reentrant_;
+  mutable std::atomic<int> active_{0};
+  mutable std::atomic<int> max_active_{0};
+};
+
+/// applies S from `nthreads` threads at once, returns the largest number of concurrent calls
+int
+max_concurrent_applies(const counting_overlap& op, int nthreads)
+{
+  using vector_t = KokkosDVector<double**, SlabLayoutV, Kokkos::LayoutLeft, Kokkos::HostSpace>;
+  Overlap S(op, 0, std::make_shared<std::mutex>());
+  std::vector<std::thread> threads;
+  for (int t = 0; t < nthreads; ++t) {
+    threads.emplace_back([&]() {
+      vector_t x(Map<>(Communicator(), SlabLayoutV({{0, 0, 4, 2}})));
+      S.at({0, 0})(x);
+    });
+  }
+  for (auto& t : threads) t.join();
+  return op.max_active();
+}
+
+}  // namespace
+
+TEST(applicator, non_reentrant_operators_are_serialized)
+{
+  counting_overlap op(false);
+  EXPECT_EQ(max_concurrent_applies(op, 4), 1);
+}
+
+TEST(applicator, reentrant_operators_are_not_locked)
+{
+  counting_overlap op(true);
+  EXPECT_GT(max_concurrent_applies(op, 4), 1);
+}
+
+TEST(applicator_cache, hit_returns_the_stored_result)
+{
+  applicator_cache cache(2);
+  std::pair<int, int> k{0, 0};
+  vec x{1, 2, 3};
+  vec y{2, 4, 6};
+  cache.insert(k, as_buffer(x), x, y);
+
+  auto y1 = cache.find<vec>(k, as_buffer(x));
+  auto y2 = cache.find<vec>(k, as_buffer(x));
+  ASSERT_TRUE(y1);
+  EXPECT_EQ(*y1, y);
+  // shared, not copied per hit
+  EXPECT_EQ(y1.get(), y2.get());
+  EXPECT_EQ(cache.hits(), 2u);
+
+  // other k-point, other result type
+  EXPECT_FALSE(cache.find<vec>({1, 0}, as_buffer(x)));
+  EXPECT_FALSE((cache.find<std::vector<float>>(k, as_buffer(x))));
+  EXPECT_EQ(cache.misses(), 2u);
+}
+
+TEST(applicator_cache, invalidate_and_eviction)
+{
+  applicator_cache cache(2);
+  std::pair<int, int> k{0, 0};
+  vec x1{1}, x2{2}, x3{3};
+  cache.insert(k, as_buffer(x1), x1, x1);
+  cache.insert(k, as_buffer(x2), x2, x2);
+  // x1 is the most recently used entry, x2 is evicted
+  EXPECT_TRUE(cache.find<vec>(k, as_buffer(x1)));
+  cache.insert(k, as_buffer(x3), x3, x3);
+  EXPECT_FALSE(cache.find<vec>(k, as_buffer(x2)));
+  EXPECT_TRUE(cache.find<vec>(k, as_buffer(x1)));
+  EXPECT_TRUE(cache.find<vec>(k, as_buffer(x3)));
+
+  cache.invalidate();
+  EXPECT_FALSE(cache.find<vec>(k, as_buffer(x1)));
+  EXPECT_FALSE(cache.find<vec>(k, as_buffer(x3)));
+}
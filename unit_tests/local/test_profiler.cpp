@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <fstream>
+#include <string>
+#include "utils/profiler.hpp"
+
+using namespace nlcglib;
+
+namespace {
+
+/// enables the profiler for one test, restores the defaults afterwards
+class ProfilerTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    prefix = ::testing::TempDir() + "nlcglib_test_profile";
+    Profiler::GetInstance().enable(prefix);
+    Profiler::GetInstance().clear();
+  }
+
+  void TearDown() override
+  {
+    auto& profiler = Profiler::GetInstance();
+    profiler.disable();
+    profiler.clear();
+    profiler.set_max_events(1 << 20);
+  }
+
+  std::string prefix;
+};
+
+}  // namespace
+
+TEST_F(ProfilerTest, disabled_regions_are_not_recorded)
+{
+  Profiler::GetInstance().disable();
+  EXPECT_EQ(Profiler::state().load() & Profiler::recording, 0);
+  {
+    NLCGLIB_PROFILE_REGION("region");
+  }
+  EXPECT_EQ(Profiler::GetInstance().size(), 0u);
+}
+
+TEST_F(ProfilerTest, nested_regions)
+{
+  {
+    NLCGLIB_PROFILE_REGION("outer");
+    {
+      NLCGLIB_PROFILE_REGION("inner", std::make_pair(1, 0));
+    }
+  }
+  EXPECT_EQ(Profiler::GetInstance().size(), 2u);
+}
+
+TEST_F(ProfilerTest, events_are_bounded)
+{
+  auto& profiler = Profiler::GetInstance();
+  profiler.set_max_events(2);
+  for (int i = 0; i < 5; ++i) {
+    NLCGLIB_PROFILE_REGION("region");
+  }
+  EXPECT_EQ(profiler.size(), 2u);
+  EXPECT_EQ(profiler.dropped(), 3u);
+  profiler.clear();
+  EXPECT_EQ(profiler.size(), 0u);
+  EXPECT_EQ(profiler.dropped(), 0u);
+}
+
+TEST_F(ProfilerTest, write)
+{
+  auto& profiler = Profiler::GetInstance();
+  profiler.set_max_events(1);
+  {
+    NLCGLIB_PROFILE_REGION("outer");
+    {
+      NLCGLIB_PROFILE_REGION("inner");
+    }
+  }
+  profiler.write(MPI_COMM_WORLD);
+  EXPECT_EQ(profiler.size(), 0u);
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  if (rank == 0) {
+    std::ifstream flat(prefix + ".flat.txt");
+    std::string content((std::istreambuf_iterator<char>(flat)), std::istreambuf_iterator<char>());
+    // the inner region completes first and is kept, with its path
+    EXPECT_NE(content.find("outer/inner"), std::string::npos);
+    EXPECT_NE(content.find("events dropped"), std::string::npos);
+    EXPECT_TRUE(std::ifstream(prefix + ".trace.json").good());
+  }
+}
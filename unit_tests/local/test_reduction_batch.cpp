@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+#include "la/dvector.hpp"
+#include "mpi/reduction_batch.hpp"
+#include "pseudo_hamiltonian/grad_eta.hpp"
+
+using namespace nlcglib;
+
+TEST(reduction_batch, flush)
+{
+  Communicator comm(MPI_COMM_WORLD);
+  int nranks = comm.size();
+  reduction_batch batch(comm);
+  batch.add("a", 1.0);
+  batch.add("z", std::complex<double>(1, 2));
+  // adding to an existing name accumulates
+  batch.add("a", 0.5);
+  EXPECT_EQ(batch.size(), 2u);
+  EXPECT_FALSE(batch.ready());
+  batch.flush();
+  EXPECT_TRUE(batch.ready());
+  EXPECT_DOUBLE_EQ(batch.get("a"), 1.5 * nranks);
+  EXPECT_DOUBLE_EQ(batch.get_complex("z").real(), 1.0 * nranks);
+  EXPECT_DOUBLE_EQ(batch.get_complex("z").imag(), 2.0 * nranks);
+}
+
+TEST(reduction_batch, flush_async)
+{
+  Communicator comm(MPI_COMM_WORLD);
+  int nranks = comm.size();
+  reduction_batch batch(comm);
+  batch.add("a", 2.0);
+  batch.add("b", Kokkos::complex<double>(0, 1));
+  batch.flush_async();
+  // get waits for the reduction
+  EXPECT_DOUBLE_EQ(batch.get("a"), 2.0 * nranks);
+  EXPECT_TRUE(batch.ready());
+  EXPECT_DOUBLE_EQ(batch.get_complex("b").imag(), 1.0 * nranks);
+}
+
+TEST(reduction_batch, errors)
+{
+  reduction_batch batch(Communicator(MPI_COMM_WORLD));
+  batch.add("a", 1.0);
+  EXPECT_THROW(batch.get("a"), std::runtime_error);
+  EXPECT_THROW(batch.add("a", std::complex<double>(1, 0)), std::runtime_error);
+  batch.flush();
+  EXPECT_THROW(batch.add("a", 1.0), std::runtime_error);
+  EXPECT_THROW(batch.flush(), std::runtime_error);
+  EXPECT_THROW(batch.get("b"), std::runtime_error);
+  EXPECT_THROW(batch.get_complex("a"), std::runtime_error);
+
+  // reusable after clear
+  batch.clear();
+  EXPECT_EQ(batch.size(), 0u);
+  batch.add("b", 3.0);
+  batch.flush();
+  EXPECT_DOUBLE_EQ(batch.get("b"), 3.0 * Communicator(MPI_COMM_WORLD).size());
+}
+
+TEST(grad_eta, linear_in_the_chemical_potential_term)
+{
+  using matrix_t = KokkosDVector<double**, SlabLayoutV, Kokkos::LayoutLeft, Kokkos::HostSpace>;
+  int n = 6;
+  matrix_t hij(Map<>(Communicator(), SlabLayoutV({{0, 0, n, n}})));
+  Kokkos::View<double*, Kokkos::HostSpace> ek("ek", n);
+  Kokkos::View<double*, Kokkos::HostSpace> fn("fn", n);
+  for (int i = 0; i < n; ++i) {
+    ek(i) = -0.2 + 0.05 * i;
+    fn(i) = 1.0 / (1 + std::exp(ek(i) / 0.01));
+    for (int j = 0; j < n; ++j) hij.array()(i, j) = 0.01 * (i + j) + (i == j ? ek(i) : 0);
+  }
+  double T = 3000;
+  double mu = -0.05;
+  double wk = 0.5;
+  double dmu_deta = 2.5;
+  double dFdmu = -0.3;
+  GradEta<smearing_type::FERMI_DIRAC> grad_eta(T, 1.0);
+  auto g = grad_eta.g_eta(hij, mu, wk, ek, fn, dmu_deta, dFdmu, 1);
+  auto g0 = grad_eta.g_eta(hij, mu, wk, ek, fn, 0, 0, 1);
+  auto g_mu = grad_eta.g_eta_mu(hij, mu, wk, ek, 1);
+  double c = GradEta<smearing_type::FERMI_DIRAC>::mu_coefficient(dmu_deta, dFdmu);
+  EXPECT_DOUBLE_EQ(c, dFdmu / dmu_deta);
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < n; ++j) {
+      EXPECT_NEAR(g.array()(i, j), g0.array()(i, j) + c * g_mu.array()(i, j), 1e-12);
+    }
+  }
+  EXPECT_EQ(GradEta<smearing_type::FERMI_DIRAC>::mu_coefficient(0, dFdmu), 0);
+}
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "utils/thread_budget.hpp"
+
+using namespace nlcglib;
+
+TEST(thread_budget, small_matrices_run_kpoints_concurrently)
+{
+  auto p = partition_threads(8, 4, 100, 10);
+  EXPECT_EQ(p.tasks, 4);
+  EXPECT_EQ(p.threads_per_task, 2);
+}
+
+TEST(thread_budget, large_matrices_get_all_threads)
+{
+  auto p = partition_threads(8, 4, 100000, 500);
+  EXPECT_EQ(p.tasks, 1);
+  EXPECT_EQ(p.threads_per_task, 8);
+}
+
+TEST(thread_budget, sequential_kpoints_use_few_threads_for_small_matrices)
+{
+  auto p = partition_threads(8, 4, 100, 10, false);
+  EXPECT_EQ(p.tasks, 1);
+  EXPECT_EQ(p.threads_per_task, 1);
+}
+
+TEST(thread_budget, overrides_replace_the_choice)
+{
+  auto p = partition_threads(8, 4, 100000, 500, true, thread_partition{2, 3});
+  EXPECT_EQ(p.tasks, 2);
+  EXPECT_EQ(p.threads_per_task, 3);
+  // at most one task per k-point
+  auto q = partition_threads(8, 4, 100, 10, true, thread_partition{16, 0});
+  EXPECT_EQ(q.tasks, 4);
+  EXPECT_EQ(q.threads_per_task, 2);
+  auto r = partition_threads(8, 4, 100, 10, false, thread_partition{4, 0});
+  EXPECT_EQ(r.tasks, 1);
+}
+
+TEST(thread_budget, for_each_kpoint_visits_all)
+{
+  thread_partition_guard guard(thread_partition{2, 1});
+  std::vector<int> visited(7, 0);
+  for_each_kpoint(visited.size(), [&](std::size_t i) { visited[i]++; });
+  for (int v : visited) EXPECT_EQ(v, 1);
+}
+
+TEST(thread_budget, partition_is_per_thread)
+{
+  thread_partition_guard guard(thread_partition{3, 2});
+  thread_partition other;
+  std::thread t([&]() { other = current_thread_partition(); });
+  t.join();
+  EXPECT_EQ(current_thread_partition().tasks, 3);
+  EXPECT_EQ(other.tasks, 1);
+  EXPECT_EQ(other.threads_per_task, 0);
+}
+
+TEST(thread_budget, numa_mode_is_per_thread)
+{
+  thread_partition_guard guard(thread_partition{2, 1, true});
+  bool other{true};
+  std::thread t([&]() { other = current_thread_partition().numa; });
+  t.join();
+  EXPECT_TRUE(current_thread_partition().numa);
+  EXPECT_FALSE(other);
+  // passed on by partition_threads
+  EXPECT_TRUE(partition_threads(8, 4, 100, 10, true, thread_partition{0, 0, true}).numa);
+}
+
+TEST(thread_budget, concurrent_runs_get_their_own_tasks)
+{
+  // two solver runs (threads) evaluate their k-points at the same time
+  std::vector<std::set<std::thread::id>> workers(2);
+  std::vector<std::mutex> mutexes(2);
+  std::atomic<int> active{0};
+  std::atomic<int> max_active{0};
+  auto run = [&](int r) {
+    thread_partition_guard guard(thread_partition{2, 1});
+    for_each_kpoint(4, [&](std::size_t) {
+      int a = ++active;
+      int m = max_active.load();
+      while (a > m && !max_active.compare_exchange_weak(m, a)) {
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      --active;
+      std::lock_guard<std::mutex> lock(mutexes[r]);
+      workers[r].insert(std::this_thread::get_id());
+    });
+  };
+  std::thread t0(run, 0);
+  std::thread t1(run, 1);
+  t0.join();
+  t1.join();
+#ifdef __USE_OPENMP
+  EXPECT_EQ(workers[0].size(), 2);
+  EXPECT_EQ(workers[1].size(), 2);
+  EXPECT_GT(max_active.load(), 2);
+#endif
+}
+
+TEST(thread_budget, for_each_kpoint_visits_all_concurrently)
+{
+  thread_partition_guard guard(thread_partition{3, 1});
+  std::vector<std::atomic<int>> visited(11);
+  for (auto& v : visited) v = 0;
+  std::atomic<int> nested{0};
+  for_each_kpoint(visited.size(), [&](std::size_t i) {
+    visited[i]++;
+    // nested calls run on the calling task
+    for_each_kpoint(2, [&](std::size_t) { nested++; });
+  });
+  for (auto& v : visited) EXPECT_EQ(v.load(), 1);
+  EXPECT_EQ(nested.load(), 22);
+}
+
+TEST(thread_budget, for_each_kpoint_rethrows)
+{
+  thread_partition_guard guard(thread_partition{2, 1});
+  std::atomic<int> calls{0};
+  EXPECT_THROW(for_each_kpoint(5,
+                               [&](std::size_t i) {
+                                 calls++;
+                                 if (i == 3) throw std::runtime_error("k-point 3");
+                               }),
+               std::runtime_error);
+  // the other k-points are still evaluated
+  EXPECT_EQ(calls.load(), 5);
+}
+
+#if defined(__USE_OPENBLAS)
+TEST(thread_budget, openblas_threads_restored_by_the_last_run)
+{
+  int prev = openblas_get_num_threads();
+  {
+    blas_process_threads_scope run1(1);
+    EXPECT_EQ(openblas_get_num_threads(), 1);
+    {
+      // concurrent run: shares the setting of the first one
+      blas_process_threads_scope run2(2);
+      EXPECT_EQ(openblas_get_num_threads(), 1);
+    }
+    EXPECT_EQ(openblas_get_num_threads(), 1);
+  }
+  EXPECT_EQ(openblas_get_num_threads(), prev);
+}
+#endif